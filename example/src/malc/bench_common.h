@@ -0,0 +1,127 @@
+#ifndef __MALC_EXAMPLE_BENCH_COMMON_H__
+#define __MALC_EXAMPLE_BENCH_COMMON_H__
+
+/* Boilerplate shared by the malc benchmarks: the logger instance used by the
+log macros, a destination discarding everything, the latency percentiles and
+the logger setup. To be included instead of "malc/malc.h". */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <bl/base/allocator.h>
+
+#define MALC_CUSTOM_LOGGER_INSTANCE_EXPRESSION ilog
+#include <malc/malc.h>
+
+static malc* ilog = nullptr;
+/*----------------------------------------------------------------------------*/
+static inline bl_err bench_null_dst_write(
+  void* dst, bl_u64 nsec, unsigned sev_val, malc_log_strings const* strs
+  )
+{
+  (void) dst;
+  (void) nsec;
+  (void) sev_val;
+  (void) strs;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+static inline malc_dst const* bench_null_dst (void)
+{
+  static const malc_dst tbl = {
+    0,
+    nullptr, /* init */
+    nullptr, /* terminate */
+    nullptr, /* flush */
+    nullptr, /* idle task */
+    bench_null_dst_write,
+    nullptr  /* write batch */
+  };
+  return &tbl;
+}
+/*----------------------------------------------------------------------------*/
+static inline int bench_u32_cmp (void const* a, void const* b)
+{
+  bl_u32 va = *((bl_u32 const*) a);
+  bl_u32 vb = *((bl_u32 const*) b);
+  return (va > vb) - (va < vb);
+}
+/*----------------------------------------------------------------------------*/
+static inline void bench_sort (bl_u32* lat_ns, bl_uword count)
+{
+  qsort (lat_ns, count, sizeof lat_ns[0], bench_u32_cmp);
+}
+/*----------------------------------------------------------------------------*/
+/* "sorted" as left by "bench_sort" */
+static inline bl_u32 bench_percentile(
+  bl_u32 const* sorted, bl_uword count, double p
+  )
+{
+  bl_uword idx = (bl_uword) ((double) (count - 1) * p);
+  return sorted[idx];
+}
+/*----------------------------------------------------------------------------*/
+/* allocates and creates "ilog" with "dst" as its only destination. "cfg" gets
+the default configuration, to be modified and passed to "bench_logger_init".
+On error there is nothing to destroy. */
+static inline bl_err bench_logger_create(
+  bl_alloc_tbl* alloc, malc_dst const* dst, malc_cfg* cfg
+  )
+{
+  size_t dst_id;
+
+  ilog = (malc*) bl_alloc (alloc, malc_get_size());
+  if (!ilog) {
+    fprintf (stderr, "Unable to allocate memory for the malc instance\n");
+    return bl_mkerr (bl_alloc);
+  }
+  bl_err err = malc_create (ilog, alloc);
+  if (err.own) {
+    fprintf (stderr, "Error creating the malc instance\n");
+    goto dealloc;
+  }
+  err = malc_add_destination (ilog, &dst_id, dst);
+  if (err.own) {
+    fprintf (stderr, "Error creating the benchmark destination\n");
+    goto destroy;
+  }
+  err = malc_get_cfg (ilog, cfg);
+  if (err.own) {
+    fprintf (stderr, "bug when retrieving the logger configuration\n");
+    goto destroy;
+  }
+  return err;
+destroy:
+  (void) malc_destroy (ilog);
+dealloc:
+  bl_dealloc (alloc, ilog);
+  ilog = nullptr;
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+/* terminates and destroys "ilog". The TLS buffer of the calling thread is
+destroyed here. */
+static inline void bench_logger_destroy (bl_alloc_tbl* alloc)
+{
+  (void) malc_terminate (ilog, false);
+  (void) malc_destroy (ilog);
+  bl_dealloc (alloc, ilog);
+  ilog = nullptr;
+}
+/*----------------------------------------------------------------------------*/
+/* "malc_init" for a logger from "bench_logger_create". On error the logger is
+destroyed. */
+static inline bl_err bench_logger_init(
+  bl_alloc_tbl* alloc, malc_cfg const* cfg
+  )
+{
+  bl_err err = malc_init (ilog, cfg);
+  if (err.own) {
+    fprintf (stderr, "unable to start logger\n");
+    bench_logger_destroy (alloc);
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_EXAMPLE_BENCH_COMMON_H__ */
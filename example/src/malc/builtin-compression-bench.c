@@ -0,0 +1,196 @@
+/* Measures the cost of the builtin integer encoding chosen at build time (the
+"compressed_builtins" and "compressed_builtins_format" meson options): the
+producer side serialization of an entry and the consumer side decoding
+throughput, both on a single thread without the queues in between.
+
+Build it once per format to compare them. The "group_varint" decoder uses
+SSSE3 when the compiler targets it (e.g. "-Dc_args=-mssse3"). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bl/base/default_allocator.h>
+#include <bl/base/time.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include <malc/malc.h>
+#include <malc/serialization.h>
+#include <malc/group_varint.h>
+
+#define ENTRY_BUFFER_BYTES 256
+
+/* both on the same line, the entry name has the line number */
+#define BENCH_GET_ENTRY(var, ...)\
+  MALC_LOG_CREATE_CONST_ENTRY (malc_sev_warning, "", __VA_ARGS__); \
+  var = &bl_pp_tokconcat(malc_const_entry_, __LINE__)
+
+/*----------------------------------------------------------------------------*/
+typedef struct bench_values {
+  bl_i32 i32[8];
+  bl_u32 u32[8];
+  bl_i64 i64[2];
+}
+bench_values;
+/*----------------------------------------------------------------------------*/
+/* small values, as counters and sizes usually are, with some negatives */
+static void bench_values_fill (bench_values* v, bl_uword seed)
+{
+  for (bl_uword i = 0; i < 8; ++i) {
+    bl_u32 r   = (bl_u32) ((seed + i) * 2654435761u);
+    v->i32[i]  = (bl_i32) (r >> (8 + (r & 15)));
+    v->i32[i]  = (r & 16) ? -v->i32[i] : v->i32[i];
+    v->u32[i]  = r >> (4 + (r & 15));
+  }
+  v->i64[0] = -(bl_i64) (seed * 0x9e3779b97f4a7c15ull >> 20);
+  v->i64[1] = (bl_i64) (seed * 1000003);
+}
+/*----------------------------------------------------------------------------*/
+typedef struct bench_case {
+  char const*             name;
+  malc_const_entry const* entry;
+  bl_uword                values;
+}
+bench_case;
+/*----------------------------------------------------------------------------*/
+enum bench_case_ids {
+  bench_4_i32,
+  bench_8_u32,
+  bench_2_i32_2_i64,
+  bench_case_count,
+};
+/*----------------------------------------------------------------------------*/
+static bl_uword serialize_case(
+  bl_uword id, malc_const_entry const* entry, bench_values const* v, bl_u8* buf
+  )
+{
+  serializer ser;
+  serializer_init (&ser, entry, false);
+  malc_serializer s = serializer_prepare_external_serializer (&ser, buf, buf);
+  switch (id) {
+  case bench_4_i32:
+    for (bl_uword i = 0; i < 4; ++i) {
+      malc_serialize (&s, malc_type_transform (v->i32[i]));
+    }
+    break;
+  case bench_8_u32:
+    for (bl_uword i = 0; i < 8; ++i) {
+      malc_serialize (&s, malc_type_transform (v->u32[i]));
+    }
+    break;
+  case bench_2_i32_2_i64:
+    malc_serialize (&s, malc_type_transform (v->i32[0]));
+    malc_serialize (&s, malc_type_transform (v->i64[0]));
+    malc_serialize (&s, malc_type_transform (v->i32[1]));
+    malc_serialize (&s, malc_type_transform (v->i64[1]));
+    break;
+  default:
+    break;
+  }
+  return (bl_uword) (s.field_mem - buf);
+}
+/*----------------------------------------------------------------------------*/
+static void run_case(
+  bench_case const* c, bl_uword id, bl_uword iterations, bl_alloc_tbl* alloc
+  )
+{
+  static bl_u8 buf[ENTRY_BUFFER_BYTES];
+  bench_values v;
+  bl_uword     bytes = 0;
+  bl_uword     sink  = 0;
+
+  bench_values_fill (&v, 1);
+  bl_timept64 start = bl_fast_timept_get();
+  for (bl_uword i = 0; i < iterations; ++i) {
+    v.i32[0] = (bl_i32) i;
+    v.u32[0] = (bl_u32) i;
+    bytes   += serialize_case (id, c->entry, &v, buf);
+    sink    += buf[bytes & 15];
+  }
+  bl_u64 enc_ns = bl_fast_timept_to_nsec (bl_fast_timept_get() - start);
+
+  deserializer ds;
+  if (deserializer_init (&ds, alloc).own) {
+    fprintf (stderr, "unable to initialize the deserializer\n");
+    return;
+  }
+  (void) serialize_case (id, c->entry, &v, buf);
+  start = bl_fast_timept_get();
+  for (bl_uword i = 0; i < iterations; ++i) {
+    deserializer_reset (&ds);
+    /* the entries on the queues end on a slot boundary, there is slack */
+    bl_err err = deserializer_execute(
+      &ds, buf, buf + sizeof buf, false, alloc
+      );
+    if (err.own) {
+      fprintf (stderr, "decoding error\n");
+      break;
+    }
+    sink += (bl_uword) deserializer_get_log_entry (&ds).args[0].vu32;
+  }
+  bl_u64 dec_ns = bl_fast_timept_to_nsec (bl_fast_timept_get() - start);
+  deserializer_destroy (&ds, alloc);
+
+  printf(
+    "%-16s bytes: %5.2f, encode: %6.2f ns/entry, decode: %7.2f Mvalues/s"
+    " (%lu)\n",
+    c->name,
+    (double) bytes / (double) iterations,
+    (double) enc_ns / (double) iterations,
+    (double) (iterations * c->values) * 1000. / (double) (dec_ns ? dec_ns : 1),
+    (unsigned long) (sink & 1)
+    );
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  bl_alloc_tbl alloc      = bl_get_default_alloc();
+  bl_uword     iterations = 10000000;
+  bench_values v;
+  bench_case   cases[bench_case_count];
+
+  if (argc > 1) {
+    iterations = (bl_uword) strtoul (argv[1], nullptr, 10);
+  }
+  if (iterations == 0) {
+    puts ("Usage: malc-builtin-compression-bench [iterations]");
+    return bl_invalid;
+  }
+  bl_time_extras_init();
+  memset (&v, 0, sizeof v);
+  {
+    BENCH_GET_ENTRY (cases[bench_4_i32].entry, v.i32[0], v.i32[1], v.i32[2],
+      v.i32[3]
+      );
+    cases[bench_4_i32].name   = "4 x i32";
+    cases[bench_4_i32].values = 4;
+  }
+  {
+    BENCH_GET_ENTRY (cases[bench_8_u32].entry, v.u32[0], v.u32[1], v.u32[2],
+      v.u32[3], v.u32[4], v.u32[5], v.u32[6], v.u32[7]
+      );
+    cases[bench_8_u32].name   = "8 x u32";
+    cases[bench_8_u32].values = 8;
+  }
+  {
+    BENCH_GET_ENTRY (cases[bench_2_i32_2_i64].entry, v.i32[0], v.i64[0],
+      v.i32[1], v.i64[1]
+      );
+    cases[bench_2_i32_2_i64].name   = "2 x i32, 2 x i64";
+    cases[bench_2_i32_2_i64].values = 4;
+  }
+  printf(
+    "compressed builtins: %s, simd decoder: %s\n",
+    !MALC_BUILTIN_COMPRESSION
+      ? "no"
+      : (MALC_BUILTIN_COMPRESSION_GROUP_VARINT ? "group_varint" : "nibble"),
+    MALC_HAS_GROUP_VARINT_SIMD ? "yes" : "no"
+    );
+  for (bl_uword i = 0; i < bench_case_count; ++i) {
+    run_case (&cases[i], i, iterations, &alloc);
+  }
+  bl_time_extras_destroy();
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
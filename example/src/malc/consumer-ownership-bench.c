@@ -0,0 +1,99 @@
+/* Compares the cost of "malc_run_consume_task" calls on the mutex path against
+the same calls from the thread owning the consumer ("malc_consumer_acquire").
+
+The consume task is called many times from the main thread, as a reactor
+polling the logger would do. It is measured with the queue empty (pure call
+overhead) and with one entry enqueued before each call. */
+
+#include <bl/base/default_allocator.h>
+#include <bl/base/time.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include "bench_common.h"
+
+/*----------------------------------------------------------------------------*/
+static bl_err count_dst_write(
+  void* dst, bl_u64 nsec, unsigned sev_val, malc_log_strings const* strs
+  )
+{
+  ++*((bl_u64*) dst);
+  (void) nsec;
+  (void) sev_val;
+  (void) strs;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+static const malc_dst count_dst_tbl = {
+  sizeof (bl_u64),
+  nullptr, /* init */
+  nullptr, /* terminate */
+  nullptr, /* flush */
+  nullptr, /* idle task */
+  count_dst_write,
+  nullptr  /* write batch */
+};
+/*----------------------------------------------------------------------------*/
+static double run_calls (bl_uword calls, bool with_entries)
+{
+  bl_timept64 start = bl_fast_timept_get();
+  for (bl_uword i = 0; i < calls; ++i) {
+    if (with_entries) {
+      (void) log_error ("entry: {}", i);
+    }
+    (void) malc_run_consume_task (ilog, 0);
+  }
+  bl_u64 ns = bl_fast_timept_to_nsec (bl_fast_timept_get() - start);
+  return (double) ns / (double) calls;
+}
+/*----------------------------------------------------------------------------*/
+static void run_pass (char const* name, bl_uword calls)
+{
+  double empty   = run_calls (calls, false);
+  double entries = run_calls (calls, true);
+  printf(
+    "%-6s: empty queue: %7.2f ns/call, one entry: %7.2f ns/call\n",
+    name,
+    empty,
+    entries
+    );
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  bl_alloc_tbl alloc = bl_get_default_alloc();
+  bl_uword     calls = 2000000;
+  malc_cfg     cfg;
+
+  if (argc > 1) {
+    calls = (bl_uword) strtoul (argv[1], nullptr, 10);
+  }
+  if (calls == 0) {
+    puts ("Usage: malc-consumer-ownership-bench [calls]");
+    return bl_invalid;
+  }
+  bl_err err = bench_logger_create (&alloc, &count_dst_tbl, &cfg);
+  if (err.own) {
+    return err.own;
+  }
+  cfg.consumer.start_own_thread = false;
+  err = bench_logger_init (&alloc, &cfg);
+  if (err.own) {
+    return err.own;
+  }
+  /* warm-up */
+  (void) run_calls (calls / 10, true);
+
+  run_pass ("mutex", calls);
+  err = malc_consumer_acquire (ilog);
+  if (err.own) {
+    fprintf (stderr, "unable to acquire the consumer\n");
+    goto destroy;
+  }
+  run_pass ("owner", calls);
+  (void) malc_consumer_release (ilog);
+destroy:
+  bench_logger_destroy (&alloc);
+  return err.own;
+}
+/*----------------------------------------------------------------------------*/
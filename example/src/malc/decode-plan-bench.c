@@ -0,0 +1,172 @@
+/* Measures the consumer side decoding of the per-callsite decode plans (see
+"src/malc/decode_plan.h") against the generic decoder, on a single thread
+without the queues in between. The generic decoder is measured with a copy of
+the entry without callsite id, as if it wasn't created by the logging macros.
+
+With "compressed_builtins" the 32 and 64-bit integers have a variable width,
+so the callsites with them don't get a plan and both columns match. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bl/base/default_allocator.h>
+#include <bl/base/time.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include <malc/malc.h>
+#include <malc/serialization.h>
+
+#define ENTRY_BUFFER_BYTES 256
+
+/* both on the same line, the entry name has the line number */
+#define BENCH_GET_ENTRY(var, ...)\
+  MALC_LOG_CREATE_CONST_ENTRY (malc_sev_warning, "", __VA_ARGS__); \
+  var = &bl_pp_tokconcat(malc_const_entry_, __LINE__)
+
+/*----------------------------------------------------------------------------*/
+enum bench_case_ids {
+  bench_4_u32,
+  bench_small_ints_double,
+  bench_u64_ptr_double,
+  bench_case_count,
+};
+/*----------------------------------------------------------------------------*/
+typedef struct bench_case {
+  char const*             name;
+  malc_const_entry const* entry;
+}
+bench_case;
+/*----------------------------------------------------------------------------*/
+static bl_uword serialize_case(
+  bl_uword id, malc_const_entry const* entry, bl_uword v, bl_u8* buf
+  )
+{
+  serializer ser;
+  serializer_init (&ser, entry, true);
+  malc_serializer s = serializer_prepare_external_serializer (&ser, buf, buf);
+  switch (id) {
+  case bench_4_u32:
+    for (bl_uword i = 0; i < 4; ++i) {
+      malc_serialize (&s, malc_type_transform ((bl_u32) (v + i)));
+    }
+    break;
+  case bench_small_ints_double:
+    malc_serialize (&s, malc_type_transform ((bl_u8) v));
+    malc_serialize (&s, malc_type_transform ((bl_i16) v));
+    malc_serialize (&s, malc_type_transform ((bl_u8) v));
+    malc_serialize (&s, malc_type_transform ((bl_u16) v));
+    malc_serialize (&s, malc_type_transform ((double) v));
+    break;
+  case bench_u64_ptr_double:
+    malc_serialize (&s, malc_type_transform ((bl_u64) v));
+    malc_serialize (&s, malc_type_transform ((void*) buf));
+    malc_serialize (&s, malc_type_transform ((double) v));
+    break;
+  default:
+    break;
+  }
+  return (bl_uword) (s.field_mem - buf);
+}
+/*----------------------------------------------------------------------------*/
+/* returns the nanoseconds taken */
+static bl_u64 decode_case(
+  deserializer* ds, bl_u8* buf, bl_uword iterations, bl_alloc_tbl* alloc
+  )
+{
+  bl_uword    sink  = 0;
+  bl_timept64 start = bl_fast_timept_get();
+  for (bl_uword i = 0; i < iterations; ++i) {
+    deserializer_reset (ds);
+    /* the entries on the queues end on a slot boundary, there is slack */
+    bl_err err = deserializer_execute(
+      ds, buf, buf + ENTRY_BUFFER_BYTES, true, alloc
+      );
+    if (err.own) {
+      fprintf (stderr, "decoding error\n");
+      break;
+    }
+    sink += (bl_uword) deserializer_get_log_entry (ds).args[0].vu8;
+  }
+  bl_u64 ns = bl_fast_timept_to_nsec (bl_fast_timept_get() - start);
+  return ns + (sink & 1);
+}
+/*----------------------------------------------------------------------------*/
+static void run_case(
+  bench_case const* c, bl_uword id, bl_uword iterations, bl_alloc_tbl* alloc
+  )
+{
+  static bl_u8 buf[ENTRY_BUFFER_BYTES];
+  deserializer ds;
+  if (deserializer_init (&ds, alloc).own) {
+    fprintf (stderr, "unable to initialize the deserializer\n");
+    return;
+  }
+  /* a copy without id cache, as if it wasn't created by the macros */
+  malc_const_entry generic = *c->entry;
+  generic.callsite         = nullptr;
+
+  (void) serialize_case (id, &generic, 92, buf);
+  bl_u64 generic_ns = decode_case (&ds, buf, iterations, alloc);
+  (void) serialize_case (id, c->entry, 92, buf);
+  bl_u64 plan_ns = decode_case (&ds, buf, iterations, alloc);
+  deserializer_destroy (&ds, alloc);
+
+  printf(
+    "%-24s generic: %6.2f ns/entry, plan: %6.2f ns/entry (x%.2f)\n",
+    c->name,
+    (double) generic_ns / (double) iterations,
+    (double) plan_ns / (double) iterations,
+    (double) generic_ns / (double) (plan_ns ? plan_ns : 1)
+    );
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  bl_alloc_tbl alloc      = bl_get_default_alloc();
+  bl_uword     iterations = 10000000;
+  bench_case   cases[bench_case_count];
+  bl_u8        u8v  = 0;
+  bl_i16       i16v = 0;
+  bl_u16       u16v = 0;
+  bl_u32       u32v = 0;
+  bl_u64       u64v = 0;
+  double       dv   = 0;
+  void*        pv   = nullptr;
+
+  if (argc > 1) {
+    iterations = (bl_uword) strtoul (argv[1], nullptr, 10);
+  }
+  if (iterations == 0) {
+    puts ("Usage: malc-decode-plan-bench [iterations]");
+    return bl_invalid;
+  }
+  bl_time_extras_init();
+  {
+    BENCH_GET_ENTRY (cases[bench_4_u32].entry, u32v, u32v, u32v, u32v);
+    cases[bench_4_u32].name = "4 x u32";
+  }
+  {
+    BENCH_GET_ENTRY (cases[bench_small_ints_double].entry, u8v, i16v, u8v,
+      u16v, dv
+      );
+    cases[bench_small_ints_double].name = "u8, i16, u8, u16, double";
+  }
+  {
+    BENCH_GET_ENTRY (cases[bench_u64_ptr_double].entry, u64v, pv, dv);
+    cases[bench_u64_ptr_double].name = "u64, ptr, double";
+  }
+  printf(
+    "compressed builtins: %s\n",
+    !MALC_BUILTIN_COMPRESSION
+      ? "no"
+      : (MALC_BUILTIN_COMPRESSION_GROUP_VARINT ? "group_varint" : "nibble")
+    );
+  for (bl_uword i = 0; i < bench_case_count; ++i) {
+    run_case (&cases[i], i, iterations, &alloc);
+  }
+  bl_time_extras_destroy();
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
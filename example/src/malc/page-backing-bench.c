@@ -0,0 +1,164 @@
+/* Compares the producer-side latency of the log calls with the buffers taken
+from the default allocator against the "mmap" backing ("buffers_huge_pages"
+and "buffers_numa_local" on "malc_alloc_cfg").
+
+Some producer threads with a thread local buffer log concurrently and time
+every log call. The fixed allocator is enabled per CPU, so the entries that
+don't fit on the thread local buffers go there. The latency percentiles of all
+the calls are printed for each configuration.
+
+For the NUMA placement to matter on multi-socket machines run it with the
+threads spread across the nodes (e.g. with more threads than cores on a node).
+Note that huge pages have to be reserved ("vm.nr_hugepages") to avoid the
+transparent huge page fallback. */
+
+#include <string.h>
+
+#include <bl/base/default_allocator.h>
+#include <bl/base/thread.h>
+#include <bl/base/time.h>
+#include <bl/base/atomic.h>
+#include <bl/base/processor_pause.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include "bench_common.h"
+
+#define MAX_THREADS 64
+
+/*----------------------------------------------------------------------------*/
+typedef struct thr_context {
+  bl_atomic_uword* start;
+  bl_uword         tls_bytes;
+  bl_uword         samples;
+  bl_u32*          lat_ns;
+  bl_uword         faults;
+  bl_err           err;
+}
+thr_context;
+/*----------------------------------------------------------------------------*/
+static int producer_thread (void* ctx)
+{
+  thr_context* c = (thr_context*) ctx;
+  c->err = malc_producer_thread_local_init (ilog, c->tls_bytes);
+  if (c->err.own) {
+    return 1;
+  }
+  while (bl_atomic_uword_load_rlx (c->start) == 0) {
+    bl_processor_pause();
+  }
+  for (bl_uword i = 0; i < c->samples; ++i) {
+    bl_timept64 start = bl_fast_timept_get();
+    bl_err err = log_error ("page backing bench: {}, {}, {.1}", i, 2, 3.f);
+    bl_timept64 end   = bl_fast_timept_get();
+    c->lat_ns[i] = (bl_u32) bl_fast_timept_to_nsec (end - start);
+    c->faults   += err.own != bl_ok;
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static int run_config(
+  bl_alloc_tbl* alloc,
+  bool          page_backed,
+  bl_uword      threads,
+  bl_uword      samples,
+  bl_uword      tls_bytes,
+  bl_u32*       lat_ns
+  )
+{
+  bl_thread       thrs[MAX_THREADS];
+  thr_context     tcontext[MAX_THREADS];
+  bl_atomic_uword start;
+  bl_uword        started = 0;
+  bl_uword        faults  = 0;
+  malc_cfg        cfg;
+
+  bl_err err = bench_logger_create (alloc, bench_null_dst(), &cfg);
+  if (err.own) {
+    return err.own;
+  }
+  cfg.consumer.start_own_thread       = true;
+  cfg.alloc.fixed_allocator_bytes     = (2 * 1024 * 1024) - 4096;
+  cfg.alloc.fixed_allocator_max_slots = 2;
+  cfg.alloc.fixed_allocator_per_cpu   = true;
+  cfg.alloc.buffers_huge_pages        = page_backed;
+  cfg.alloc.buffers_numa_local        = page_backed;
+  err = bench_logger_init (alloc, &cfg);
+  if (err.own) {
+    return err.own;
+  }
+  bl_atomic_uword_store_rlx (&start, 0);
+  memset (tcontext, 0, sizeof tcontext);
+  for (; started < threads; ++started) {
+    tcontext[started].start     = &start;
+    tcontext[started].tls_bytes = tls_bytes;
+    tcontext[started].samples   = samples;
+    tcontext[started].lat_ns    = lat_ns + (started * samples);
+    err = bl_thread_init (&thrs[started], producer_thread, &tcontext[started]);
+    if (err.own) {
+      fprintf (stderr, "unable to start a log thread\n");
+      break;
+    }
+  }
+  bl_atomic_uword_store_rlx (&start, 1);
+  for (bl_uword th = 0; th < started; ++th) {
+    bl_thread_join (&thrs[th]);
+    if (tcontext[th].err.own) {
+      fprintf (stderr, "unable to initialize a thread local buffer\n");
+      err = tcontext[th].err;
+    }
+    faults += tcontext[th].faults;
+  }
+  bench_logger_destroy (alloc);
+  if (!err.own) {
+    bl_uword count = threads * samples;
+    bench_sort (lat_ns, count);
+    printf(
+      "%-8s: p50: %6u ns, p90: %6u ns, p99: %6u ns, p99.9: %6u ns, "
+        "p99.99: %7u ns, max: %8u ns, faults: %lu\n",
+      page_backed ? "mmap" : "default",
+      (unsigned) bench_percentile (lat_ns, count, 0.5),
+      (unsigned) bench_percentile (lat_ns, count, 0.9),
+      (unsigned) bench_percentile (lat_ns, count, 0.99),
+      (unsigned) bench_percentile (lat_ns, count, 0.999),
+      (unsigned) bench_percentile (lat_ns, count, 0.9999),
+      (unsigned) lat_ns[count - 1],
+      (unsigned long) faults
+      );
+  }
+  return err.own;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  bl_alloc_tbl alloc     = bl_get_default_alloc();
+  bl_uword     threads   = 4;
+  bl_uword     samples   = 1000000;
+  bl_uword     tls_bytes = (4 * 1024 * 1024) - 4096;
+
+  if (argc > 1) {
+    threads = (bl_uword) strtoul (argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    samples = (bl_uword) strtoul (argv[2], nullptr, 10);
+  }
+  if (argc > 3) {
+    tls_bytes = (bl_uword) strtoul (argv[3], nullptr, 10);
+  }
+  if (threads == 0 || threads > MAX_THREADS || samples == 0 || tls_bytes == 0) {
+    puts ("Usage: malc-page-backing-bench [threads] [samples] [tls_bytes]");
+    return bl_invalid;
+  }
+  bl_u32* lat_ns = (bl_u32*) malloc (threads * samples * sizeof *lat_ns);
+  if (!lat_ns) {
+    fprintf (stderr, "Unable to allocate memory for the samples\n");
+    return bl_alloc;
+  }
+  int err = run_config (&alloc, false, threads, samples, tls_bytes, lat_ns);
+  if (!err) {
+    err = run_config (&alloc, true, threads, samples, tls_bytes, lat_ns);
+  }
+  free (lat_ns);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,127 @@
+/* Compares the slot sizes ("malc_alloc_cfg.slot_size") for small entries: how
+many of them fit on 1MB of thread local buffer and the latency of the log calls
+of a producer thread while the consumer runs on its own thread.
+
+The entries are a pointer and an integer, with a timestamp. */
+
+#include <bl/base/default_allocator.h>
+#include <bl/base/time.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include "bench_common.h"
+
+#define TLS_BYTES (1024 * 1024)
+
+/*----------------------------------------------------------------------------*/
+/* without a consumer thread the entries are dropped when the buffer is full,
+with it the producer blocks until there is space */
+static bl_err logger_start(
+  bl_alloc_tbl* alloc, bl_u32 slot_size, bool consumer_thread
+  )
+{
+  malc_cfg cfg;
+
+  bl_err err = bench_logger_create (alloc, bench_null_dst(), &cfg);
+  if (err.own) {
+    return err;
+  }
+  cfg.consumer.start_own_thread   = consumer_thread;
+  cfg.producer.timestamp          = true;
+  cfg.producer.backpressure       = consumer_thread
+    ? malc_backpressure_block : malc_backpressure_drop;
+  cfg.alloc.slot_size             = slot_size;
+  cfg.alloc.fixed_allocator_bytes = 0;
+  cfg.alloc.msg_allocator         = nullptr; /* only the TLS buffer */
+  err = bench_logger_init (alloc, &cfg);
+  if (err.own) {
+    return err;
+  }
+  err = malc_producer_thread_local_init (ilog, TLS_BYTES);
+  if (err.own) {
+    fprintf (stderr, "unable to initialize the thread local buffer\n");
+    bench_logger_destroy (alloc);
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+/* fills the TLS buffer without a consumer */
+static int entries_per_mb (bl_alloc_tbl* alloc, bl_u32 slot_size)
+{
+  bl_err err = logger_start (alloc, slot_size, false);
+  if (err.own) {
+    return err.own;
+  }
+  bl_uword entries = 0;
+  do {
+    err = log_error ("slot size bench: {}, {}", (void*) &entries, 1);
+    entries += !err.own;
+  }
+  while (!err.own);
+  bench_logger_destroy (alloc);
+  printf(
+    "slot: %2u bytes, entries per MB: %8lu\n",
+    (unsigned) slot_size,
+    (unsigned long) entries
+    );
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static int producer_latency(
+  bl_alloc_tbl* alloc, bl_u32 slot_size, bl_uword samples, bl_u32* lat_ns
+  )
+{
+  bl_err err = logger_start (alloc, slot_size, true);
+  if (err.own) {
+    return err.own;
+  }
+  bl_uword faults = 0;
+  for (bl_uword i = 0; i < samples; ++i) {
+    bl_timept64 start = bl_fast_timept_get();
+    err = log_error ("slot size bench: {}, {}", (void*) &faults, (int) i);
+    bl_timept64 end   = bl_fast_timept_get();
+    lat_ns[i] = (bl_u32) bl_fast_timept_to_nsec (end - start);
+    faults   += err.own != bl_ok;
+  }
+  bench_logger_destroy (alloc);
+  bench_sort (lat_ns, samples);
+  printf(
+    "slot: %2u bytes, p50: %5u ns, p99: %6u ns, p99.9: %7u ns, faults: %lu\n",
+    (unsigned) slot_size,
+    (unsigned) bench_percentile (lat_ns, samples, 0.5),
+    (unsigned) bench_percentile (lat_ns, samples, 0.99),
+    (unsigned) bench_percentile (lat_ns, samples, 0.999),
+    (unsigned long) faults
+    );
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  static const bl_u32 slot_sizes[] = { 16, 32, 64 };
+  bl_alloc_tbl alloc   = bl_get_default_alloc();
+  bl_uword     samples = 2000000;
+
+  if (argc > 1) {
+    samples = (bl_uword) strtoul (argv[1], nullptr, 10);
+  }
+  if (samples == 0) {
+    puts ("Usage: malc-slot-size-bench [samples]");
+    return bl_invalid;
+  }
+  bl_u32* lat_ns = (bl_u32*) malloc (samples * sizeof *lat_ns);
+  if (!lat_ns) {
+    fprintf (stderr, "Unable to allocate memory for the samples\n");
+    return bl_alloc;
+  }
+  int err = 0;
+  for (bl_uword i = 0; i < bl_arr_elems (slot_sizes) && !err; ++i) {
+    err = entries_per_mb (&alloc, slot_sizes[i]);
+  }
+  for (bl_uword i = 0; i < bl_arr_elems (slot_sizes) && !err; ++i) {
+    err = producer_latency (&alloc, slot_sizes[i], samples, lat_ns);
+  }
+  free (lat_ns);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
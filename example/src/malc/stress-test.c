@@ -102,7 +102,8 @@ static const malc_dst stress_dst_tbl = {
   stress_dst_terminate,
   stress_dst_flush,
   stress_dst_idle_task,
-  stress_dst_write
+  stress_dst_write,
+  nullptr /* write batch */
 };
 /*----------------------------------------------------------------------------*/
 static void stress_dst_set_msg_count_ptr (stress_dst* d, bl_uword* ptr)
@@ -154,6 +155,7 @@ static int througput_thread (void* ctx)
 /*----------------------------------------------------------------------------*/
 enum cfg_mode {
   cfg_tls,
+  cfg_tls_lanes,
   cfg_heap,
   cfg_queue,
   cfg_queue_cpu,
@@ -169,7 +171,8 @@ pargs;
 static void print_usage()
 {
   puts(
-    "Usage: malc-stress-test <[tls|heap|queue|queue-cpu]> <msgs> <iterations>"
+    "Usage: malc-stress-test <[tls|tls-lanes|heap|queue|queue-cpu]> <msgs> "
+    "<iterations>"
     );
 }
 /*----------------------------------------------------------------------------*/
@@ -183,6 +186,9 @@ static int parse_args(pargs* args, int argc, char const* argv[])
   if (bl_lit_strcmp (argv[1], "tls") == 0) {
     args->alloc_mode = cfg_tls;
   }
+  else if (bl_lit_strcmp (argv[1], "tls-lanes") == 0) {
+    args->alloc_mode = cfg_tls_lanes;
+  }
   else if (bl_lit_strcmp (argv[1], "heap") == 0) {
     args->alloc_mode = cfg_heap;
   }
@@ -280,6 +286,7 @@ int main (int argc, char const* argv[])
       cfg.alloc.fixed_allocator_bytes     = 0;
       cfg.alloc.fixed_allocator_max_slots = 0;
       cfg.alloc.fixed_allocator_per_cpu   = 0;
+      cfg.producer.tls_spsc_lanes = (args.alloc_mode == cfg_tls_lanes);
 
       if (args.alloc_mode == cfg_queue || args.alloc_mode == cfg_queue_cpu) {
         bl_uword div = args.alloc_mode == cfg_queue ? 1 : bl_get_cpu_count();
@@ -296,7 +303,7 @@ int main (int argc, char const* argv[])
       memset(tcontext, 0, sizeof tcontext);
       for (bl_uword th = 0; th < thread_count; ++th) {
         tcontext[th].msgs = expected_msgs / thread_count;
-        if (args.alloc_mode == cfg_tls) {
+        if (args.alloc_mode == cfg_tls || args.alloc_mode == cfg_tls_lanes) {
           tcontext[th].tls_bytes = QSIZE / thread_count;
         }
         err = bl_thread_init (&thrs[th], througput_thread, &tcontext[th]);
@@ -0,0 +1,90 @@
+/* Measures the producer side cost of a log call for each timestamp source:
+no producer timestamp, the clock ("bl_fast_timept"), the raw TSC
+("malc_producer_cfg.timestamp_tsc") and the raw TSC with delta encoding
+("malc_producer_cfg.timestamp_delta").
+
+A single producer logs through a TLS buffer big enough to never block while
+the consumer thread writes to a destination that discards everything. Without
+an invariant TSC the "tsc" rows measure the clock. */
+
+#include <bl/base/default_allocator.h>
+#include <bl/base/time.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include "bench_common.h"
+
+/*----------------------------------------------------------------------------*/
+typedef struct bench_source {
+  char const* name;
+  bool        timestamp;
+  bool        tsc;
+  bool        delta;
+}
+bench_source;
+/*----------------------------------------------------------------------------*/
+static int run_config(
+  bl_alloc_tbl* alloc, bench_source const* s, bl_uword msgs
+  )
+{
+  malc_cfg    cfg;
+  bl_timept64 start;
+  bl_u64      ns = 0;
+
+  bl_err err = bench_logger_create (alloc, bench_null_dst(), &cfg);
+  if (err.own) {
+    return err.own;
+  }
+  cfg.consumer.start_own_thread = true;
+  cfg.consumer.wait_strategy    = malc_wait_busy_spin;
+  cfg.producer.timestamp        = s->timestamp;
+  cfg.producer.timestamp_tsc    = s->tsc;
+  cfg.producer.timestamp_delta  = s->delta;
+  cfg.producer.backpressure     = malc_backpressure_block;
+  err = bench_logger_init (alloc, &cfg);
+  if (err.own) {
+    return err.own;
+  }
+  err = malc_producer_thread_local_init (ilog, msgs * 64);
+  if (err.own) {
+    fprintf (stderr, "unable to initialize the thread local buffer\n");
+    goto destroy;
+  }
+  start = bl_fast_timept_get();
+  for (bl_uword i = 0; i < msgs; ++i) {
+    (void) log_error ("entry: {}", i);
+  }
+  ns = bl_fast_timept_to_nsec (bl_fast_timept_get() - start);
+  printf ("%-12s: %7.2f ns/entry\n", s->name, (double) ns / (double) msgs);
+destroy:
+  bench_logger_destroy (alloc);
+  return err.own;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  static const bench_source sources[] = {
+    { "none",        false, false, false },
+    { "clock",       true,  false, false },
+    { "tsc",         true,  true,  false },
+    { "tsc + delta", true,  true,  true },
+  };
+  bl_alloc_tbl alloc = bl_get_default_alloc();
+  bl_uword     msgs  = 1000000;
+
+  if (argc > 1) {
+    msgs = (bl_uword) strtoul (argv[1], nullptr, 10);
+  }
+  if (msgs == 0) {
+    puts ("Usage: malc-timestamp-source-bench [msgs]");
+    return bl_invalid;
+  }
+  for (bl_uword i = 0; i < bl_arr_elems (sources); ++i) {
+    int err = run_config (&alloc, &sources[i], msgs);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,107 @@
+/* Compares the two protocols used to give back the TLS buffer memory to the
+producer: the per-slot free marks (default) against the consumer published
+"freed up to" index ("malc_producer_cfg.tls_free_index").
+
+A producer thread logs through a small TLS buffer that wraps many times, so
+the producer constantly reuses memory just freed by the consumer thread. It
+is measured with single slot entries and with multi-slot entries (a memory
+dump) for 64 and 128 byte slots. The backpressure is set to block, so no
+entries are dropped and the producer throughput is bounded by the consumer. */
+
+#include <bl/base/default_allocator.h>
+#include <bl/base/time.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include "bench_common.h"
+
+/*----------------------------------------------------------------------------*/
+static int run_config(
+  bl_alloc_tbl* alloc,
+  bl_u32        slot_size,
+  bool          free_index,
+  bool          multi_slot,
+  bl_uword      msgs,
+  bl_uword      tls_bytes
+  )
+{
+  static const bl_u8 dump[200] = { 0 };
+  malc_cfg    cfg;
+  bl_timept64 start;
+  bl_u64      ns = 0;
+
+  bl_err err = bench_logger_create (alloc, bench_null_dst(), &cfg);
+  if (err.own) {
+    return err.own;
+  }
+  cfg.consumer.start_own_thread   = true;
+  cfg.consumer.wait_strategy      = malc_wait_busy_spin;
+  cfg.producer.timestamp          = false;
+  cfg.producer.tls_free_index     = free_index;
+  cfg.producer.backpressure       = malc_backpressure_block;
+  cfg.alloc.slot_size             = slot_size;
+  cfg.alloc.fixed_allocator_bytes = 0;
+  cfg.alloc.msg_allocator         = nullptr; /* only the TLS buffer */
+  err = bench_logger_init (alloc, &cfg);
+  if (err.own) {
+    return err.own;
+  }
+  err = malc_producer_thread_local_init (ilog, tls_bytes);
+  if (err.own) {
+    fprintf (stderr, "unable to initialize the thread local buffer\n");
+    goto destroy;
+  }
+  start = bl_fast_timept_get();
+  for (bl_uword i = 0; i < msgs; ++i) {
+    if (multi_slot) {
+      (void) log_error ("{}", logmemcpy (dump, sizeof dump));
+    }
+    else {
+      (void) log_error ("entry: {}", i);
+    }
+  }
+  ns = bl_fast_timept_to_nsec (bl_fast_timept_get() - start);
+  printf(
+    "slot: %3u bytes, %-11s entries, %-10s: %7.2f ns/entry\n",
+    (unsigned) slot_size,
+    multi_slot ? "multi-slot" : "single-slot",
+    free_index ? "free index" : "free marks",
+    (double) ns / (double) msgs
+    );
+destroy:
+  bench_logger_destroy (alloc);
+  return err.own;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  static const bl_u32 slot_sizes[] = { 64, 128 };
+  bl_alloc_tbl alloc     = bl_get_default_alloc();
+  bl_uword     msgs      = 4000000;
+  bl_uword     tls_bytes = 16 * 1024;
+
+  if (argc > 1) {
+    msgs = (bl_uword) strtoul (argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    tls_bytes = (bl_uword) strtoul (argv[2], nullptr, 10);
+  }
+  if (msgs == 0 || tls_bytes == 0) {
+    puts ("Usage: malc-tls-free-index-bench [msgs] [tls_bytes]");
+    return bl_invalid;
+  }
+  for (bl_uword s = 0; s < bl_arr_elems (slot_sizes); ++s) {
+    for (unsigned multi = 0; multi < 2; ++multi) {
+      for (unsigned free_index = 0; free_index < 2; ++free_index) {
+        int err = run_config(
+          &alloc, slot_sizes[s], free_index, multi, msgs, tls_bytes
+          );
+        if (err) {
+          return err;
+        }
+      }
+    }
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
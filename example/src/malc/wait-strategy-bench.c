@@ -0,0 +1,166 @@
+/* Compares the consumer wait strategies ("malc_consumer_cfg.wait_strategy").
+
+For each strategy a single producer logs entries separated by idle gaps, so the
+consumer has to wake up for every entry. The wake-up latency is the time from
+the producer-side timestamp to the destination write. The idle CPU usage is the
+process CPU time consumed while nothing is logged (the main thread sleeps). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BL_UNPREFIXED_PRINTF_FORMATS
+#include <bl/base/default_allocator.h>
+#include <bl/base/thread.h>
+#include <bl/base/time.h>
+#include <bl/base/utility.h>
+#include <bl/base/integer_printf_format.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include "bench_common.h"
+
+/*----------------------------------------------------------------------------*/
+typedef struct bench_dst {
+  bl_u64   count;
+  bl_u64   sum_ns;
+  bl_u64   max_ns;
+}
+bench_dst;
+/*----------------------------------------------------------------------------*/
+static bl_err bench_dst_init (void* dst, bl_alloc_tbl const* alloc)
+{
+  (void) alloc;
+  bench_dst* d = (bench_dst*) dst;
+  d->count  = 0;
+  d->sum_ns = 0;
+  d->max_ns = 0;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+static bl_err bench_dst_write(
+  void* dst, bl_u64 nsec, unsigned sev_val, malc_log_strings const* strs
+  )
+{
+  (void) sev_val;
+  (void) strs;
+  bench_dst* d   = (bench_dst*) dst;
+  bl_u64     now = bl_fast_timept_to_nsec (bl_fast_timept_get());
+  bl_u64     lat = now > nsec ? now - nsec : 0;
+  ++d->count;
+  d->sum_ns += lat;
+  d->max_ns  = bl_max (d->max_ns, lat);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+static const malc_dst bench_dst_tbl = {
+  sizeof (bench_dst),
+  bench_dst_init,
+  nullptr, /* terminate */
+  nullptr, /* flush */
+  nullptr, /* idle task */
+  bench_dst_write,
+  nullptr  /* write batch */
+};
+/*----------------------------------------------------------------------------*/
+static char const* const strategy_names[] = {
+  "backoff",
+  "busy-spin",
+  "blocking",
+};
+/*----------------------------------------------------------------------------*/
+static int run_strategy(
+  bl_alloc_tbl* alloc, unsigned strategy, bl_uword samples, bl_u32 gap_us
+  )
+{
+  bench_dst* bdst = nullptr;
+  size_t     dst_id;
+  malc_cfg   cfg;
+  clock_t    cpu_start, cpu_end;
+
+  ilog = (malc*) bl_alloc (alloc, malc_get_size());
+  if (!ilog) {
+    fprintf (stderr, "Unable to allocate memory for the malc instance\n");
+    return bl_alloc;
+  }
+  bl_err err = malc_create (ilog, alloc);
+  if (err.own) {
+    fprintf (stderr, "Error creating the malc instance\n");
+    goto dealloc;
+  }
+  err = malc_add_destination (ilog, &dst_id, &bench_dst_tbl);
+  if (err.own) {
+    fprintf (stderr, "Error creating the benchmark destination\n");
+    goto destroy;
+  }
+  err = malc_get_destination_instance (ilog, (void**) &bdst, dst_id);
+  if (err.own) {
+    fprintf (stderr, "Error getting the destination instance\n");
+    goto destroy;
+  }
+  err = malc_get_cfg (ilog, &cfg);
+  if (err.own) {
+    fprintf (stderr, "bug when retrieving the logger configuration\n");
+    goto destroy;
+  }
+  cfg.consumer.start_own_thread = true;
+  cfg.consumer.wait_strategy    = strategy;
+  cfg.producer.timestamp        = true; /* latency from the log call */
+  err = malc_init (ilog, &cfg);
+  if (err.own) {
+    fprintf (stderr, "unable to start logger\n");
+    goto destroy;
+  }
+  for (bl_uword i = 0; i < samples; ++i) {
+    bl_thread_usleep (gap_us);
+    (void) log_error ("wake-up sample: {}", i);
+  }
+  (void) malc_flush (ilog);
+
+  cpu_start = clock();
+  bl_thread_usleep (samples * gap_us);
+  cpu_end = clock();
+
+  (void) malc_terminate (ilog, false);
+  printf(
+    "strategy: %-9s, wake-up latency avg: %8.2f us, max: %8.2f us, "
+      "idle CPU: %6.2f%%\n",
+    strategy_names[strategy],
+    bdst->count ? ((double) bdst->sum_ns / (double) bdst->count) / 1000. : 0.,
+    (double) bdst->max_ns / 1000.,
+    (((double) (cpu_end - cpu_start) / (double) CLOCKS_PER_SEC) * 100.) /
+      ((double) (samples * gap_us) / 1000000.)
+    );
+destroy:
+  (void) malc_destroy (ilog);
+dealloc:
+  bl_dealloc (alloc, ilog);
+  return err.own;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  bl_alloc_tbl alloc   = bl_get_default_alloc();
+  bl_uword     samples = 200;
+  bl_u32       gap_us  = 5000;
+
+  if (argc > 1) {
+    samples = (bl_uword) strtoul (argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    gap_us = (bl_u32) strtoul (argv[2], nullptr, 10);
+  }
+  if (samples == 0 || gap_us == 0) {
+    puts ("Usage: malc-wait-strategy-bench [samples] [gap_us]");
+    return bl_invalid;
+  }
+  /* "malc_wait_event_fd" requires an external event loop, it is skipped */
+  for (unsigned s = 0; s < malc_wait_event_fd; ++s) {
+    int err = run_strategy (&alloc, s, samples, gap_us);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
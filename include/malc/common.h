@@ -49,6 +49,40 @@ static inline bool malc_is_valid_severity (unsigned sev)
 }
 /*----------------------------------------------------------------------------*/
 /* MALC configuration C structs */
+/*----------------------------------------------------------------------------*/
+enum malc_backpressure_policies {
+  malc_backpressure_default, /* only valid for the per-severity overrides */
+  malc_backpressure_drop,
+  malc_backpressure_retry,
+  malc_backpressure_block,
+  malc_backpressure_count,
+};
+/*----------------------------------------------------------------------------*/
+#define MALC_SEVERITY_COUNT (malc_sev_critical - malc_sev_debug + 1)
+/*----------------------------------------------------------------------------*/
+enum malc_wait_strategies {
+  malc_wait_backoff,
+  malc_wait_busy_spin,
+  malc_wait_blocking,
+  malc_wait_event_fd,
+  malc_wait_strategy_count,
+};
+/*----------------------------------------------------------------------------*/
+/* smallest "malc_alloc_cfg.slot_size", it keeps the entry headers aligned */
+#define MALC_MIN_SLOT_SIZE 16
+/* biggest "malc_alloc_cfg.slot_size" */
+#define MALC_MAX_SLOT_SIZE (64 * 1024)
+/*----------------------------------------------------------------------------*/
+/* "malc_alloc_cfg.heap_pool_max_bytes" default */
+#define MALC_HEAP_POOL_DEFAULT_BYTES (1024 * 1024)
+/*----------------------------------------------------------------------------*/
+/* entry size classes of "malc_alloc_cfg.fixed_allocator_class_bytes" */
+enum malc_fixed_allocator_classes {
+  malc_fixed_class_1_slot,   /* 1 slot */
+  malc_fixed_class_4_slots,  /* 2 to 4 slots */
+  malc_fixed_class_big,      /* 5 to "fixed_allocator_max_slots" slots */
+  malc_fixed_class_count,
+};
 /*------------------------------------------------------------------------------
 idle_task_period_us:
 
@@ -66,11 +100,79 @@ start_own_thread:
   When this is set "malc" will launch and manage a dedicated thread for the
   consumer. If this is unset the logger's consume task is run manually from a
   user thread by using "malc_run_consume_task".
+
+batch_max_entries:
+
+  When bigger than 1 the consumer dequeues up to this number of entries in a
+  single pass, formats them into an internal buffer and hands them to the
+  destinations together. This amortizes the per-entry overhead under heavy
+  load. Pending entries are always written before flushing, terminating or
+  going idle. 0 or 1 disable batching (each entry is written as dequeued).
+
+batch_max_us:
+
+  Time limit for an incomplete batch to be retained when there are commands
+  interleaved with the log entries. 0 writes the batch at the end of each
+  dequeue pass. Only relevant when "batch_max_entries" is bigger than 1.
+
+reorder_max_entries:
+
+  When different from 0 the consumer merges the entries from all the producers
+  in timestamp order before writing them, so the output stays monotonic when
+  entries come through different queues (see "tls_spsc_lanes"). This is the
+  maximum number of entries retained for reordering. Requires producer-side
+  timestamps ("malc_producer_cfg.timestamp"), it is ignored otherwise.
+
+  Entries arriving after a newer entry has been already written can't be
+  ordered anymore. They are written as they arrive and counted on
+  "malc_stats.reorder_late_entries".
+
+reorder_window_us:
+
+  An entry is retained for reordering until there is an entry newer than it by
+  this amount of time (or until this amount of time passes without entries).
+  Only relevant when "reorder_max_entries" is different from 0.
+
+wait_strategy:
+
+  What the consumer does when there are no entries to process. One of
+  "malc_wait_strategies":
+
+  - malc_wait_backoff: spins, yields and then sleeps for increasing amounts of
+    time, up to "backoff_max_us". Adds up to "backoff_max_us" of latency when
+    logging after an idle period. The default.
+
+  - malc_wait_busy_spin: polls the queues continuously. Lowest latency, burns a
+    whole core. Meant for consumers running on a dedicated/isolated core.
+
+  - malc_wait_blocking: spins and yields as "malc_wait_backoff" and then
+    blocks until a producer enqueues something. Uses no CPU when idle at the
+    expense of an extra memory fence on each log call. Only available on
+    Linux (futex-based), it behaves as "malc_wait_backoff" elsewhere.
+
+  - malc_wait_event_fd: the consumer is driven from an external event loop
+    (e.g. epoll) by polling the fd returned by "malc_get_consumer_fd" and
+    calling "malc_run_consume_task_ready" when it becomes readable. Same
+    producer-side cost as "malc_wait_blocking". Requires "start_own_thread" to
+    be false. Only available on Linux, "malc_init" fails elsewhere.
+
+priority_max_streak:
+
+  Fairness bound for the priority queue (see "malc_producer_cfg.priority_sev").
+  The consumer dequeues at most this number of consecutive priority entries
+  before taking one from the normal queues, so the lower severities are not
+  starved during a storm of high severity entries. Must be bigger than 0.
 ------------------------------------------------------------------------------*/
 typedef struct malc_consumer_cfg {
   uint32_t idle_task_period_us;
   uint32_t backoff_max_us;
   bool     start_own_thread;
+  uint32_t batch_max_entries;
+  uint32_t batch_max_us;
+  uint32_t reorder_max_entries;
+  uint32_t reorder_window_us;
+  uint32_t wait_strategy;
+  uint32_t priority_max_streak;
 }
 malc_consumer_cfg;
 
@@ -80,9 +182,103 @@ timestamp:
   Timestamp at the producer side. It's slower but more precise. In general if
   you can't tolerate ~10ms jitter on the logging timestamp you should set this
   at the expense of performance.
+
+tls_spsc_lanes:
+
+  Each thread calling "malc_producer_thread_local_init" gets its own wait-free
+  SPSC queue for the entries allocated on its TLS buffer, instead of enqueueing
+  them on the queue shared by all producers. The consumer polls the shared
+  queue and all the thread queues in a round-robin fashion. This avoids
+  contention on the shared queue when there are many producers.
+
+  The entries allocated by other means (fixed allocator, heap) and the internal
+  commands still use the shared queue, so the entries of a thread might be
+  written out of order when its TLS buffer gets exhausted. Flushing and
+  terminating drain all the thread queues.
+
+backpressure:
+
+  What a log call does when all the memory sources (TLS, fixed allocator, heap)
+  are exhausted. One of "malc_backpressure_policies":
+
+  - malc_backpressure_drop: the entry is dropped, the log call returns
+    "bl_alloc". The default.
+
+  - malc_backpressure_retry: retries the allocation (spinning, yielding and
+    then sleeping) until the consumer frees space or "backpressure_retry_us"
+    expires. Then it behaves as "malc_backpressure_drop".
+
+  - malc_backpressure_block: retries the allocation until the consumer frees
+    space. Never use this from the thread running the consume task (see
+    "start_own_thread") as it would deadlock.
+
+  Entries that don't fit on any allocator at all (too big) are always dropped.
+
+backpressure_sev:
+
+  Per-severity overrides of "backpressure", indexed by "severity -
+  malc_sev_debug", e.g. to block on critical entries while dropping the debug
+  ones. "malc_backpressure_default" (0) uses "backpressure".
+
+backpressure_retry_us:
+
+  Time limit for "malc_backpressure_retry".
+
+priority_sev:
+
+  Entries with this severity or higher are sent through a separate queue that
+  the consumer drains first, so e.g. errors don't wait behind a backlog of
+  debug entries. These entries bypass "tls_spsc_lanes" and can be written
+  before older entries of lower severity. "malc_sev_off" disables it (default).
+  See "malc_consumer_cfg.priority_max_streak".
+
+tls_free_index:
+
+  Changes how the consumer gives back the TLS buffer memory. By default it
+  marks each freed slot and the producer reads the marks of the slots it is
+  going to use, which moves a cache line from the consumer to the producer for
+  each slot. With this set the consumer publishes a single "freed up to"
+  index instead, which the producer only reads when its buffer looks full.
+  The allocations get a pointer-sized trailer, so some entries take one more
+  slot. Taken by "malc_producer_thread_local_init".
+
+timestamp_delta:
+
+  With "timestamp" set, the entries allocated on the TLS buffer of a thread
+  carry a 16 or 32-bit difference against the timestamp of the previous entry
+  of the same thread instead of the full 64-bit value (4 or 6 bytes less per
+  entry). The full value is still sent periodically and when the difference
+  doesn't fit. The consumer rebuilds the absolute timestamps.
+
+  It requires decoding the entries of each thread in order, so it is ignored
+  when "tls_spsc_lanes" or the reorder buffer (see
+  "malc_consumer_cfg.reorder_max_entries") are enabled. Priority entries (see
+  "priority_sev") and entries not allocated on the TLS buffers always have the
+  full timestamp.
+
+timestamp_tsc:
+
+  With "timestamp" set, the producers store the raw x86-64 time stamp counter
+  ("rdtsc") instead of reading the clock. The consumer converts it to the same
+  nanoseconds the clock would give with a calibration that is refreshed from
+  the idle task (see "idle_task_period_us") to follow the drift. Ignored when
+  the CPU doesn't have an invariant TSC or on other architectures, then the
+  clock is used as usual.
+
+  Measured on a virtualized Xeon (Linux, "tsc" clocksource), a clock read
+  through the vDSO took ~38ns and "rdtsc" ~23ns, so each log call saves ~15ns.
+  Run "malc-example-timestamp-source-bench" for the full log call cost.
 ------------------------------------------------------------------------------*/
 typedef struct malc_producer_cfg {
-  bool timestamp;
+  bool     timestamp;
+  bool     tls_spsc_lanes;
+  uint8_t  backpressure;
+  uint8_t  backpressure_sev[MALC_SEVERITY_COUNT];
+  uint32_t backpressure_retry_us;
+  uint8_t  priority_sev;
+  bool     tls_free_index;
+  bool     timestamp_delta;
+  bool     timestamp_tsc;
 }
 malc_producer_cfg;
 /*------------------------------------------------------------------------------
@@ -94,11 +290,21 @@ msg_allocator:
   allocator is only used to enqueue log entries, the  memory required by the
   logger's internals is taken from the allocator passed on "malc_init".
 
+  The default is an internal pool, see "heap_pool_max_bytes". It can be
+  replaced by any other allocator or set to null to disable the heap.
+
 slot_size:
 
   All allocations for the producer's consumer queue are rounded to the ceiling
   against this value. Usually this is intended to be set as the size in bytes
-  of your machine's cache line.
+  of your machine's cache line. It has to be a power of 2 from
+  "MALC_MIN_SLOT_SIZE" to "MALC_MAX_SLOT_SIZE" bytes. Smaller slots (16 or 32
+  bytes) waste less of the thread local buffers and the fixed allocators on
+  padding when most entries are small, at the cost of more false sharing
+  between the producer and the consumer. The heap allocations (see
+  "msg_allocator") are not rounded. Like the rest of this struct it has to be
+  set (by "malc_init") before the threads call
+  "malc_producer_thread_local_init".
 
 fixed_allocator_bytes:
 
@@ -114,14 +320,95 @@ fixed_allocator_max_slots:
 
   Note that the current fixed allocator implementation has unavoidable
   unfairness; when in contention smaller slot sizes have more probabilities to
-  win the contention, starving bigger slot size allocations.
+  win the contention, starving bigger slot size allocations. See
+  "fixed_allocator_class_bytes".
 
 fixed_allocator_per_cpu:
 
   Create one fixed allocator for each CPU core. This is an optimization (or
   pessimization: measure your performance) to alleviate false sharing. Note that
   "fixed_allocator_bytes" is not divided by the number of CPUs when this setting
-  this active, it's still the size of each allocator.
+  this active, it's still the size of each allocator. On Linux with glibc 2.35
+  or newer the CPU number is read from the kernel "rseq" area on every call,
+  otherwise it is refreshed every 64 calls.
+
+tls_segment_bytes:
+
+  When different from 0 the thread local buffers (see
+  "malc_producer_thread_local_init") can grow: when a buffer is full the thread
+  links an extra segment of this size taken from a pool shared by all the
+  threads, instead of falling back to the fixed or the dynamic allocator. This
+  allows starting with small thread local buffers. A thread gives a segment
+  back to the pool after a full lap on its own buffer without needing the
+  segments. 0 disables the growth (default).
+
+  Like the rest of this struct it has to be set (by "malc_init") before the
+  threads call "malc_producer_thread_local_init".
+
+tls_max_segments:
+
+  Maximum number of segments linked to a single thread local buffer.
+
+tls_max_total_segments:
+
+  Maximum number of segments allocated by the instance, the pool doesn't grow
+  further. The segments are only deallocated when the instance is destroyed.
+
+buffers_huge_pages:
+
+  The thread local buffers, their segments and the fixed allocator queues are
+  mapped directly with "mmap" (instead of being taken from the allocator passed
+  on "malc_create") and the ones of at least 2MB are placed on huge pages, to
+  reduce the TLB misses on the producer side. When no huge pages are reserved
+  on the system it falls back to transparent huge pages ("madvise"). The sizes
+  are rounded up to 2MB after adding some bookkeeping, so sizes a bit below a
+  multiple of 2MB waste the least memory. Linux only.
+
+buffers_numa_local:
+
+  The same "mmap" backing as "buffers_huge_pages". The thread local buffers
+  prefer the NUMA node of the thread that initializes them (see
+  "malc_producer_thread_local_init") and each "fixed_allocator_per_cpu" queue
+  prefers the NUMA node of its CPU. It is to be combined with threads pinned to
+  a CPU or to a node. Linux only.
+
+fixed_allocator_class_bytes:
+
+  When any of them is different from 0 the fixed allocator is split on separate
+  queues by entry size (in slots, see "malc_fixed_allocator_classes") and
+  "fixed_allocator_bytes" is ignored. Each element is the size of the queue of
+  its class. The entries only compete with entries of a similar size, so big
+  entries have a guaranteed capacity instead of being starved by the small
+  ones when mixing them. A class with 0 bytes is disabled: its entries skip the
+  fixed allocator. "fixed_allocator_max_slots" still limits the biggest entry
+  and "fixed_allocator_per_cpu" applies to every class.
+
+buffers_prefault:
+
+  Every page of the thread local buffers, their segments and the fixed
+  allocator queues is touched when they are allocated (on
+  "malc_producer_thread_local_init", when a segment is created and on
+  "malc_init"), so the first log calls writing on them don't take the page
+  faults. Can be combined with "buffers_huge_pages" and "buffers_numa_local".
+  The faults taken are reported on "malc_stats.prefault_page_faults".
+
+buffers_lock:
+
+  As "buffers_prefault" and the pages are also locked in RAM ("mlock"), so
+  they are never swapped out. When the lock fails (e.g. because of a low
+  "RLIMIT_MEMLOCK") the memory is still pre-faulted. The bytes locked are on
+  "malc_stats.locked_bytes". POSIX only.
+
+heap_pool_max_bytes:
+
+  The default "msg_allocator" keeps the entries that it frees (rounded to power
+  of 2 sizes of up to 64KB) on lock-free per-thread free lists instead of
+  returning them to the allocator passed on "malc_init", so bursts overflowing
+  the buffers above don't do a "malloc" on the producer and a "free" on the
+  consumer for every entry. This is the maximum of bytes that the pool can
+  hold. Once reached, or for bigger entries, the allocator passed on
+  "malc_init" is used as usual. 0 disables the pooling. The bytes taken are on
+  "malc_stats.heap_pool_bytes". Ignored when "msg_allocator" is replaced.
 
 ------------------------------------------------------------------------------*/
 typedef struct malc_alloc_cfg {
@@ -130,6 +417,15 @@ typedef struct malc_alloc_cfg {
   uint32_t            fixed_allocator_bytes;
   uint32_t            fixed_allocator_max_slots;
   bool                fixed_allocator_per_cpu;
+  uint32_t            tls_segment_bytes;
+  uint32_t            tls_max_segments;
+  uint32_t            tls_max_total_segments;
+  bool                buffers_huge_pages;
+  bool                buffers_numa_local;
+  uint32_t            fixed_allocator_class_bytes[malc_fixed_class_count];
+  bool                buffers_prefault;
+  bool                buffers_lock;
+  uint32_t            heap_pool_max_bytes;
 }
 malc_alloc_cfg;
 /*------------------------------------------------------------------------------
@@ -171,6 +467,65 @@ typedef struct malc_cfg {
 }
 malc_cfg;
 /*----------------------------------------------------------------------------*/
+enum malc_drop_reasons {
+  malc_drop_no_memory,   /* all the memory sources were exhausted */
+  malc_drop_too_big,     /* the entry exceeds the maximum entry size */
+  malc_drop_not_running, /* logged before "malc_init" or after termination */
+  malc_drop_reason_count,
+};
+/*------------------------------------------------------------------------------
+Runtime counters. See "malc_get_stats".
+
+reorder_late_entries:
+
+  Entries that arrived too late to be written in timestamp order. See
+  "reorder_max_entries".
+
+dropped_entries, dropped_bytes:
+
+  Log entries rejected on the producer side (the log call returned an error),
+  indexed by "malc_drop_reasons". The bytes are the serialized entry sizes.
+
+  The producers count the drops on their TLS buffer (or on shared counters if
+  they don't have one). The consumer task collects them and writes a warning
+  entry on the log output for each reason with new drops, e.g:
+
+  "[malc] 1234 entries (56789 bytes) dropped (no memory) since t=..."
+
+  These counters only include the drops already reported by the consumer.
+
+prefault_page_faults:
+
+  Page faults taken when allocating the buffers with "buffers_prefault" (or
+  "buffers_lock"), i.e. the ones that the log calls didn't take. On platforms
+  other than Linux these are the pages touched.
+
+locked_bytes:
+
+  Bytes currently locked in RAM by "buffers_lock".
+
+heap_pool_bytes:
+
+  Bytes taken by the pool of the default "msg_allocator", including the free
+  blocks. See "malc_alloc_cfg.heap_pool_max_bytes".
+
+write_error_entries:
+
+  Entries that the destinations failed to write ("write" or "write_batch" on
+  "malc_dst" returned an error), counted once per destination. A failed
+  "write_batch" counts all the entries of the batch.
+------------------------------------------------------------------------------*/
+typedef struct malc_stats {
+  uint64_t reorder_late_entries;
+  uint64_t dropped_entries[malc_drop_reason_count];
+  uint64_t dropped_bytes[malc_drop_reason_count];
+  uint64_t prefault_page_faults;
+  uint64_t locked_bytes;
+  uint64_t heap_pool_bytes;
+  uint64_t write_error_entries;
+}
+malc_stats;
+/*----------------------------------------------------------------------------*/
 /* Destination(sink) C structures */
 /*------------------------------------------------------------------------------
 timestamp:     timestamp string (from a monotonic clock).
@@ -190,6 +545,26 @@ typedef struct malc_log_strings {
 }
 malc_log_strings;
 /*------------------------------------------------------------------------------
+nsec:    monotonic clock timestamp of the entry.
+sev_val: severity.
+strs:    log strings.
+------------------------------------------------------------------------------*/
+typedef struct malc_log_entry {
+  uint64_t         nsec;
+  unsigned         sev_val;
+  malc_log_strings strs;
+}
+malc_log_entry;
+/*------------------------------------------------------------------------------
+entries: formatted log entries, in the same order as they were dequeued.
+count:   number of entries. Never zero.
+------------------------------------------------------------------------------*/
+typedef struct malc_log_entry_batch {
+  malc_log_entry const* entries;
+  size_t                count;
+}
+malc_log_entry_batch;
+/*------------------------------------------------------------------------------
 log_rate_filter_time_ns:
 
   Rate filter period. The same log entry arriving before this time will be
@@ -278,6 +653,16 @@ write:
     nsec:     current monotonic clock timestamp, can be used internally.
     sev_val:  severity.
     strs: log strings.
+
+write_batch:
+
+  Writes many log entries at once, e.g. to coalesce them on a single syscall.
+  Called instead of "write" when the consumer has many formatted entries ready
+  (see "batch_max_entries" on "malc_consumer_cfg"). The batch has already been
+  filtered for this destination (severity, "show_timestamp", "show_severity").
+  The batch and its strings are only valid during the call. An error means
+  that the whole batch was lost (see "malc_stats.write_error_entries"). This
+  function pointer can be set to null, then "write" is called once per entry.
 ------------------------------------------------------------------------------*/
 typedef struct malc_dst {
   size_t size_of;
@@ -291,6 +676,7 @@ typedef struct malc_dst {
     unsigned                sev_val,
     malc_log_strings const* strs
     );
+  bl_err (*write_batch)(void* instance, malc_log_entry_batch const* batch);
 }
 malc_dst;
 /*------------------------------------------------------------------------------
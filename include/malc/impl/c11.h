@@ -51,6 +51,7 @@
     ) /* endif */ \
     (char) malc_end \
   }; \
+  static uintptr_t bl_pp_tokconcat(malc_callsite_, __LINE__); \
   static const malc_const_entry bl_pp_tokconcat(malc_const_entry_, __LINE__) = { \
     /* "" is prefixed to forbid compilation of non-literal format strings*/ \
     "" bl_pp_vargs_first (__VA_ARGS__), \
@@ -62,7 +63,8 @@
         ) \
     ,/* else */ \
       0 \
-    )/* endif */\
+    )/* endif */, \
+    &bl_pp_tokconcat (malc_callsite_, __LINE__) \
   }
 /*----------------------------------------------------------------------------*/
 #define malc_make_vars_assign_reftypes(expression, name)\
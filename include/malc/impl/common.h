@@ -20,6 +20,7 @@
     char const* format;
     char const* info; /* first char is the severity */
     uint16_t    compressed_count;
+    uintptr_t*  callsite; /* id cache, owned by the library. Can be null */
   }
   malc_const_entry;
 #endif
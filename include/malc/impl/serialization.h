@@ -52,6 +52,8 @@ namespace malcpp { namespace detail { namespace serialization {
 #define MALC_CONSTEXPR
 #endif
 /*----------------------------------------------------------------------------*/
+/* "format_nibble" is the byte count minus one. Its MSB is the sign flag on the
+"nibble" format, on "group_varint" the signed values are zigzag encoded. */
 typedef struct malc_compressed_32 {
   uint32_t v;
   unsigned format_nibble; /*1 bit sign + 3 bit size (0-7)*/
@@ -82,6 +84,8 @@ static inline malc_compressed_32 malc_get_compressed_u32 (uint32_t v)
   return r;
 }
 /*----------------------------------------------------------------------------*/
+#if MALC_BUILTIN_COMPRESSION_GROUP_VARINT == 0
+/*----------------------------------------------------------------------------*/
 static inline malc_compressed_32 malc_get_compressed_i32 (int32_t v)
 {
   malc_compressed_32 r = malc_get_compressed_u32 ((uint32_t) (v < 0 ? ~v : v));
@@ -104,6 +108,43 @@ static inline malc_compressed_64 malc_get_compressed_i64 (int64_t v)
   return r;
 }
 /*----------------------------------------------------------------------------*/
+#else /* MALC_BUILTIN_COMPRESSION_GROUP_VARINT == 0 */
+/*----------------------------------------------------------------------------*/
+static inline malc_compressed_32 malc_get_compressed_i32 (int32_t v)
+{
+  uint32_t u = (uint32_t) v;
+  return malc_get_compressed_u32 ((u << 1) ^ (0u - (u >> 31)));
+}
+/*----------------------------------------------------------------------------*/
+/* 2 bits per field: the sizes are rounded to 1, 2, 4 or 8 bytes */
+static inline malc_compressed_64 malc_get_compressed_u64 (uint64_t v)
+{
+  unsigned size = v ? bl_log2_floor_unsafe_u64 (v) / 8 + 1 : 1;
+  malc_compressed_64 r;
+  r.v             = v;
+  r.format_nibble = (size <= 2 ? size : (size <= 4 ? 4 : 8)) - 1;
+  return r;
+}
+/*----------------------------------------------------------------------------*/
+static inline malc_compressed_64 malc_get_compressed_i64 (int64_t v)
+{
+  uint64_t u = (uint64_t) v;
+  return malc_get_compressed_u64 ((u << 1) ^ (0ull - (u >> 63)));
+}
+/*----------------------------------------------------------------------------*/
+/* 2-bit field codes: 32-bit sizes are 1 to 4 bytes, 64-bit ones 1, 2, 4, 8 */
+static inline MALC_CONSTEXPR unsigned malc_gvarint_code32 (unsigned nibble)
+{
+  return nibble & 3;
+}
+/*----------------------------------------------------------------------------*/
+static inline MALC_CONSTEXPR unsigned malc_gvarint_code64 (unsigned nibble)
+{
+  return ((nibble + 1) >> 1) - ((nibble + 1) >> 3);
+}
+/*----------------------------------------------------------------------------*/
+#endif /* MALC_BUILTIN_COMPRESSION_GROUP_VARINT == 0 */
+/*----------------------------------------------------------------------------*/
 static inline void wrong (void) {}
 /*----------------------------------------------------------------------------*/
 #ifndef __cplusplus
@@ -258,7 +299,12 @@ static inline void MALC_SERIALIZE(_comp32)(
   bl_assert (size <= sizeof (uint32_t));
   uint8_t* hdr = s->compressed_header;
   unsigned idx = s->compressed_header_idx;
+#if MALC_BUILTIN_COMPRESSION_GROUP_VARINT == 0
   hdr[idx / 2] |= (uint8_t) v.format_nibble << ((idx & 1) * 4);
+#else
+  hdr[idx / 4] |=
+    (uint8_t) malc_gvarint_code32 (v.format_nibble) << ((idx & 3) * 2);
+#endif
   ++s->compressed_header_idx;
   for (unsigned i = 0; i < size; ++i) {
     *s->field_mem = (uint8_t) (v.v >> (i * 8));
@@ -274,7 +320,12 @@ static inline void MALC_SERIALIZE(_comp64)(
   unsigned size = malc_compressed_get_size (v.format_nibble);
   uint8_t* hdr  = s->compressed_header;
   unsigned idx  = s->compressed_header_idx;
+#if MALC_BUILTIN_COMPRESSION_GROUP_VARINT == 0
   hdr[idx / 2] |= (uint8_t) v.format_nibble << ((idx & 1) * 4);
+#else
+  hdr[idx / 4] |=
+    (uint8_t) malc_gvarint_code64 (v.format_nibble) << ((idx & 3) * 2);
+#endif
   ++s->compressed_header_idx;
   for (unsigned i = 0; i < size; ++i) {
     *s->field_mem = (uint8_t) (v.v >> (i * 8));
@@ -43,6 +43,11 @@ extern MALC_EXPORT bl_err malc_get_cfg (malc const* l, malc_cfg* cfg);
 /*----------------------------------------------------------------------------*/
 extern MALC_EXPORT bl_err malc_init (malc* l, malc_cfg const* cfg);
 /*------------------------------------------------------------------------------
+Gets the runtime counters. Safe to call from any thread; the values are updated
+by the consumer task and might be slightly outdated.
+------------------------------------------------------------------------------*/
+extern MALC_EXPORT bl_err malc_get_stats (malc const* l, malc_stats* stats);
+/*------------------------------------------------------------------------------
 Sends a flush command message to the logger queue and waits until it is dequeued
 and processed (all destinations have been flushed). As this call is blocking,
 when this call unblocks all the messages logged from this thread have already
@@ -53,6 +58,35 @@ will block forever.
 ------------------------------------------------------------------------------*/
 extern MALC_EXPORT bl_err malc_flush (malc* l);
 /*------------------------------------------------------------------------------
+Non-blocking flush. Requests a flush of all the messages logged from this
+thread until now and returns a ticket to check its completion with
+"malc_is_flushed" or "malc_wait_flushed".
+
+Tickets are monotonically increasing. Concurrent requests share the same flush
+command when possible, so many threads can request flushes without flooding the
+queue. A completed ticket implies that all the previous ones are completed too.
+
+returns bl_ok:            "ticket" is valid.
+        bl_preconditions: Malc library not running.
+------------------------------------------------------------------------------*/
+extern MALC_EXPORT bl_err malc_flush_async (malc* l, size_t* ticket);
+/*------------------------------------------------------------------------------
+Returns true if the flush requested with "ticket" (see "malc_flush_async") has
+been processed (all destinations flushed). Never blocks. Tickets are also
+considered flushed once the logger is terminated.
+------------------------------------------------------------------------------*/
+extern MALC_EXPORT bool malc_is_flushed (malc const* l, size_t ticket);
+/*------------------------------------------------------------------------------
+Waits until the flush requested with "ticket" (see "malc_flush_async") is
+processed or until "timeout_us" expires. 0 just checks.
+
+returns bl_ok:      Flushed.
+        bl_timeout: Timed out.
+------------------------------------------------------------------------------*/
+extern MALC_EXPORT bl_err malc_wait_flushed(
+  malc* l, size_t ticket, unsigned timeout_us
+  );
+/*------------------------------------------------------------------------------
 Sends the termination command to the logger.
 
 When the termination state is reached no further log messages can be enqueued;
@@ -75,6 +109,9 @@ This functions returns:
 - "bl_ok": The command executed successfully.
 - "bl_preconditions": The termination command wasn't sent, as the logger wasn't
   either recognized as being running or it was already terminated.
+- "bl_locked": Blocking call from a thread not owning the consumer (see
+  "malc_consumer_acquire") and the owner didn't process the command within a
+  second. The command was sent, the owner will process it.
 - other errors: unexpected error conditions.
 
 "malc_destroy" always calls this function.
@@ -133,12 +170,15 @@ share the thread that runs malc's consumer function for other purposes.
 This function is thread safe by means of blocking a mutex, so it's safe to
 change the thread that runs it without extra synchronization. The mutex blocks,
 doesn't return early; this function is intended to be run from a single thread.
+The mutex is skipped when the calling thread owns the consumer, see
+"malc_consumer_acquire".
 
 timeout_us: timeout to block before returning. 0 just runs one iteration.
 
 returns bl_ok:            Consumer not in idle-state.
         bl_nothing_to_do: Consumer in idle-state.
         bl_preconditions: Malc library not ready to run (no init, terminated...)
+        bl_locked:        Another thread owns the consumer.
 
 Notice that when you run the consume task yourself you have to make sure by
 using your own means that your consumer thread doesn't call
@@ -149,6 +189,60 @@ destruct malc.
 ------------------------------------------------------------------------------*/
 extern MALC_EXPORT bl_err malc_run_consume_task (malc* l, unsigned timeout_us);
 /*------------------------------------------------------------------------------
+Claims exclusive ownership of the consumer for the calling thread. While owned,
+"malc_run_consume_task" and "malc_run_consume_task_ready" don't lock any mutex
+when called from the owner thread and fail with "bl_locked" when called from
+any other thread.
+
+This is for when the consume task is run very often from a single thread (e.g.
+from an event loop). The thread launched by "malc_cfg.consumer.start_own_thread"
+owns the consumer while it runs.
+
+The ownership can be handed off to another thread: the owner calls
+"malc_consumer_release" and then the new thread calls this function.
+"malc_terminate" can be called from any thread, when it blocks and the caller
+isn't the owner it waits for the owner to process the termination (bounded).
+
+The ownership is released automatically when the owner thread exits.
+
+returns bl_ok:     The calling thread owns the consumer (or did already).
+        bl_locked: Another thread owns the consumer.
+------------------------------------------------------------------------------*/
+extern MALC_EXPORT bl_err malc_consumer_acquire (malc* l);
+/*------------------------------------------------------------------------------
+Releases the consumer ownership taken with "malc_consumer_acquire". Afterwards
+the consume task functions go back to lock the mutex.
+
+returns bl_ok:            Released.
+        bl_preconditions: The calling thread doesn't own the consumer.
+------------------------------------------------------------------------------*/
+extern MALC_EXPORT bl_err malc_consumer_release (malc* l);
+/*------------------------------------------------------------------------------
+Gets a file descriptor to integrate the consumer with an existing event loop
+(e.g. epoll). Only available when "malc_consumer_cfg.wait_strategy" is
+"malc_wait_event_fd" and after "malc_init".
+
+The fd becomes readable when there are entries or commands to process or when
+the consumer has deadlines to attend (idle task, entry reordering). Then
+"malc_run_consume_task_ready" has to be called. The fd is owned by malc, it
+must only be polled for readability; it is closed by "malc_destroy".
+
+returns bl_ok:            "fd" is valid.
+        bl_preconditions: Not initialized or on another wait strategy.
+------------------------------------------------------------------------------*/
+extern MALC_EXPORT bl_err malc_get_consumer_fd (malc const* l, int* fd);
+/*------------------------------------------------------------------------------
+Non-blocking version of "malc_run_consume_task" to be used together with
+"malc_get_consumer_fd". Processes everything that is ready until the queues are
+empty, runs the idle task if due and rearms the consumer fd.
+
+returns bl_ok:            Some entries or commands were processed.
+        bl_nothing_to_do: Nothing was processed (e.g. spurious readiness).
+        bl_preconditions: Malc library not ready to run (no init, terminated,
+                          not on the "malc_wait_event_fd" strategy).
+------------------------------------------------------------------------------*/
+extern MALC_EXPORT bl_err malc_run_consume_task_ready (malc* l);
+/*------------------------------------------------------------------------------
 Adds a destination. Can only be added before initializing (calling "malc_init").
 
 If run-time modifications are done to the instance/object, keep in mind thread
@@ -3,6 +3,8 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <type_traits>
+#include <utility>
 
 #include <bl/base/platform.h>
 #include <bl/base/error.h>
@@ -67,6 +69,26 @@ private:
   /*--------------------------------------------------------------------------*/
 };
 /*----------------------------------------------------------------------------*/
+namespace detail {
+
+template <class T>
+class has_write_batch {
+private:
+  template <class U>
+  static auto test (int) -> decltype(
+    std::declval<U&>().write_batch(
+      std::declval<malc_log_entry_batch const&>()
+      ),
+    std::true_type()
+    );
+  template <class>
+  static std::false_type test (...);
+public:
+  static constexpr bool value = decltype (test<T> (0))::value;
+};
+
+} // namespace detail
+/*----------------------------------------------------------------------------*/
 /* machinery to avoid all the destination boilerplate on C++ and be able to
 make an straight-to-the-point destination implementation.
 
@@ -76,6 +98,11 @@ class required_destination_methods {
   bool idle_task();
   bool write (uint64_t nsec, size_t severity, malc_log_strings const& strs);
 }
+
+Optionally, the class can have a method to write many entries at once. It will
+be forwarded when present (see "write_batch" on "malc_dst"):
+
+  bool write_batch (malc_log_entry_batch const& batch);
 ------------------------------------------------------------------------------*/
 template <class uppermost_derivation>
 class destination_adapter : public uppermost_derivation {
@@ -85,15 +112,36 @@ private:
   static malc_dst get_dst_tbl()
   {
     malc_dst d;
-    d.size_of   = sizeof (uppermost_derivation);
-    d.init      = fwd_init;
-    d.terminate = fwd_terminate;
-    d.flush     = fwd_flush;
-    d.idle_task = fwd_idle_task;
-    d.write     = fwd_write;
+    d.size_of     = sizeof (uppermost_derivation);
+    d.init        = fwd_init;
+    d.terminate   = fwd_terminate;
+    d.flush       = fwd_flush;
+    d.idle_task   = fwd_idle_task;
+    d.write       = fwd_write;
+    d.write_batch = get_fwd_write_batch<uppermost_derivation>();
     return d;
   }
   /*--------------------------------------------------------------------------*/
+  typedef bl_err (*write_batch_fn) (void*, malc_log_entry_batch const*);
+  /*--------------------------------------------------------------------------*/
+  template <class T>
+  static typename std::enable_if<
+    detail::has_write_batch<T>::value, write_batch_fn
+    >::type
+  get_fwd_write_batch()
+  {
+    return fwd_write_batch;
+  }
+  /*--------------------------------------------------------------------------*/
+  template <class T>
+  static typename std::enable_if<
+    !detail::has_write_batch<T>::value, write_batch_fn
+    >::type
+  get_fwd_write_batch()
+  {
+    return nullptr;
+  }
+  /*--------------------------------------------------------------------------*/
   static bl_err fwd_init (void* instance, bl_alloc_tbl const* alloc)
   {
     return try_catch_wrap ([=](){
@@ -137,6 +185,14 @@ private:
     });
   }
   /*--------------------------------------------------------------------------*/
+  static bl_err fwd_write_batch (void* instance, malc_log_entry_batch const* b)
+  {
+    return try_catch_wrap ([=](){
+      return derived (instance).write_batch (*b) ?
+        bl_mkok() : bl_mkerr (bl_error);
+    });
+  }
+  /*--------------------------------------------------------------------------*/
   static inline uppermost_derivation& derived (void* instance)
   {
     return *static_cast<uppermost_derivation*> (instance);
@@ -263,10 +263,12 @@ static inline bl_err log(
           ) \
     >() == ::malcpp::detail::fmt::fmterr_success_with_refs; \
   if ((cond) && (sev) >= malc_get_min_severity (malcptr)) { \
+    static uintptr_t callsite = 0; \
     static const malc_const_entry msgdata =  {\
       bl_pp_vargs_first (__VA_ARGS__), /*1st arg = format str*/\
       ::malcpp::detail::info<sev, argtypelist>::generate(), \
-      ::malcpp::detail::count_compressed<argtypelist>::run() \
+      ::malcpp::detail::count_compressed<argtypelist>::run(), \
+      &callsite \
     }; \
     err = ::malcpp::detail::log( \
       std::integral_constant<bool, has_references>(), \
@@ -40,6 +40,7 @@ namespace malcpp {
 typedef malc_cfg         cfg;
 typedef malc_dst_cfg     dst_cfg;
 typedef malc_log_strings log_strings;
+typedef malc_stats       stats;
 
 enum {
   sev_debug    = malc_sev_debug,
@@ -170,18 +171,34 @@ public:
   /*--------------------------------------------------------------------------*/
   bl_err get_cfg (cfg& c) const noexcept;
   /*--------------------------------------------------------------------------*/
+  bl_err get_stats (stats& s) const noexcept;
+  /*--------------------------------------------------------------------------*/
   bl_err init (cfg const& c) noexcept;
     /*--------------------------------------------------------------------------*/
   bl_err init() noexcept;
   /*--------------------------------------------------------------------------*/
   bl_err flush() noexcept;
   /*--------------------------------------------------------------------------*/
+  bl_err flush_async (size_t& ticket) noexcept;
+  /*--------------------------------------------------------------------------*/
+  bool is_flushed (size_t ticket) const noexcept;
+  /*--------------------------------------------------------------------------*/
+  bl_err wait_flushed (size_t ticket, unsigned timeout_us) noexcept;
+  /*--------------------------------------------------------------------------*/
   bl_err terminate (bool dontblock = false) noexcept;
   /*--------------------------------------------------------------------------*/
   bl_err producer_thread_local_init (size_t bytes) noexcept;
   /*--------------------------------------------------------------------------*/
   bl_err run_consume_task (unsigned timeout_us) noexcept;
   /*--------------------------------------------------------------------------*/
+  bl_err consumer_acquire() noexcept;
+  /*--------------------------------------------------------------------------*/
+  bl_err consumer_release() noexcept;
+  /*--------------------------------------------------------------------------*/
+  bl_err get_consumer_fd (int& fd) const noexcept;
+  /*--------------------------------------------------------------------------*/
+  bl_err run_consume_task_ready() noexcept;
+  /*--------------------------------------------------------------------------*/
   bl_err add_destination (size_t& dest_id, malc_dst const& dst) noexcept;
   /*--------------------------------------------------------------------------*/
   bl_err
@@ -255,6 +272,13 @@ public:
     return r;
   }
   /*--------------------------------------------------------------------------*/
+  stats get_stats() const
+  {
+    stats r;
+    detail::throw_if_error (wrapper::get_stats (r));
+    return r;
+  }
+  /*--------------------------------------------------------------------------*/
   void init (cfg const& cfg)
   {
     detail::throw_if_error (wrapper::init (cfg));
@@ -270,6 +294,26 @@ public:
     detail::throw_if_error (wrapper::flush());
   }
   /*--------------------------------------------------------------------------*/
+  size_t flush_async()
+  {
+    size_t ticket;
+    detail::throw_if_error (wrapper::flush_async (ticket));
+    return ticket;
+  }
+  /*--------------------------------------------------------------------------*/
+  using wrapper::is_flushed;
+  /*--------------------------------------------------------------------------*/
+  /* returns false on timeout */
+  bool wait_flushed (size_t ticket, unsigned timeout_us)
+  {
+    bl_err err = wrapper::wait_flushed (ticket, timeout_us);
+    if (err.own == bl_timeout) {
+      return false;
+    }
+    detail::throw_if_error (err);
+    return true;
+  }
+  /*--------------------------------------------------------------------------*/
   void terminate (bool dontblock = false)
   {
     detail::throw_if_error (wrapper::terminate (dontblock));
@@ -293,6 +337,42 @@ public:
     return false; /* unreachable */
   }
   /*--------------------------------------------------------------------------*/
+  /* returns false if another thread owns the consumer */
+  bool consumer_acquire()
+  {
+    bl_err err = wrapper::consumer_acquire();
+    if (err.own == bl_locked) {
+      return false;
+    }
+    detail::throw_if_error (err);
+    return true;
+  }
+  /*--------------------------------------------------------------------------*/
+  void consumer_release()
+  {
+    detail::throw_if_error (wrapper::consumer_release());
+  }
+  /*--------------------------------------------------------------------------*/
+  int get_consumer_fd() const
+  {
+    int fd;
+    detail::throw_if_error (wrapper::get_consumer_fd (fd));
+    return fd;
+  }
+  /*--------------------------------------------------------------------------*/
+  bool run_consume_task_ready()
+  {
+    bl_err err = wrapper::run_consume_task_ready();
+    if (!err.own || err.own == bl_nothing_to_do) {
+      return true;
+    }
+    if (err.own == bl_preconditions) {
+      return false;
+    }
+    detail::throw_if_error (err);
+    return false; /* unreachable */
+  }
+  /*--------------------------------------------------------------------------*/
   size_t add_destination (malc_dst const& dst)
   {
     size_t r;;
@@ -4,6 +4,7 @@
 #include <bl/base/assert.h>
 
 #include <malc/bounded_buffer.h>
+#include <malc/rseq_cpu.h>
 
 /* Preliminary implementation based on a modded D.Vjukov bl_mpmc type of queue */
 
@@ -18,43 +19,95 @@ b_cpu_data;
 /*---------------------------------------------------------------------------*/
 static bl_thread_local b_cpu_data b_cpu = { 0, 0 };
 /*---------------------------------------------------------------------------*/
+static inline uword boundedb_cpu (boundedb const* b)
+{
+  int cpu = rseq_cpu_get();
+  if (bl_unlikely (cpu < 0)) {
+    /* no "rseq": refreshed every 64 calls, as the lookup is expensive */
+    if ((b_cpu.calls & bl_u_lsb_set (6)) == 0) {
+      b_cpu.cpu = bl_get_cpu();
+    }
+    ++b_cpu.calls;
+    cpu = b_cpu.cpu;
+  }
+  /* CPU numbers might be sparse (e.g. offline CPUs) */
+  return bl_likely ((uword) cpu < b->cpu_count)
+    ? (uword) cpu : (uword) cpu % b->cpu_count;
+}
+/*---------------------------------------------------------------------------*/
 void boundedb_init (boundedb* b)
 {
   memset (b, 0, sizeof *b);
 }
 /*---------------------------------------------------------------------------*/
 bl_err boundedb_reset(
-  boundedb*           b,
-  bl_alloc_tbl const* alloc,
-  u32                 bytes,
-  u32                 slot_size,
-  u32                 max_slots,
-  bool                per_cpu
+  boundedb*             b,
+  bl_alloc_tbl const*   alloc,
+  page_alloc*           pages,
+  prefault_alloc*       prefault,
+  boundedb_class const* classes,
+  uword                 class_count,
+  u32                   slot_size,
+  bool                  per_cpu
   )
 {
-  bl_assert (b && alloc);
-  bl_err err  = bl_mkok();
-  uword slot_count = bl_div_ceil (bytes, slot_size);
-  if (slot_count == 0) {
-    err = bl_mkok();
-    goto do_destroy;
+  bl_assert (b && alloc && class_count <= BOUNDEDB_MAX_CLASSES);
+  bl_err err = bl_mkok();
+  boundedb_destroy (b, alloc);
+  /* validated before touching "b", so it is left disabled on errors */
+  u32 prev_max = 0;
+  for (uword c = 0; c < class_count; ++c) {
+    if (classes[c].bytes == 0) {
+      continue;
+    }
+    if (classes[c].min_slots == 0
+      || classes[c].min_slots <= prev_max
+      || classes[c].min_slots > classes[c].max_slots
+      ) {
+      return bl_mkerr (bl_invalid);
+    }
+    prev_max = classes[c].max_slots;
   }
-  if (max_slots == 0) {
-    return bl_mkerr (bl_invalid);
+  for (uword c = 0; c < class_count; ++c) {
+    if (classes[c].bytes != 0) {
+      b->classes[b->class_count] = classes[c];
+      ++b->class_count;
+    }
   }
-  boundedb_destroy (b, alloc);
-  uword count = per_cpu ? bl_get_cpu_count() : 1;
-  for (uword i = 0; i < count; ++i) {
-    err = cpuq_grow (&b->queues, 1, alloc);
-    if (err.own) {
-      goto do_destroy;
+  if (b->class_count == 0) {
+    return err;
+  }
+  b->qalloc    = pages ? &pages->tbl : alloc;
+  b->qalloc    = prefault ? &prefault->tbl : b->qalloc;
+  b->cpu_count = per_cpu ? bl_get_cpu_count() : 1;
+  if (b->cpu_count * b->class_count > BOUNDEDB_MAX_QUEUES) {
+    /* the queue index has to fit on "qidx" */
+    b->cpu_count = BOUNDEDB_MAX_QUEUES / b->class_count;
+  }
+  for (uword i = 0; i < b->cpu_count; ++i) {
+    if (pages && pages->numa) {
+      /* "boundedb_alloc" indexes the queues by CPU number */
+      pages->node = per_cpu ? page_alloc_cpu_node (i) : page_alloc_node_local;
     }
-    bl_mpmc_bpm* q = cpuq_at (&b->queues, i);
-    err  = bl_mpmc_bpm_init(
-      q, alloc, slot_count, max_slots, slot_size, 16, false
-      );
-    if (err.own) {
-      goto do_destroy;
+    for (uword c = 0; c < b->class_count; ++c) {
+      boundedb_class const* cl = &b->classes[c];
+      err = cpuq_grow (&b->queues, 1, alloc);
+      if (err.own) {
+        goto do_destroy;
+      }
+      bl_mpmc_bpm* q = cpuq_at (&b->queues, cpuq_size (&b->queues) - 1);
+      err = bl_mpmc_bpm_init(
+        q,
+        b->qalloc,
+        bl_div_ceil (cl->bytes, slot_size),
+        cl->max_slots,
+        slot_size,
+        16,
+        false
+        );
+      if (err.own) {
+        goto do_destroy;
+      }
     }
   }
   return err;
@@ -66,43 +119,48 @@ do_destroy:
 void boundedb_destroy (boundedb* b, bl_alloc_tbl const* alloc)
 {
   for (uword i = 0; i < cpuq_size (&b->queues); ++i) {
-    bl_mpmc_bpm_destroy (cpuq_at (&b->queues, i), alloc);
+    bl_mpmc_bpm_destroy (cpuq_at (&b->queues, i), b->qalloc);
   }
   cpuq_destroy (&b->queues, alloc);
+  b->qalloc      = nullptr;
+  b->class_count = 0;
+  b->cpu_count   = 0;
 }
 /*---------------------------------------------------------------------------*/
 bl_err boundedb_alloc (
-  boundedb* b, u8** mem, u32* slots, u32 n_bytes, u32 max_n_slots
+  boundedb* b, u8** mem, u16* qidx, u32* slots, u32 n_bytes, u32 max_n_slots
   )
 {
-  uword size = cpuq_size (&b->queues);
-  bl_assert (size);
-  uword qidx = 0;
-  if (size > 1) {
-    if ((b_cpu.calls & bl_u_lsb_set (6)) == 0) {
-      b_cpu.cpu = bl_get_cpu();
+  bl_assert (b->class_count);
+  /* all the queues have the same slot size */
+  *slots = bl_mpmc_bpm_required_slots (cpuq_at (&b->queues, 0), n_bytes);
+  if (*slots > max_n_slots) {
+    return bl_mkerr (bl_range);
+  }
+  uword c = 0;
+  while (*slots > b->classes[c].max_slots) {
+    if (++c == b->class_count) {
+      return bl_mkerr (bl_range);
     }
-    ++b_cpu.calls;
-    qidx = b_cpu.cpu;
   }
-  bl_mpmc_bpm* q = cpuq_at (&b->queues, qidx);
-  *slots = bl_mpmc_bpm_required_slots (q, n_bytes);
-  if (*slots > max_n_slots) {
+  if (*slots < b->classes[c].min_slots) {
+    /* its class is disabled, as if it was too big: no point on retrying */
     return bl_mkerr (bl_range);
   }
-  *mem = bl_mpmc_bpm_alloc (q, *slots);
+  uword q = c;
+  if (b->cpu_count > 1) {
+    q += boundedb_cpu (b) * b->class_count;
+  }
+  *qidx = (u16) q;
+  *mem  = bl_mpmc_bpm_alloc (cpuq_at (&b->queues, q), *slots);
   return bl_mkerr (*mem ? bl_ok : bl_alloc);
 }
 /*---------------------------------------------------------------------------*/
-void boundedb_dealloc (boundedb* b, u8* mem, u32 slots)
+void boundedb_dealloc (boundedb* b, u8* mem, u16 qidx, u32 slots)
 {
-  for (uword i = 0; i < cpuq_size (&b->queues); ++i) {
-    bl_mpmc_bpm* q = cpuq_at (&b->queues, i);
-    if (bl_mpmc_bpm_allocation_is_in_range (q, mem)) {
-      bl_mpmc_bpm_dealloc (q, mem, slots);
-      return;
-    }
-  }
-  bl_assert (false);
+  bl_assert (qidx < cpuq_size (&b->queues));
+  bl_mpmc_bpm* q = cpuq_at (&b->queues, qidx);
+  bl_assert (bl_mpmc_bpm_allocation_is_in_range (q, mem));
+  bl_mpmc_bpm_dealloc (q, mem, slots);
 }
 /*---------------------------------------------------------------------------*/
@@ -5,32 +5,68 @@
 #include <bl/base/dynarray.h>
 #include <bl/nonblock/mpmc_bpm.h>
 
+#include <malc/common.h>
+#include <malc/page_allocator.h>
+#include <malc/prefault_allocator.h>
+
 bl_define_dynarray_types(cpuq, bl_mpmc_bpm)
 
+/*----------------------------------------------------------------------------*/
+/* entries of "min_slots" to "max_slots" go to the queues of this class */
+typedef struct boundedb_class {
+  u32 bytes;
+  u32 min_slots;
+  u32 max_slots;
+}
+boundedb_class;
+/*----------------------------------------------------------------------------*/
+#define BOUNDEDB_MAX_CLASSES malc_fixed_class_count
+#define BOUNDEDB_MAX_QUEUES  ((uword) 1 << 16)
 /*----------------------------------------------------------------------------*/
 typedef struct boundedb {
-  cpuq queues;
+  cpuq                queues; /* "class_count" consecutive queues per CPU */
+  boundedb_class      classes[BOUNDEDB_MAX_CLASSES];
+  uword               class_count;
+  uword               cpu_count;
+  bl_alloc_tbl const* qalloc; /* the queue memory allocator */
 }
 boundedb;
 /*---------------------------------------------------------------------------*/
 extern void boundedb_init (boundedb* b);
 /*---------------------------------------------------------------------------*/
+/* "pages" is optional. When present the queue memory is taken from it instead
+   of from "alloc" and each per-CPU queue is placed on its CPU NUMA node (if the
+   page allocator has NUMA enabled). "prefault" is optional too, when present
+   the queue memory is taken through it, it has to wrap "pages" or "alloc".
+
+   "classes" has to be sorted by slot count without overlapping. The classes
+   with 0 bytes are skipped, if all are skipped the buffer is left disabled. */
 extern bl_err boundedb_reset(
-  boundedb*           b,
-  bl_alloc_tbl const* alloc,
-  u32                 bytes,
-  u32                 slot_size,
-  u32                 max_slots,
-  bool                per_cpu
+  boundedb*             b,
+  bl_alloc_tbl const*   alloc,
+  page_alloc*           pages,
+  prefault_alloc*       prefault,
+  boundedb_class const* classes,
+  uword                 class_count,
+  u32                   slot_size,
+  bool                  per_cpu
   );
 /*---------------------------------------------------------------------------*/
+static inline bool boundedb_is_enabled (boundedb const* b)
+{
+  return b->class_count > 0;
+}
+/*---------------------------------------------------------------------------*/
 extern void boundedb_destroy (boundedb* b, bl_alloc_tbl const* alloc);
 /*---------------------------------------------------------------------------*/
+/* returns "bl_range" if the entry exceeds "max_n_slots" or has no enabled
+   class and "bl_alloc" if the queue of its class is full. "qidx" is the index
+   of the queue the memory was taken from, to be passed back on dealloc. */
 extern bl_err boundedb_alloc(
-  boundedb* b, u8** mem, u32* slots, u32 n_bytes, u32 max_n_slots
+  boundedb* b, u8** mem, u16* qidx, u32* slots, u32 n_bytes, u32 max_n_slots
   );
 /*---------------------------------------------------------------------------*/
-extern void boundedb_dealloc (boundedb* b, u8* mem, u32 slots);
+extern void boundedb_dealloc (boundedb* b, u8* mem, u16 qidx, u32 slots);
 /*---------------------------------------------------------------------------*/
 
 #endif
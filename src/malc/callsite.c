@@ -0,0 +1,30 @@
+#include <malc/callsite.h>
+
+/*----------------------------------------------------------------------------*/
+malc_const_entry const* callsite_entries[callsite_max_id + 1];
+static bl_atomic_uword  callsite_count;
+/*----------------------------------------------------------------------------*/
+uword callsite_register (malc_const_entry const* entry)
+{
+  bl_atomic_uword* cache = (bl_atomic_uword*) entry->callsite;
+  uword            id    = callsite_full;
+  if (bl_atomic_uword_load_rlx (&callsite_count) < callsite_max_id) {
+    id = bl_atomic_uword_fetch_add_rlx (&callsite_count, 1) + 1;
+    if (id <= callsite_max_id) {
+      callsite_entries[id] = entry;
+    }
+    else {
+      id = callsite_full;
+    }
+  }
+  /* on a race with another thread registering the same entry the first id
+  cached wins, the other one is left unused */
+  uword expected = callsite_no_id;
+  if (!bl_atomic_uword_strong_cas(
+    cache, &expected, id, bl_mo_release, bl_mo_acquire
+    )) {
+    id = expected;
+  }
+  return id;
+}
+/*----------------------------------------------------------------------------*/
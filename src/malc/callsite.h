@@ -0,0 +1,64 @@
+#ifndef __MALC_CALLSITE_H__
+#define __MALC_CALLSITE_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/assert.h>
+#include <bl/base/atomic.h>
+
+#include <malc/malc.h>
+
+/* Callsite registry.
+
+The first entry logged from a callsite registers its "malc_const_entry" and
+gets a compact id, which is cached on the static that the logging macros place
+next to the entry ("malc_const_entry.callsite"). The entries then serialize
+the 16-bit id instead of the pointer to the constant entry.
+
+The registry is process-wide, as the cached ids are: a table on static storage
+indexed by id (only the touched pages are committed). An entry is published on
+the table before its id is cached with release semantics, so an entry using an
+id is always behind the table update on the queues.
+
+The entries without a cache (not created through the macros) or created when
+the registry is full serialize "callsite_no_id" followed by the full pointer.
+
+On the consumer the ids are an O(1) index for per-callsite data. */
+
+/*----------------------------------------------------------------------------*/
+#define callsite_no_id  0
+#define callsite_max_id 0xffff
+/* cached when the registry is full, so the slow path isn't retried */
+#define callsite_full   ((uword) callsite_max_id + 1)
+/*----------------------------------------------------------------------------*/
+extern malc_const_entry const* callsite_entries[callsite_max_id + 1];
+/*----------------------------------------------------------------------------*/
+/* slow path of "callsite_get_id" */
+extern uword callsite_register (malc_const_entry const* entry);
+/*----------------------------------------------------------------------------*/
+/* returns the id of "entry", registering it on first use. "callsite_no_id"
+if it can't have one. */
+static inline uword callsite_get_id (malc_const_entry const* entry)
+{
+  if (bl_unlikely (!entry->callsite)) {
+    return callsite_no_id;
+  }
+  /* the cache is a plain "uintptr_t" on the public headers */
+  uword id = bl_atomic_uword_load(
+    (bl_atomic_uword*) entry->callsite, bl_mo_acquire
+    );
+  if (bl_unlikely (id == callsite_no_id)) {
+    id = callsite_register (entry);
+  }
+  return id != callsite_full ? id : callsite_no_id;
+}
+/*----------------------------------------------------------------------------*/
+/* consumer side. "id" has to come from a serialized entry. */
+static inline malc_const_entry const* callsite_get_entry (uword id)
+{
+  bl_assert (id != callsite_no_id && id <= callsite_max_id);
+  return callsite_entries[id];
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_CALLSITE_H__ */
@@ -0,0 +1,35 @@
+#include <string.h>
+
+#include <malc/decode_plan.h>
+
+/*----------------------------------------------------------------------------*/
+void decode_plans_init (decode_plans* p)
+{
+  memset (p, 0, sizeof *p);
+}
+/*----------------------------------------------------------------------------*/
+void decode_plans_destroy (decode_plans* p, bl_alloc_tbl const* alloc)
+{
+  for (uword i = 0; i < decode_plan_pages; ++i) {
+    if (p->pages[i]) {
+      bl_dealloc (alloc, p->pages[i]);
+    }
+  }
+  decode_plans_init (p);
+}
+/*----------------------------------------------------------------------------*/
+decode_plan* decode_plans_add_page(
+  decode_plans* p, uword id, bl_alloc_tbl const* alloc
+  )
+{
+  uword        bytes = sizeof (decode_plan) * decode_plan_page_size;
+  decode_plan* page  = (decode_plan*) bl_alloc (alloc, bytes);
+  if (!page) {
+    return nullptr;
+  }
+  /* all "decode_plan_unset" */
+  memset (page, 0, bytes);
+  p->pages[id / decode_plan_page_size] = page;
+  return &page[id % decode_plan_page_size];
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,75 @@
+#ifndef __MALC_DECODE_PLAN_H__
+#define __MALC_DECODE_PLAN_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/allocator.h>
+
+#include <malc/callsite.h>
+
+/* Consumer side decode plans, one per registered callsite (see "callsite.h").
+
+The argument layout of all the entries of a callsite is the same, so it is
+computed once, the first time the callsite is seen: when all the arguments
+have a fixed width on the wire (e.g. non compressed integers, floats,
+pointers) the plan has the offset and width of each one. The next entries are
+then decoded with a bounds check and a copy per argument, instead of walking
+the type string through the generic decoder.
+
+Callsites with variable width arguments (strings, memory ranges, references,
+objects and the compressed 32/64-bit integers) get a plan flagged as
+"decode_plan_variable" and go through the generic decoder.
+
+The plans are stored on pages of "decode_plan_page_size" callsites, allocated
+when a callsite on them is seen for the first time. */
+
+/*----------------------------------------------------------------------------*/
+enum decode_plan_states {
+  decode_plan_unset    = 0,
+  decode_plan_fixed    = 1,
+  decode_plan_variable = 2,
+};
+/*----------------------------------------------------------------------------*/
+#define decode_plan_max_args  24
+#define decode_plan_page_size 256
+#define decode_plan_pages \
+  ((callsite_max_id + decode_plan_page_size) / decode_plan_page_size)
+/*----------------------------------------------------------------------------*/
+typedef struct decode_plan {
+  u8  state;
+  u8  count;   /* arguments */
+  u16 bytes;   /* all the arguments */
+  u16 offset[decode_plan_max_args];
+  u8  width[decode_plan_max_args];
+}
+decode_plan;
+/*----------------------------------------------------------------------------*/
+typedef struct decode_plans {
+  decode_plan* pages[decode_plan_pages];
+}
+decode_plans;
+/*----------------------------------------------------------------------------*/
+extern void decode_plans_init (decode_plans* p);
+/*----------------------------------------------------------------------------*/
+extern void decode_plans_destroy (decode_plans* p, bl_alloc_tbl const* alloc);
+/*----------------------------------------------------------------------------*/
+/* slow path of "decode_plans_get" */
+extern decode_plan* decode_plans_add_page(
+  decode_plans* p, uword id, bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+/* returns the plan of callsite "id", "decode_plan_unset" the first time. Null
+if out of memory. */
+static inline decode_plan* decode_plans_get(
+  decode_plans* p, uword id, bl_alloc_tbl const* alloc
+  )
+{
+  decode_plan* page = p->pages[id / decode_plan_page_size];
+  if (bl_unlikely (!page)) {
+    return decode_plans_add_page (p, id, alloc);
+  }
+  return &page[id % decode_plan_page_size];
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_DECODE_PLAN_H__ */
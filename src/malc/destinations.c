@@ -247,6 +247,14 @@ void destinations_flush (destinations* d)
   }
 }
 /*----------------------------------------------------------------------------*/
+/* consumer side (single writer) */
+static void count_write_errors (destinations* d, uword entries)
+{
+  bl_atomic_uword_store_rlx(
+    &d->write_errors, bl_atomic_uword_load_rlx (&d->write_errors) + entries
+    );
+}
+/*----------------------------------------------------------------------------*/
 static malc_log_strings get_entry_strings(
   destination* dest, malc_log_strings const* strs
   )
@@ -278,9 +286,12 @@ void destinations_write(
       bl_assert (dest->dst.write);
       if (sev >= dest->cfg.severity) {
         malc_log_strings s = get_entry_strings (dest, strs);
-        (void) dest->dst.write(
+        bl_err err = dest->dst.write(
           destination_get_instance (dest), entry_ns, sev, &s
           );
+        if (bl_unlikely (err.own)) {
+          count_write_errors (d, 1);
+        }
       }
     }
   }
@@ -305,9 +316,12 @@ void destinations_write(
           }
         }
         malc_log_strings s = get_entry_strings (dest, strs);
-        (void) dest->dst.write(
+        bl_err err = dest->dst.write(
           destination_get_instance (dest), entry_ns, sev, &s
           );
+        if (bl_unlikely (err.own)) {
+          count_write_errors (d, 1);
+        }
       }
     }
     if (!pe) {
@@ -322,6 +336,70 @@ void destinations_write(
   }
 }
 /*----------------------------------------------------------------------------*/
+static void destination_write_entries(
+  destinations*         d,
+  destination*          dest,
+  malc_log_entry const* entries,
+  uword                 count
+  )
+{
+  if (count == 0) {
+    return;
+  }
+  void* instance = destination_get_instance (dest);
+  if (dest->dst.write_batch) {
+    malc_log_entry_batch batch;
+    batch.entries = entries;
+    batch.count   = count;
+    /* it can't tell which entries were written: all are counted */
+    if (bl_unlikely (dest->dst.write_batch (instance, &batch).own)) {
+      count_write_errors (d, count);
+    }
+    return;
+  }
+  uword errors = 0;
+  for (uword i = 0; i < count; ++i) {
+    malc_log_entry const* e = &entries[i];
+    errors += !!dest->dst.write (instance, e->nsec, e->sev_val, &e->strs).own;
+  }
+  if (bl_unlikely (errors)) {
+    count_write_errors (d, errors);
+  }
+}
+/*----------------------------------------------------------------------------*/
+void destinations_write_batch (destinations* d, log_batch* b)
+{
+  uword count = log_batch_size (b);
+  if (d->filter_watch_count != 0) {
+    /* the rate filter state changes on every entry: entry by entry path */
+    for (uword i = 0; i < count; ++i) {
+      malc_log_entry const* e = &b->entries[i];
+      destinations_write (d, b->entry_ids[i], e->nsec, e->sev_val, &e->strs);
+    }
+    return;
+  }
+  destination* dest;
+  FOREACH_DESTINATION (d->mem, dest) {
+    bl_assert (dest->dst.write);
+    /* the batch is passed as-is when this destination filters nothing */
+    bool  as_is = dest->cfg.show_timestamp && dest->cfg.show_severity;
+    uword n     = 0;
+    for (uword i = 0; i < count; ++i) {
+      malc_log_entry const* e = &b->entries[i];
+      if (e->sev_val < dest->cfg.severity) {
+        as_is = false;
+        continue;
+      }
+      malc_log_entry* s = &b->scratch[n];
+      s->nsec    = e->nsec;
+      s->sev_val = e->sev_val;
+      s->strs    = get_entry_strings (dest, &e->strs);
+      ++n;
+    }
+    destination_write_entries (d, dest, as_is ? b->entries : b->scratch, n);
+  }
+}
+/*----------------------------------------------------------------------------*/
 bl_err destinations_get_instance(
   destinations const* d, void** instance, size_t dest_id
   )
@@ -6,8 +6,10 @@
 #include <bl/base/time.h>
 #include <bl/base/error.h>
 #include <bl/base/ringbuffer.h>
+#include <bl/base/atomic.h>
 
 #include <malc/malc.h>
+#include <malc/log_batch.h>
 
 /*----------------------------------------------------------------------------*/
 typedef struct past_entry {
@@ -34,6 +36,8 @@ typedef struct destinations {
   u32                 filter_min_severity;
   bl_ringb            pe;
   past_entry          pe_buffer[64];
+  /* entries that a destination failed to write, read by "malc_get_stats" */
+  bl_atomic_uword     write_errors;
 }
 destinations;
 /*----------------------------------------------------------------------------*/
@@ -42,6 +46,11 @@ static inline unsigned destinations_min_severity (destinations const* d)
   return d->min_severity;
 }
 /*----------------------------------------------------------------------------*/
+static inline uword destinations_write_errors (destinations const* d)
+{
+  return bl_atomic_uword_load_rlx ((bl_atomic_uword*) &d->write_errors);
+}
+/*----------------------------------------------------------------------------*/
 extern void destinations_init (destinations* d, bl_alloc_tbl const* alloc);
 /*----------------------------------------------------------------------------*/
 extern void destinations_destroy (destinations* d);
@@ -76,6 +85,8 @@ extern void destinations_write(
   malc_log_strings const* strs
   );
 /*----------------------------------------------------------------------------*/
+extern void destinations_write_batch (destinations* d, log_batch* b);
+/*----------------------------------------------------------------------------*/
 extern bl_err destinations_get_instance(
   destinations const* d, void** instance, size_t dest_id
   );
@@ -56,7 +56,8 @@ MALC_EXPORT const struct malc_dst malc_array_dst_tbl = {
   nullptr,                 /* terminate */
   nullptr,                 /* flush */
   nullptr,                 /* idle task */
-  &malc_array_dst_write
+  &malc_array_dst_write,
+  nullptr                  /* write batch */
 };
 /*----------------------------------------------------------------------------*/
 MALC_EXPORT void malc_array_dst_set_array(
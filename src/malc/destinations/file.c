@@ -24,6 +24,7 @@ struct malc_file_dst {
   size_t              name_seq_num;
   bl_dstr             prefix;
   bl_dstr             suffix;
+  bl_dstr             batch;
   size_t              file_size;
   size_t              max_file_size;
   size_t              max_log_files;
@@ -36,6 +37,7 @@ static bl_err malc_file_dst_init (void* instance, bl_alloc_tbl const* alloc)
   memset (d, 0, sizeof *d);
   bl_dstr_init (&d->prefix, alloc);
   bl_dstr_init (&d->suffix, alloc);
+  bl_dstr_init (&d->batch, alloc);
   d->alloc = alloc;
   d->time_based_name = true;
   d->can_remove_old_data_on_full_disk = false;
@@ -64,6 +66,7 @@ static void malc_file_dst_terminate (void* instance)
   past_files_destroy (&d->files, d->alloc);
   bl_dstr_destroy (&d->prefix);
   bl_dstr_destroy (&d->suffix);
+  bl_dstr_destroy (&d->batch);
 }
 /*----------------------------------------------------------------------------*/
 static bl_err malc_file_dst_open_new_file (malc_file_dst* d)
@@ -182,16 +185,21 @@ static bl_err malc_fwrite (malc_file_dst* d, char const* s, size_t slen)
   return bl_mkerr (i < max_retries ? bl_ok : bl_error);
 }
 /*----------------------------------------------------------------------------*/
-static bl_err malc_file_dst_write(
-    void* instance, bl_u64 nsec, unsigned sev_val, malc_log_strings const* strs
-    )
+static inline size_t malc_file_dst_entry_size (malc_log_strings const* strs)
 {
-  malc_file_dst* d = (malc_file_dst*) instance;
-
-  size_t bytes = strs->timestamp_len + strs->sev_len + strs->text_len;
-  bytes         += bl_lit_len ("\n");
-
-  if (d->max_file_size != 0 && d->file_size + bytes >= d->max_file_size) {
+  return strs->timestamp_len + strs->sev_len + strs->text_len +
+    bl_lit_len ("\n");
+}
+/*----------------------------------------------------------------------------*/
+static inline bool malc_file_dst_must_rotate (malc_file_dst* d, size_t bytes)
+{
+  return d->max_file_size != 0 && d->file_size + bytes >= d->max_file_size;
+}
+/*----------------------------------------------------------------------------*/
+/* rotates the file if the next "bytes" don't fit and opens it if required */
+static bl_err malc_file_dst_prepare (malc_file_dst* d, size_t bytes)
+{
+  if (malc_file_dst_must_rotate (d, bytes)) {
     if (d->f) {
       fclose (d->f);
       d->f = nullptr;
@@ -206,12 +214,18 @@ static bl_err malc_file_dst_write(
       malc_file_dst_drop_last_file (d, false);
     }
   }
-  bl_err err;
-  if (!d->f) {
-    err = malc_file_dst_open_new_file (d);
-    if (err.own) {
-      return err;
-    }
+  return d->f ? bl_mkok() : malc_file_dst_open_new_file (d);
+}
+/*----------------------------------------------------------------------------*/
+static bl_err malc_file_dst_write(
+    void* instance, bl_u64 nsec, unsigned sev_val, malc_log_strings const* strs
+    )
+{
+  malc_file_dst* d = (malc_file_dst*) instance;
+
+  bl_err err = malc_file_dst_prepare (d, malc_file_dst_entry_size (strs));
+  if (err.own) {
+    return err;
   }
   err = malc_fwrite (d, strs->timestamp, strs->timestamp_len);
   if (err.own) {
@@ -228,6 +242,58 @@ static bl_err malc_file_dst_write(
   return malc_fwrite (d, "\n", bl_lit_len ("\n"));
 }
 /*----------------------------------------------------------------------------*/
+static bl_err malc_file_dst_write_pending (malc_file_dst* d)
+{
+  size_t len = bl_dstr_len (&d->batch);
+  if (len == 0) {
+    return bl_mkok();
+  }
+  bl_err err = malc_fwrite (d, bl_dstr_get (&d->batch), len);
+  bl_dstr_clear (&d->batch);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+/* the entries are joined in a buffer and written with a single "fwrite" call
+for each chunk of entries that fits in the current file */
+static bl_err malc_file_dst_write_batch(
+  void* instance, malc_log_entry_batch const* b
+  )
+{
+  malc_file_dst* d = (malc_file_dst*) instance;
+  bl_err err = bl_mkok();
+
+  for (size_t i = 0; i < b->count; ++i) {
+    malc_log_strings const* strs = &b->entries[i].strs;
+    size_t bytes   = malc_file_dst_entry_size (strs);
+    size_t pending = bl_dstr_len (&d->batch) + bytes;
+    if (!d->f || malc_file_dst_must_rotate (d, pending)) {
+      err = malc_file_dst_write_pending (d);
+      if (err.own) {
+        return err;
+      }
+      err = malc_file_dst_prepare (d, bytes);
+      if (err.own) {
+        return err;
+      }
+    }
+    err = bl_dstr_append_l (&d->batch, strs->timestamp, strs->timestamp_len);
+    if (!err.own) {
+      err = bl_dstr_append_l (&d->batch, strs->sev, strs->sev_len);
+    }
+    if (!err.own) {
+      err = bl_dstr_append_l (&d->batch, strs->text, strs->text_len);
+    }
+    if (!err.own) {
+      err = bl_dstr_append_lit (&d->batch, "\n");
+    }
+    if (err.own) {
+      bl_dstr_clear (&d->batch);
+      return err;
+    }
+  }
+  return malc_file_dst_write_pending (d);
+}
+/*----------------------------------------------------------------------------*/
 static bl_err malc_file_dst_flush (void* instance)
 {
   malc_file_dst* d = (malc_file_dst*) instance;
@@ -243,7 +309,8 @@ MALC_EXPORT const struct malc_dst malc_file_dst_tbl = {
   &malc_file_dst_terminate,
   &malc_file_dst_flush,
   nullptr, /* idle task */
-  &malc_file_dst_write
+  &malc_file_dst_write,
+  &malc_file_dst_write_batch
 };
 /*----------------------------------------------------------------------------*/
 MALC_EXPORT bl_err malc_file_get_cfg (malc_file_dst* d, malc_file_cfg* cfg)
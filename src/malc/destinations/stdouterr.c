@@ -48,7 +48,8 @@ MALC_EXPORT const struct malc_dst malc_stdouterr_dst_tbl = {
   nullptr,                   /* terminate */
   &malc_stdouterr_dst_flush,
   nullptr,                   /* idle task */
-  &malc_stdouterr_dst_write
+  &malc_stdouterr_dst_write,
+  nullptr                    /* write batch */
 };
 /*----------------------------------------------------------------------------*/
 MALC_EXPORT bl_err malc_stdouterr_set_stderr_severity(
@@ -0,0 +1,73 @@
+#ifndef __MALC_DROPS_H__
+#define __MALC_DROPS_H__
+
+#include <bl/base/integer_short.h>
+#include <bl/base/atomic.h>
+
+#include <malc/common.h>
+
+/* Counters of the log entries rejected on the producer side. They only grow,
+   the consumer reports the difference with what it saw the last time, so it
+   never needs to write on them. */
+/*----------------------------------------------------------------------------*/
+typedef struct drop_totals {
+  uword entries[malc_drop_reason_count];
+  uword bytes[malc_drop_reason_count];
+}
+drop_totals;
+/*----------------------------------------------------------------------------*/
+typedef struct drop_counters {
+  bl_atomic_uword entries[malc_drop_reason_count];
+  bl_atomic_uword bytes[malc_drop_reason_count];
+}
+drop_counters;
+/*----------------------------------------------------------------------------*/
+static inline void drop_totals_init (drop_totals* t)
+{
+  for (uword i = 0; i < malc_drop_reason_count; ++i) {
+    t->entries[i] = 0;
+    t->bytes[i]   = 0;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline void drop_counters_init (drop_counters* d)
+{
+  for (uword i = 0; i < malc_drop_reason_count; ++i) {
+    bl_atomic_uword_store_rlx (&d->entries[i], 0);
+    bl_atomic_uword_store_rlx (&d->bytes[i], 0);
+  }
+}
+/*----------------------------------------------------------------------------*/
+/* single writer version, for counters owned by the calling thread */
+static inline void drop_counters_add_owned(
+  drop_counters* d, unsigned reason, uword bytes
+  )
+{
+  bl_atomic_uword_store_rlx(
+    &d->entries[reason], bl_atomic_uword_load_rlx (&d->entries[reason]) + 1
+    );
+  bl_atomic_uword_store_rlx(
+    &d->bytes[reason], bl_atomic_uword_load_rlx (&d->bytes[reason]) + bytes
+    );
+}
+/*----------------------------------------------------------------------------*/
+static inline void drop_counters_add_shared(
+  drop_counters* d, unsigned reason, uword bytes
+  )
+{
+  (void) bl_atomic_uword_fetch_add_rlx (&d->entries[reason], 1);
+  (void) bl_atomic_uword_fetch_add_rlx (&d->bytes[reason], bytes);
+}
+/*----------------------------------------------------------------------------*/
+/* adds the counter values to "t" */
+static inline void drop_counters_sum (drop_counters const* d, drop_totals* t)
+{
+  for (uword i = 0; i < malc_drop_reason_count; ++i) {
+    t->entries[i] +=
+      bl_atomic_uword_load_rlx ((bl_atomic_uword*) &d->entries[i]);
+    t->bytes[i] += bl_atomic_uword_load_rlx ((bl_atomic_uword*) &d->bytes[i]);
+  }
+}
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -551,39 +551,46 @@ static inline void destroy_objects(
   }
 }
 /*----------------------------------------------------------------------------*/
-bl_err entry_parser_get_log_strings(
-  entry_parser* ep, log_entry const* e, malc_log_strings* strs
+static void set_timestamp_and_severity(
+  entry_parser* ep, u64 nsec, unsigned sev, malc_log_strings* strs
   )
 {
-  if (bl_unlikely(
-    !e ||
-    !e->entry ||
-    !e->entry->info ||
-    e->entry->info[0] < malc_sev_debug ||
-    e->entry->info[0] > malc_sev_critical
-    )) {
-    bl_assert (false && "bug or corruption");
-    return bl_mkerr (bl_invalid);
-  }
-  /* meson old versions ignored base library flags */
-  bl_static_assert_ns_funcscope (sizeof e->timestamp == sizeof (u64));
   snprintf(
     ep->timestamp,
     TSTAMP_INTEGER + 2,
     "%0" bl_pp_to_str (TSTAMP_INTEGER) FMT_U64 ".",
-     e->timestamp / bl_nsec_in_sec
+     nsec / bl_nsec_in_sec
     );
   snprintf(
     &ep->timestamp[TSTAMP_INTEGER + 1],
     TSTAMP_DECIMAL + 1,
     "%0" bl_pp_to_str (TSTAMP_DECIMAL) FMT_U64,
-    e->timestamp % bl_nsec_in_sec
+    nsec % bl_nsec_in_sec
     );
   strs->timestamp     = ep->timestamp;
   strs->timestamp_len = sizeof ep->timestamp -1;
   bl_assert (strlen (strs->timestamp) == strs->timestamp_len);
-  strs->sev     = sev_strings[e->entry->info[0] - malc_sev_debug];
+  strs->sev     = sev_strings[sev - malc_sev_debug];
   strs->sev_len = bl_lit_len (MALC_EP_DEBUG);
+}
+/*----------------------------------------------------------------------------*/
+bl_err entry_parser_get_log_strings(
+  entry_parser* ep, log_entry const* e, malc_log_strings* strs
+  )
+{
+  if (bl_unlikely(
+    !e ||
+    !e->entry ||
+    !e->entry->info ||
+    e->entry->info[0] < malc_sev_debug ||
+    e->entry->info[0] > malc_sev_critical
+    )) {
+    bl_assert (false && "bug or corruption");
+    return bl_mkerr (bl_invalid);
+  }
+  /* meson old versions ignored base library flags */
+  bl_static_assert_ns_funcscope (sizeof e->timestamp == sizeof (u64));
+  set_timestamp_and_severity (ep, e->timestamp, e->entry->info[0], strs);
   bl_err err    = parse_text(
     ep, e->entry->format, &e->entry->info[1], e->args, e->args_count
     );
@@ -610,3 +617,18 @@ free_entry_resources:
   return err;
 }
 /*----------------------------------------------------------------------------*/
+void entry_parser_get_internal_log_strings(
+  entry_parser*     ep,
+  u64               nsec,
+  unsigned          sev,
+  char const*       text,
+  uword             text_len,
+  malc_log_strings* strs
+  )
+{
+  bl_assert (malc_is_valid_severity (sev));
+  set_timestamp_and_severity (ep, nsec, sev, strs);
+  strs->text     = text;
+  strs->text_len = text_len;
+}
+/*----------------------------------------------------------------------------*/
@@ -60,5 +60,15 @@ extern bl_err entry_parser_get_log_strings(
   entry_parser* ep, log_entry const* e, malc_log_strings* strs
   );
 /*----------------------------------------------------------------------------*/
+/* for entries generated by the library itself. "text" is not parsed. */
+extern void entry_parser_get_internal_log_strings(
+  entry_parser*     ep,
+  u64               nsec,
+  unsigned          sev,
+  char const*       text,
+  uword             text_len,
+  malc_log_strings* strs
+  );
+/*----------------------------------------------------------------------------*/
 #undef MALC_ALIGNAS
 #endif
@@ -0,0 +1,365 @@
+#ifndef __MALC_GROUP_VARINT_H__
+#define __MALC_GROUP_VARINT_H__
+
+#include <string.h>
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/endian.h>
+
+/* Consumer side helpers for the "group_varint" format of "compressed_builtins"
+(see "meson_options.txt" and "malc/impl/serialization.h").
+
+The header has a 2-bit code per compressed field, 4 fields per byte starting
+from the LSBs. A 32-bit field takes "code + 1" bytes and a 64-bit one
+"1 << code" bytes, little endian. The signed fields are zigzag encoded.
+
+When 4 consecutive fields are 32-bit and start on a header byte boundary they
+are decoded at once: a "pshufb" with a mask from the table below when the
+compiler targets SSSE3 (one table entry per header byte, 0x80 zeroes the
+lane byte) or with unaligned loads and masks otherwise. */
+
+#if defined (__SSSE3__) || (defined (_MSC_VER) && defined (__AVX__))
+  #include <tmmintrin.h>
+  #define MALC_HAS_GROUP_VARINT_SIMD 1
+#else
+  #define MALC_HAS_GROUP_VARINT_SIMD 0
+#endif
+
+#define gvarint_group_max_bytes 16
+/*----------------------------------------------------------------------------*/
+static inline uword gvarint_code (u8 const* hdr, uword idx)
+{
+  return (hdr[idx / 4] >> ((idx & 3) * 2)) & 3;
+}
+/*----------------------------------------------------------------------------*/
+static inline uword gvarint_size32 (uword code)
+{
+  return code + 1;
+}
+/*----------------------------------------------------------------------------*/
+static inline uword gvarint_size64 (uword code)
+{
+  return (uword) 1 << code;
+}
+/*----------------------------------------------------------------------------*/
+/* bytes taken by a group of 4 32-bit fields */
+static inline uword gvarint_group_bytes (u8 ctrl)
+{
+  return 4 + (ctrl & 3) + ((ctrl >> 2) & 3) + ((ctrl >> 4) & 3) + (ctrl >> 6);
+}
+/*----------------------------------------------------------------------------*/
+static inline u32 gvarint_unzigzag32 (u32 v)
+{
+  return (v >> 1) ^ (0u - (v & 1));
+}
+/*----------------------------------------------------------------------------*/
+static inline u64 gvarint_unzigzag64 (u64 v)
+{
+  return (v >> 1) ^ (0ull - (v & 1));
+}
+/*----------------------------------------------------------------------------*/
+/* reads "size" (1 to 8) little endian bytes. One unaligned load when there
+are 8 readable bytes */
+static inline u64 gvarint_load (u8 const* mem, u8 const* mem_end, uword size)
+{
+#if BL_ARCH_IS_LITTLE_ENDIAN
+  if (bl_likely (mem + sizeof (u64) <= mem_end)) {
+    u64 v;
+    memcpy (&v, mem, sizeof v);
+    return v & (~0ull >> ((sizeof v - size) * 8));
+  }
+#endif
+  u64 v = 0;
+  for (uword i = 0; i < size; ++i) {
+    v |= ((u64) mem[i]) << (i * 8);
+  }
+  return v;
+}
+/*----------------------------------------------------------------------------*/
+#if MALC_HAS_GROUP_VARINT_SIMD
+/*----------------------------------------------------------------------------*/
+#define gz 0x80 /* zero */
+static const u8 gvarint_shuffle[256][16] = {
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2,gz,gz,gz,  3,gz,gz,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3,gz,gz,gz,  4,gz,gz,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4,gz,gz,gz,  5,gz,gz,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5,gz,gz,gz,  6,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3,gz,gz,gz,  4,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4,gz,gz,gz,  5,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5,gz,gz,gz,  6,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6,gz,gz,gz,  7,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4,gz,gz,gz,  5,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5,gz,gz,gz,  6,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6,gz,gz,gz,  7,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7,gz,gz,gz,  8,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5,gz,gz,gz,  6,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6,gz,gz,gz,  7,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7,gz,gz,gz,  8,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8,gz,gz,gz,  9,gz,gz,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3,gz,gz,  4,gz,gz,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4,gz,gz,  5,gz,gz,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5,gz,gz,  6,gz,gz,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6,gz,gz,  7,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4,gz,gz,  5,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5,gz,gz,  6,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6,gz,gz,  7,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7,gz,gz,  8,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5,gz,gz,  6,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6,gz,gz,  7,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7,gz,gz,  8,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8,gz,gz,  9,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6,gz,gz,  7,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7,gz,gz,  8,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8,gz,gz,  9,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,gz,gz, 10,gz,gz,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3, 4,gz,  5,gz,gz,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4, 5,gz,  6,gz,gz,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5, 6,gz,  7,gz,gz,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6, 7,gz,  8,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4, 5,gz,  6,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5, 6,gz,  7,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6, 7,gz,  8,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7, 8,gz,  9,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5, 6,gz,  7,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6, 7,gz,  8,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7, 8,gz,  9,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8, 9,gz, 10,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6, 7,gz,  8,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7, 8,gz,  9,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8, 9,gz, 10,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,10,gz, 11,gz,gz,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3, 4, 5,  6,gz,gz,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4, 5, 6,  7,gz,gz,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5, 6, 7,  8,gz,gz,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6, 7, 8,  9,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4, 5, 6,  7,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5, 6, 7,  8,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6, 7, 8,  9,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7, 8, 9, 10,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5, 6, 7,  8,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6, 7, 8,  9,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7, 8, 9, 10,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8, 9,10, 11,gz,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6, 7, 8,  9,gz,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7, 8, 9, 10,gz,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8, 9,10, 11,gz,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,10,11, 12,gz,gz,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2,gz,gz,gz,  3, 4,gz,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3,gz,gz,gz,  4, 5,gz,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4,gz,gz,gz,  5, 6,gz,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5,gz,gz,gz,  6, 7,gz,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3,gz,gz,gz,  4, 5,gz,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4,gz,gz,gz,  5, 6,gz,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5,gz,gz,gz,  6, 7,gz,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6,gz,gz,gz,  7, 8,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4,gz,gz,gz,  5, 6,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5,gz,gz,gz,  6, 7,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6,gz,gz,gz,  7, 8,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7,gz,gz,gz,  8, 9,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5,gz,gz,gz,  6, 7,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6,gz,gz,gz,  7, 8,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7,gz,gz,gz,  8, 9,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8,gz,gz,gz,  9,10,gz,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3,gz,gz,  4, 5,gz,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4,gz,gz,  5, 6,gz,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5,gz,gz,  6, 7,gz,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6,gz,gz,  7, 8,gz,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4,gz,gz,  5, 6,gz,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5,gz,gz,  6, 7,gz,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6,gz,gz,  7, 8,gz,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7,gz,gz,  8, 9,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5,gz,gz,  6, 7,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6,gz,gz,  7, 8,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7,gz,gz,  8, 9,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8,gz,gz,  9,10,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6,gz,gz,  7, 8,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7,gz,gz,  8, 9,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8,gz,gz,  9,10,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,gz,gz, 10,11,gz,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3, 4,gz,  5, 6,gz,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4, 5,gz,  6, 7,gz,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5, 6,gz,  7, 8,gz,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6, 7,gz,  8, 9,gz,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4, 5,gz,  6, 7,gz,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5, 6,gz,  7, 8,gz,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6, 7,gz,  8, 9,gz,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7, 8,gz,  9,10,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5, 6,gz,  7, 8,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6, 7,gz,  8, 9,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7, 8,gz,  9,10,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8, 9,gz, 10,11,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6, 7,gz,  8, 9,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7, 8,gz,  9,10,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8, 9,gz, 10,11,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,10,gz, 11,12,gz,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3, 4, 5,  6, 7,gz,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4, 5, 6,  7, 8,gz,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5, 6, 7,  8, 9,gz,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6, 7, 8,  9,10,gz,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4, 5, 6,  7, 8,gz,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5, 6, 7,  8, 9,gz,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6, 7, 8,  9,10,gz,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7, 8, 9, 10,11,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5, 6, 7,  8, 9,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6, 7, 8,  9,10,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7, 8, 9, 10,11,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8, 9,10, 11,12,gz,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6, 7, 8,  9,10,gz,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7, 8, 9, 10,11,gz,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8, 9,10, 11,12,gz,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,10,11, 12,13,gz,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2,gz,gz,gz,  3, 4, 5,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3,gz,gz,gz,  4, 5, 6,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4,gz,gz,gz,  5, 6, 7,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5,gz,gz,gz,  6, 7, 8,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3,gz,gz,gz,  4, 5, 6,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4,gz,gz,gz,  5, 6, 7,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5,gz,gz,gz,  6, 7, 8,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6,gz,gz,gz,  7, 8, 9,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4,gz,gz,gz,  5, 6, 7,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5,gz,gz,gz,  6, 7, 8,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6,gz,gz,gz,  7, 8, 9,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7,gz,gz,gz,  8, 9,10,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5,gz,gz,gz,  6, 7, 8,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6,gz,gz,gz,  7, 8, 9,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7,gz,gz,gz,  8, 9,10,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8,gz,gz,gz,  9,10,11,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3,gz,gz,  4, 5, 6,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4,gz,gz,  5, 6, 7,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5,gz,gz,  6, 7, 8,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6,gz,gz,  7, 8, 9,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4,gz,gz,  5, 6, 7,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5,gz,gz,  6, 7, 8,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6,gz,gz,  7, 8, 9,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7,gz,gz,  8, 9,10,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5,gz,gz,  6, 7, 8,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6,gz,gz,  7, 8, 9,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7,gz,gz,  8, 9,10,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8,gz,gz,  9,10,11,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6,gz,gz,  7, 8, 9,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7,gz,gz,  8, 9,10,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8,gz,gz,  9,10,11,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,gz,gz, 10,11,12,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3, 4,gz,  5, 6, 7,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4, 5,gz,  6, 7, 8,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5, 6,gz,  7, 8, 9,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6, 7,gz,  8, 9,10,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4, 5,gz,  6, 7, 8,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5, 6,gz,  7, 8, 9,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6, 7,gz,  8, 9,10,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7, 8,gz,  9,10,11,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5, 6,gz,  7, 8, 9,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6, 7,gz,  8, 9,10,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7, 8,gz,  9,10,11,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8, 9,gz, 10,11,12,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6, 7,gz,  8, 9,10,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7, 8,gz,  9,10,11,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8, 9,gz, 10,11,12,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,10,gz, 11,12,13,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3, 4, 5,  6, 7, 8,gz },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4, 5, 6,  7, 8, 9,gz },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5, 6, 7,  8, 9,10,gz },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6, 7, 8,  9,10,11,gz },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4, 5, 6,  7, 8, 9,gz },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5, 6, 7,  8, 9,10,gz },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6, 7, 8,  9,10,11,gz },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7, 8, 9, 10,11,12,gz },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5, 6, 7,  8, 9,10,gz },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6, 7, 8,  9,10,11,gz },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7, 8, 9, 10,11,12,gz },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8, 9,10, 11,12,13,gz },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6, 7, 8,  9,10,11,gz },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7, 8, 9, 10,11,12,gz },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8, 9,10, 11,12,13,gz },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,10,11, 12,13,14,gz },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2,gz,gz,gz,  3, 4, 5, 6 },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3,gz,gz,gz,  4, 5, 6, 7 },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4,gz,gz,gz,  5, 6, 7, 8 },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5,gz,gz,gz,  6, 7, 8, 9 },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3,gz,gz,gz,  4, 5, 6, 7 },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4,gz,gz,gz,  5, 6, 7, 8 },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5,gz,gz,gz,  6, 7, 8, 9 },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6,gz,gz,gz,  7, 8, 9,10 },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4,gz,gz,gz,  5, 6, 7, 8 },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5,gz,gz,gz,  6, 7, 8, 9 },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6,gz,gz,gz,  7, 8, 9,10 },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7,gz,gz,gz,  8, 9,10,11 },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5,gz,gz,gz,  6, 7, 8, 9 },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6,gz,gz,gz,  7, 8, 9,10 },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7,gz,gz,gz,  8, 9,10,11 },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8,gz,gz,gz,  9,10,11,12 },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3,gz,gz,  4, 5, 6, 7 },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4,gz,gz,  5, 6, 7, 8 },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5,gz,gz,  6, 7, 8, 9 },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6,gz,gz,  7, 8, 9,10 },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4,gz,gz,  5, 6, 7, 8 },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5,gz,gz,  6, 7, 8, 9 },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6,gz,gz,  7, 8, 9,10 },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7,gz,gz,  8, 9,10,11 },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5,gz,gz,  6, 7, 8, 9 },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6,gz,gz,  7, 8, 9,10 },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7,gz,gz,  8, 9,10,11 },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8,gz,gz,  9,10,11,12 },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6,gz,gz,  7, 8, 9,10 },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7,gz,gz,  8, 9,10,11 },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8,gz,gz,  9,10,11,12 },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,gz,gz, 10,11,12,13 },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3, 4,gz,  5, 6, 7, 8 },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4, 5,gz,  6, 7, 8, 9 },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5, 6,gz,  7, 8, 9,10 },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6, 7,gz,  8, 9,10,11 },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4, 5,gz,  6, 7, 8, 9 },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5, 6,gz,  7, 8, 9,10 },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6, 7,gz,  8, 9,10,11 },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7, 8,gz,  9,10,11,12 },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5, 6,gz,  7, 8, 9,10 },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6, 7,gz,  8, 9,10,11 },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7, 8,gz,  9,10,11,12 },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8, 9,gz, 10,11,12,13 },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6, 7,gz,  8, 9,10,11 },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7, 8,gz,  9,10,11,12 },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8, 9,gz, 10,11,12,13 },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,10,gz, 11,12,13,14 },
+  {  0,gz,gz,gz,  1,gz,gz,gz,  2, 3, 4, 5,  6, 7, 8, 9 },
+  {  0, 1,gz,gz,  2,gz,gz,gz,  3, 4, 5, 6,  7, 8, 9,10 },
+  {  0, 1, 2,gz,  3,gz,gz,gz,  4, 5, 6, 7,  8, 9,10,11 },
+  {  0, 1, 2, 3,  4,gz,gz,gz,  5, 6, 7, 8,  9,10,11,12 },
+  {  0,gz,gz,gz,  1, 2,gz,gz,  3, 4, 5, 6,  7, 8, 9,10 },
+  {  0, 1,gz,gz,  2, 3,gz,gz,  4, 5, 6, 7,  8, 9,10,11 },
+  {  0, 1, 2,gz,  3, 4,gz,gz,  5, 6, 7, 8,  9,10,11,12 },
+  {  0, 1, 2, 3,  4, 5,gz,gz,  6, 7, 8, 9, 10,11,12,13 },
+  {  0,gz,gz,gz,  1, 2, 3,gz,  4, 5, 6, 7,  8, 9,10,11 },
+  {  0, 1,gz,gz,  2, 3, 4,gz,  5, 6, 7, 8,  9,10,11,12 },
+  {  0, 1, 2,gz,  3, 4, 5,gz,  6, 7, 8, 9, 10,11,12,13 },
+  {  0, 1, 2, 3,  4, 5, 6,gz,  7, 8, 9,10, 11,12,13,14 },
+  {  0,gz,gz,gz,  1, 2, 3, 4,  5, 6, 7, 8,  9,10,11,12 },
+  {  0, 1,gz,gz,  2, 3, 4, 5,  6, 7, 8, 9, 10,11,12,13 },
+  {  0, 1, 2,gz,  3, 4, 5, 6,  7, 8, 9,10, 11,12,13,14 },
+  {  0, 1, 2, 3,  4, 5, 6, 7,  8, 9,10,11, 12,13,14,15 },
+};
+#undef gz
+/*----------------------------------------------------------------------------*/
+#endif /* MALC_HAS_GROUP_VARINT_SIMD */
+/*----------------------------------------------------------------------------*/
+/* decodes the 4 32-bit fields of the header byte "ctrl". "src" has to have
+"gvarint_group_max_bytes" readable bytes. Returns the bytes consumed. */
+static inline uword gvarint_decode4_u32 (u8 const* src, u8 ctrl, u32* dst)
+{
+#if MALC_HAS_GROUP_VARINT_SIMD
+  __m128i data = _mm_loadu_si128 ((__m128i const*) src);
+  __m128i mask = _mm_loadu_si128 ((__m128i const*) gvarint_shuffle[ctrl]);
+  _mm_storeu_si128 ((__m128i*) dst, _mm_shuffle_epi8 (data, mask));
+#else
+  u8 const* mem = src;
+  for (uword i = 0; i < 4; ++i) {
+    uword size = gvarint_size32 ((ctrl >> (i * 2)) & 3);
+    dst[i] = (u32) gvarint_load (mem, src + gvarint_group_max_bytes, size);
+    mem   += size;
+  }
+#endif
+  return gvarint_group_bytes (ctrl);
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_GROUP_VARINT_H__ */
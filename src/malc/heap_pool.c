@@ -0,0 +1,257 @@
+#include <string.h>
+
+#include <bl/base/assert.h>
+#include <bl/base/utility.h>
+#include <bl/base/to_type_containing.h>
+
+#include <malc/heap_pool.h>
+
+#define heap_pool_header_bytes 16 /* keeps the parent alignment */
+
+/*----------------------------------------------------------------------------*/
+typedef struct heap_pool_block {
+  heap_pool_cache* owner; /* null: allocated from the parent, not pooled */
+  u32              size;  /* including the header */
+  u32              cls;
+}
+heap_pool_block;
+/*----------------------------------------------------------------------------*/
+struct heap_pool_cache {
+  heap_pool_cache* next;
+  bl_atomic_uword  in_use; /* claimed by a thread */
+  heap_pool_block* local[heap_pool_class_count];  /* owner thread only */
+  bl_atomic_uword  remote[heap_pool_class_count]; /* "heap_pool_block*" */
+};
+/*----------------------------------------------------------------------------*/
+bl_static_assert_ns (sizeof (heap_pool_block) <= heap_pool_header_bytes);
+bl_static_assert_ns(
+  (heap_pool_min_bytes << (heap_pool_class_count - 1))
+    == heap_pool_max_block_bytes
+  );
+/*----------------------------------------------------------------------------*/
+/* the free blocks are linked through their first payload bytes */
+static inline heap_pool_block** heap_pool_block_next (heap_pool_block* b)
+{
+  return (heap_pool_block**) (((u8*) b) + heap_pool_header_bytes);
+}
+/*----------------------------------------------------------------------------*/
+static inline heap_pool_block* heap_pool_get_block (void const* mem)
+{
+  return (heap_pool_block*) (((u8*) mem) - heap_pool_header_bytes);
+}
+/*----------------------------------------------------------------------------*/
+static inline u32 heap_pool_class (uword bytes)
+{
+  u32 cls = 0;
+  while (((uword) heap_pool_min_bytes << cls) < bytes) {
+    ++cls;
+  }
+  return cls;
+}
+/*----------------------------------------------------------------------------*/
+static void bl_tss_dtor_callconv heap_pool_thread_exit (void* opaque)
+{
+  heap_pool_cache* c = (heap_pool_cache*) opaque;
+  /* the blocks are kept on the cache for the next thread claiming it */
+  bl_atomic_uword_store (&c->in_use, 0, bl_mo_release);
+}
+/*----------------------------------------------------------------------------*/
+static heap_pool_cache* heap_pool_cache_claim (heap_pool* p)
+{
+  heap_pool_cache* c = (heap_pool_cache*) bl_atomic_uword_load(
+    &p->caches, bl_mo_acquire
+    );
+  for (; c; c = c->next) {
+    uword expected = 0;
+    if (bl_atomic_uword_strong_cas(
+      &c->in_use, &expected, 1, bl_mo_acquire, bl_mo_relaxed
+      )) {
+      return c;
+    }
+  }
+  c = (heap_pool_cache*) bl_alloc (p->parent, sizeof *c);
+  if (!c) {
+    return nullptr;
+  }
+  memset (c, 0, sizeof *c);
+  bl_atomic_uword_store_rlx (&c->in_use, 1);
+  uword head = bl_atomic_uword_load_rlx (&p->caches);
+  do {
+    c->next = (heap_pool_cache*) head;
+  }
+  while (!bl_atomic_uword_weak_cas(
+    &p->caches, &head, (uword) c, bl_mo_release, bl_mo_relaxed
+    ));
+  return c;
+}
+/*----------------------------------------------------------------------------*/
+static inline heap_pool_cache* heap_pool_cache_get (heap_pool* p)
+{
+  heap_pool_cache* c = (heap_pool_cache*) bl_tss_get (p->tss_key);
+  if (bl_likely (c)) {
+    return c;
+  }
+  c = heap_pool_cache_claim (p);
+  if (c && bl_tss_set (p->tss_key, c).own) {
+    heap_pool_thread_exit (c);
+    c = nullptr;
+  }
+  return c;
+}
+/*----------------------------------------------------------------------------*/
+static void* heap_pool_alloc_unpooled (heap_pool* p, size_t bytes)
+{
+  size_t size = bytes + heap_pool_header_bytes;
+  if (size > (u32) -1) {
+    return nullptr;
+  }
+  heap_pool_block* b = (heap_pool_block*) bl_alloc (p->parent, size);
+  if (!b) {
+    return nullptr;
+  }
+  b->owner = nullptr;
+  b->size  = (u32) size;
+  b->cls   = 0;
+  return ((u8*) b) + heap_pool_header_bytes;
+}
+/*----------------------------------------------------------------------------*/
+static void* heap_pool_alloc (size_t bytes, bl_alloc_tbl const* invoker)
+{
+  heap_pool* p    = bl_to_type_containing (invoker, tbl, heap_pool);
+  uword      size = bytes + heap_pool_header_bytes;
+  if (size > heap_pool_max_block_bytes || p->max_bytes == 0) {
+    return heap_pool_alloc_unpooled (p, bytes);
+  }
+  heap_pool_cache* c = heap_pool_cache_get (p);
+  if (bl_unlikely (!c)) {
+    return heap_pool_alloc_unpooled (p, bytes);
+  }
+  u32 cls            = heap_pool_class (size);
+  heap_pool_block* b = c->local[cls];
+  if (!b) {
+    b = (heap_pool_block*) bl_atomic_uword_exchange(
+      &c->remote[cls], 0, bl_mo_acquire
+      );
+  }
+  if (b) {
+    c->local[cls] = *heap_pool_block_next (b);
+    return ((u8*) b) + heap_pool_header_bytes;
+  }
+  size = (uword) heap_pool_min_bytes << cls;
+  if (bl_atomic_uword_fetch_add_rlx (&p->pooled_bytes, size) + size
+    > p->max_bytes
+    ) {
+    bl_atomic_uword_fetch_sub_rlx (&p->pooled_bytes, size);
+    return heap_pool_alloc_unpooled (p, bytes);
+  }
+  b = (heap_pool_block*) bl_alloc (p->parent, size);
+  if (!b) {
+    bl_atomic_uword_fetch_sub_rlx (&p->pooled_bytes, size);
+    return nullptr;
+  }
+  b->owner = c;
+  b->size  = (u32) size;
+  b->cls   = cls;
+  return ((u8*) b) + heap_pool_header_bytes;
+}
+/*----------------------------------------------------------------------------*/
+static void heap_pool_dealloc (void const* mem, bl_alloc_tbl const* invoker)
+{
+  if (!mem) {
+    return;
+  }
+  heap_pool*       p = bl_to_type_containing (invoker, tbl, heap_pool);
+  heap_pool_block* b = heap_pool_get_block (mem);
+  if (!b->owner) {
+    bl_dealloc (p->parent, b);
+    return;
+  }
+  bl_atomic_uword* head = &b->owner->remote[b->cls];
+  uword            prev = bl_atomic_uword_load_rlx (head);
+  do {
+    *heap_pool_block_next (b) = (heap_pool_block*) prev;
+  }
+  while (!bl_atomic_uword_weak_cas(
+    head, &prev, (uword) b, bl_mo_release, bl_mo_relaxed
+    ));
+}
+/*----------------------------------------------------------------------------*/
+static void* heap_pool_realloc(
+  void* mem, size_t new_size, bl_alloc_tbl const* invoker
+  )
+{
+  if (!mem) {
+    return heap_pool_alloc (new_size, invoker);
+  }
+  heap_pool_block* b = heap_pool_get_block (mem);
+  size_t old_size    = b->size - heap_pool_header_bytes;
+  void* new_mem      = heap_pool_alloc (new_size, invoker);
+  if (new_mem) {
+    memcpy (new_mem, mem, bl_min (old_size, new_size));
+    heap_pool_dealloc (mem, invoker);
+  }
+  return new_mem;
+}
+/*----------------------------------------------------------------------------*/
+bl_err heap_pool_init(
+  heap_pool* p, bl_alloc_tbl const* parent, uword max_bytes
+  )
+{
+  bl_err err = bl_tss_init (&p->tss_key, &heap_pool_thread_exit);
+  if (err.own) {
+    return err;
+  }
+  p->tbl.alloc   = heap_pool_alloc;
+  p->tbl.realloc = heap_pool_realloc;
+  p->tbl.dealloc = heap_pool_dealloc;
+  p->parent      = parent;
+  p->max_bytes   = max_bytes;
+  bl_atomic_uword_store_rlx (&p->pooled_bytes, 0);
+  bl_atomic_uword_store_rlx (&p->caches, 0);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+static void heap_pool_free_list (heap_pool* p, heap_pool_block* b)
+{
+  while (b) {
+    heap_pool_block* next = *heap_pool_block_next (b);
+    bl_atomic_uword_fetch_sub_rlx (&p->pooled_bytes, b->size);
+    bl_dealloc (p->parent, b);
+    b = next;
+  }
+}
+/*----------------------------------------------------------------------------*/
+void heap_pool_destroy (heap_pool* p)
+{
+  /* the threads still alive don't run the destructor after this */
+  bl_tss_destroy (p->tss_key);
+  heap_pool_cache* c = (heap_pool_cache*) bl_atomic_uword_exchange(
+    &p->caches, 0, bl_mo_acquire
+    );
+  while (c) {
+    heap_pool_cache* next = c->next;
+    for (uword i = 0; i < heap_pool_class_count; ++i) {
+      heap_pool_free_list (p, c->local[i]);
+      heap_pool_free_list(
+        p,
+        (heap_pool_block*) bl_atomic_uword_exchange(
+          &c->remote[i], 0, bl_mo_acquire
+          )
+        );
+    }
+    bl_dealloc (p->parent, c);
+    c = next;
+  }
+  bl_assert (bl_atomic_uword_load_rlx (&p->pooled_bytes) == 0);
+}
+/*----------------------------------------------------------------------------*/
+void heap_pool_set_max_bytes (heap_pool* p, uword max_bytes)
+{
+  p->max_bytes = max_bytes;
+}
+/*----------------------------------------------------------------------------*/
+uword heap_pool_bytes (heap_pool const* p)
+{
+  return bl_atomic_uword_load_rlx ((bl_atomic_uword*) &p->pooled_bytes);
+}
+/*----------------------------------------------------------------------------*/
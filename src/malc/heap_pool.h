@@ -0,0 +1,65 @@
+#ifndef __MALC_HEAP_POOL_H__
+#define __MALC_HEAP_POOL_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/allocator.h>
+#include <bl/base/atomic.h>
+#include <bl/base/error.h>
+#include <bl/base/thread.h>
+
+/* An allocator table for the log entries that don't fit on the TLS buffers or
+the fixed allocator ("msg_allocator"). It keeps the freed blocks instead of
+returning them to its parent allocator, so sustained bursts don't translate to
+"malloc" on the producers and "free" on the consumer.
+
+The blocks are rounded to power of 2 size classes (from "heap_pool_min_bytes"
+to "heap_pool_max_block_bytes", bigger ones go to the parent). Each producer
+thread has a cache with one free list per class:
+
+- local: only touched by the owner thread. Allocations pop from here.
+
+- remote: deallocations (usually from the consumer) push the block back to the
+  remote list of the cache that allocated it. The owner takes the whole list
+  at once when its local list is empty, so there is no ABA problem.
+
+The caches are created on the first allocation of each thread and released
+(but kept with their blocks) when the thread exits, so the next thread can
+reuse them.
+
+"max_bytes" caps the bytes held by the pooled blocks. Once reached, the blocks
+that don't find a free one are allocated from (and deallocated to) the parent
+as usual. Each block has a small header in front to store its class and
+owner. */
+
+#define heap_pool_min_bytes       64
+#define heap_pool_max_block_bytes (64 * 1024)
+#define heap_pool_class_count     11 /* log2 (max / min) + 1 */
+/*----------------------------------------------------------------------------*/
+typedef struct heap_pool_cache heap_pool_cache;
+/*----------------------------------------------------------------------------*/
+typedef struct heap_pool {
+  bl_alloc_tbl        tbl; /* has to be the first member */
+  bl_alloc_tbl const* parent;
+  uword               max_bytes;
+  bl_atomic_uword     pooled_bytes;
+  bl_atomic_uword     caches; /* "heap_pool_cache*" list, grows only */
+  bl_tss              tss_key;
+}
+heap_pool;
+/*----------------------------------------------------------------------------*/
+extern bl_err heap_pool_init(
+  heap_pool* p, bl_alloc_tbl const* parent, uword max_bytes
+  );
+/*----------------------------------------------------------------------------*/
+/* all the blocks have to be deallocated already */
+extern void heap_pool_destroy (heap_pool* p);
+/*----------------------------------------------------------------------------*/
+/* to be called before allocating. The blocks already pooled are kept. */
+extern void heap_pool_set_max_bytes (heap_pool* p, uword max_bytes);
+/*----------------------------------------------------------------------------*/
+/* bytes taken by the pooled blocks, free or in use */
+extern uword heap_pool_bytes (heap_pool const* p);
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_HEAP_POOL_H__ */
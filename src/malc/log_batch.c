@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include <bl/base/assert.h>
+#include <bl/base/utility.h>
+
+#include <malc/log_batch.h>
+
+/*----------------------------------------------------------------------------*/
+void log_batch_init (log_batch* b)
+{
+  memset (b, 0, sizeof *b);
+}
+/*----------------------------------------------------------------------------*/
+bl_err log_batch_reset(
+  log_batch* b, uword capacity, uword arena_bytes, bl_alloc_tbl const* alloc
+  )
+{
+  bl_assert (b && alloc);
+  log_batch_destroy (b, alloc);
+  if (capacity <= 1) {
+    /* batching disabled */
+    return bl_mkok();
+  }
+  /* one block for the entries, the scratch entries and the entry ids */
+  uword entries_bytes = capacity * sizeof *b->entries;
+  u8* mem = (u8*) bl_alloc(
+    alloc, (2 * entries_bytes) + (capacity * sizeof *b->entry_ids)
+    );
+  if (!mem) {
+    return bl_mkerr (bl_alloc);
+  }
+  b->arena = (char*) bl_alloc (alloc, arena_bytes);
+  if (!b->arena) {
+    bl_dealloc (alloc, mem);
+    return bl_mkerr (bl_alloc);
+  }
+  b->entries   = (malc_log_entry*) mem;
+  b->scratch   = (malc_log_entry*) (mem + entries_bytes);
+  b->entry_ids = (uword*) (mem + (2 * entries_bytes));
+  b->capacity   = capacity;
+  b->arena_size = arena_bytes;
+  log_batch_clear (b);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+void log_batch_destroy (log_batch* b, bl_alloc_tbl const* alloc)
+{
+  if (b->entries) {
+    bl_dealloc (alloc, b->entries);
+  }
+  if (b->arena) {
+    bl_dealloc (alloc, b->arena);
+  }
+  log_batch_init (b);
+}
+/*----------------------------------------------------------------------------*/
+static inline char const* arena_copy (log_batch* b, char const* s, size_t len)
+{
+  char* dst = &b->arena[b->arena_used];
+  memcpy (dst, s, len);
+  b->arena_used += len;
+  return dst;
+}
+/*----------------------------------------------------------------------------*/
+bool log_batch_push(
+  log_batch*              b,
+  uword                   entry_id,
+  u64                     nsec,
+  unsigned                sev,
+  malc_log_strings const* strs
+  )
+{
+  bl_assert (log_batch_is_enabled (b) && !log_batch_is_full (b));
+  uword bytes = strs->timestamp_len + strs->sev_len + strs->text_len;
+  if (bl_unlikely (bytes > b->arena_size - b->arena_used)) {
+    return false;
+  }
+  malc_log_entry* e = &b->entries[b->count];
+  b->entry_ids[b->count] = entry_id;
+  e->nsec    = nsec;
+  e->sev_val = sev;
+  e->strs.timestamp     = arena_copy (b, strs->timestamp, strs->timestamp_len);
+  e->strs.timestamp_len = strs->timestamp_len;
+  e->strs.sev           = arena_copy (b, strs->sev, strs->sev_len);
+  e->strs.sev_len       = strs->sev_len;
+  e->strs.text          = arena_copy (b, strs->text, strs->text_len);
+  e->strs.text_len      = strs->text_len;
+  ++b->count;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
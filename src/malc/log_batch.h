@@ -0,0 +1,76 @@
+#ifndef __MALC_LOG_BATCH_H__
+#define __MALC_LOG_BATCH_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/allocator.h>
+#include <bl/base/error.h>
+#include <bl/base/time.h>
+
+#include <malc/malc.h>
+
+/* A batch of already formatted log entries. The entry strings are copied to a
+consumer-owned arena, as the entry parser reuses its buffers on each entry.
+
+The arena has a fixed size: an entry that doesn't fit makes "log_batch_push"
+fail, so the caller can write the current batch to the destinations and retry.
+An entry bigger than the whole arena can never be batched.
+
+The entries are stored as a "malc_log_entry" array, so they can be passed
+as-is to the destinations. "scratch" has the same capacity and is used to
+build the per-destination filtered copies. */
+
+/* arena bytes reserved for each batch entry */
+#define LOG_BATCH_ENTRY_AVG_BYTES 256
+/*----------------------------------------------------------------------------*/
+typedef struct log_batch {
+  malc_log_entry*  entries;
+  uword*           entry_ids;
+  malc_log_entry*  scratch;
+  uword            count;
+  uword            capacity;
+  char*            arena;
+  uword            arena_used;
+  uword            arena_size;
+}
+log_batch;
+/*----------------------------------------------------------------------------*/
+extern void log_batch_init (log_batch* b);
+/*----------------------------------------------------------------------------*/
+extern bl_err log_batch_reset(
+  log_batch* b, uword capacity, uword arena_bytes, bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+extern void log_batch_destroy (log_batch* b, bl_alloc_tbl const* alloc);
+/*----------------------------------------------------------------------------*/
+extern bool log_batch_push(
+  log_batch*              b,
+  uword                   entry_id,
+  u64                     nsec,
+  unsigned                sev,
+  malc_log_strings const* strs
+  );
+/*----------------------------------------------------------------------------*/
+static inline bool log_batch_is_enabled (log_batch const* b)
+{
+  return b->capacity > 1;
+}
+/*----------------------------------------------------------------------------*/
+static inline uword log_batch_size (log_batch const* b)
+{
+  return b->count;
+}
+/*----------------------------------------------------------------------------*/
+static inline bool log_batch_is_full (log_batch const* b)
+{
+  return b->count >= b->capacity;
+}
+/*----------------------------------------------------------------------------*/
+static inline void log_batch_clear (log_batch* b)
+{
+  b->count      = 0;
+  b->arena_used = 0;
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_LOG_BATCH_H__ */
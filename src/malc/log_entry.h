@@ -32,6 +32,7 @@ log_argument;
 /*----------------------------------------------------------------------------*/
 typedef struct log_entry {
   malc_const_entry const* entry;
+  uword                   entry_id; /* callsite id, see "callsite.h" */
   bl_timept64             timestamp;
   log_argument const*     args;
   uword                   args_count;
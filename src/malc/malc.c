@@ -1,4 +1,7 @@
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
 
 #include <malc/malc.h>
 
@@ -10,9 +13,12 @@
 #include <bl/base/utility.h>
 #include <bl/base/to_type_containing.h>
 #include <bl/base/processor_pause.h>
+#include <bl/base/thread.h>
 #include <bl/base/deadline.h>
 #include <bl/base/cache.h>
 #include <bl/base/static_assert.h>
+#define BL_UNPREFIXED_PRINTF_FORMATS
+#include <bl/base/integer_printf_format.h>
 
 #include <bl/nonblock/mpsc_i.h>
 #include <bl/nonblock/backoff.h>
@@ -23,9 +29,13 @@
 #include <malc/common.h>
 #include <malc/memory.h>
 #include <malc/serialization.h>
+#include <malc/drops.h>
 
 #include <malc/entry_parser.h>
 #include <malc/destinations.h>
+#include <malc/log_batch.h>
+#include <malc/reorder_buffer.h>
+#include <malc/waiter.h>
 
 #ifdef __cplusplus
   extern "C" {
@@ -41,60 +51,143 @@ enum state {
   st_invalid,               /* this value will never be set by anyone*/
 };
 /*----------------------------------------------------------------------------*/
-struct malc {
-  bl_declare_cache_pad_member;
-  bl_atomic_uword     state;
-  malc_producer_cfg   producer;
-  bl_alloc_tbl const* alloc;
-  memory              mem;
-  bl_mpsc_i           q;
-  /*place all consumer-only related resources on separated cache lines. "bl_mpsc_i"
-    leaves a separation cache line before and after itself*/
-  bl_thread           thread;
-  malc_consumer_cfg   consumer;
-  malc_security       sec;
-  bl_nonblock_backoff cbackoff;
-  bl_timept64         idle_deadline;
-  u32                 idle_boundary_us;
-  deserializer        ds;
-  entry_parser        ep;
-  destinations        dst;
-  bl_mutex            produce_mutex;
-  bl_declare_cache_pad_member;
-};
-/*----------------------------------------------------------------------------*/
 enum queue_command {
   q_cmd_entry,
   q_cmd_tls_register,
   q_cmd_tls_dealloc_deregister,
+  q_cmd_tls_segment_retire,
   q_cmd_flush,
   q_cmd_terminate,
+  q_cmd_large_entry, /* an entry bigger than what "qnode.slots" can hold */
   q_cmd_max,
 };
 /*----------------------------------------------------------------------------*/
 typedef struct info_byte {
   u8 has_timestamp : 1;
-  u8 cmd           : 8 - 1 - alloc_tag_bits;
+  u8 priority      : 1;
+  u8 cmd           : 8 - 2 - alloc_tag_bits;
   u8 tag           : alloc_tag_bits;
 }
 info_byte;
 /*----------------------------------------------------------------------------*/
-bl_static_assert_ns (bl_pow2_u (8 - 1 - alloc_tag_bits) >= q_cmd_max);
+bl_static_assert_ns (bl_pow2_u (8 - 2 - alloc_tag_bits) >= q_cmd_max);
 /*----------------------------------------------------------------------------*/
 typedef struct qnode {
   bl_mpsc_i_node hook;
   info_byte      info;
   u8             slots;
+  /* fits on the padding. Its meaning depends on "info.tag": the bounded queue
+  index, the heap bytes missing to fill the last slot or the TLS
+  "timestamp_delta" stream and format. See "memory_alloc". */
+  u16            qidx;
   /* would be nice to have flexible arrays in C++ */
 }
 qnode;
 /*----------------------------------------------------------------------------*/
+/* the payload starts after the whole struct, so the common case entries don't
+pay for the wider slot count. */
+typedef struct qnode_large {
+  qnode n;
+  u32   slots; /* "n.slots" is unused */
+}
+qnode_large;
+/*----------------------------------------------------------------------------*/
+/* the common case entries have to stay as small as before the large ones */
+bl_static_assert_ns (sizeof (qnode) == 2 * sizeof (void*));
+/* the smallest slots keep the nodes aligned */
+bl_static_assert_ns (MALC_MIN_SLOT_SIZE % sizeof (void*) == 0);
+/*----------------------------------------------------------------------------*/
+/* maximum entry size on "qnode" and "qnode_large" entries */
+#define qnode_max_slots       (1 << (bl_sizeof_member (qnode, slots) * 8))
+#define qnode_large_max_slots (1 << 16)
+/*----------------------------------------------------------------------------*/
+/* blocking "malc_terminate" from a thread not owning the consumer */
+#define malc_terminate_owner_wait_us (1000 * 1000)
+/*----------------------------------------------------------------------------*/
+static inline bool qnode_is_entry (qnode const* n)
+{
+  return n->info.cmd == q_cmd_entry || n->info.cmd == q_cmd_large_entry;
+}
+/*----------------------------------------------------------------------------*/
+static inline u32 qnode_entry_slots (qnode const* n)
+{
+  return bl_likely (n->info.cmd == q_cmd_entry)
+    ? ((u32) n->slots) + 1 : ((qnode_large const*) n)->slots;
+}
+/*----------------------------------------------------------------------------*/
+static inline u8* qnode_entry_payload (qnode* n)
+{
+  return bl_likely (n->info.cmd == q_cmd_entry)
+    ? ((u8*) n) + sizeof (qnode) : ((u8*) n) + sizeof (qnode_large);
+}
+/*----------------------------------------------------------------------------*/
 typedef struct qnode_tls_alloc {
   qnode n;
   void* mem;
 }
 qnode_tls_alloc;
 /*----------------------------------------------------------------------------*/
+typedef struct qnode_flush {
+  qnode n;
+  uword seq; /* flush tickets covered by this command */
+}
+qnode_flush;
+/*----------------------------------------------------------------------------*/
+struct malc {
+  bl_declare_cache_pad_member;
+  bl_atomic_uword     state;
+  malc_producer_cfg   producer;
+  bool                ts_delta; /* "producer.timestamp_delta" in effect */
+  bool                tsc;      /* "producer.timestamp_tsc" in effect */
+  waiter              waiter;
+  /* written on each flush, away from the fields read on each log call */
+  bl_declare_cache_pad_member;
+  bl_atomic_uword     flush_req;
+  bl_atomic_uword     flush_pending;
+  bl_atomic_uword     flush_done;
+  qnode_flush         flush_node;
+  bl_declare_cache_pad_member;
+  bl_atomic_uword     drops_dirty;
+  drop_counters       drops_shared; /* producers without TLS buffer */
+  bl_alloc_tbl const* alloc;
+  memory              mem;
+  bl_mpsc_i           q;
+  bl_mpsc_i           qprio; /* entries at or above "priority_sev" */
+  /*place all consumer-only related resources on separated cache lines. "bl_mpsc_i"
+    leaves a separation cache line before and after itself*/
+  bl_thread           thread;
+  malc_consumer_cfg   consumer;
+  malc_security       sec;
+  bl_nonblock_backoff cbackoff;
+  bl_timept64         idle_deadline;
+  u32                 idle_boundary_us;
+  deserializer        ds;
+  entry_parser        ep;
+  destinations        dst;
+  log_batch           batch;
+  bl_timept64         batch_deadline;
+  uword               lane_rr;
+  uword               lane_rescan; /* dequeues left to poll the idle lanes */
+  uword               prio_streak;
+  reorder_buffer      rb;
+  bl_atomic_uword     reorder_late;
+  bl_timept64*        ts_bases; /* last one of each "timestamp_delta" stream */
+  tsc_calib           tsc_calib;
+  drop_totals         drops_retired; /* from the destroyed TLS buffers */
+  drop_counters       drops_seen;    /* reported, read by "malc_get_stats" */
+  u64                 drops_since[malc_drop_reason_count];
+  bl_atomic_uword     consumer_owner; /* see "malc_consumer_acquire" */
+  bl_tss              owner_tss;      /* clears the owner on thread exit */
+  bl_mutex            produce_mutex;
+  bl_declare_cache_pad_member;
+};
+/*----------------------------------------------------------------------------*/
+static inline void malc_produce (malc* l, qnode* n)
+{
+  bl_mpsc_i_produce_notag (&l->q, &n->hook);
+  waiter_wake (&l->waiter);
+}
+/*----------------------------------------------------------------------------*/
 static void malc_tls_destructor (void* mem, void* context)
 {
 /*When a thread goes out of scope we can't just deallocate its TLS memory
@@ -111,23 +204,111 @@ static void malc_tls_destructor (void* mem, void* context)
   n->slots = 0;
   n->info.cmd = q_cmd_tls_dealloc_deregister;
   bl_mpsc_i_node_set (&n->hook, nullptr, 0, 0);
-  bl_mpsc_i_produce_notag (&l->q, &n->hook);
+  malc_produce (l, n);
+}
+/*----------------------------------------------------------------------------*/
+static void malc_tls_segment_retire (tls_segment* s, void* context)
+{
+  /* as with the whole TLS buffer on "malc_tls_destructor", the segment might
+  still have entries on the queues. It is returned to the pool from the
+  consumer. */
+  bl_static_assert_ns_funcscope(
+    sizeof (qnode) <= offsetof (tls_segment, mem)
+    );
+  malc*  l = (malc*) context;
+  qnode* n = (qnode*) s;
+  n->slots    = 0;
+  n->info.cmd = q_cmd_tls_segment_retire;
+  bl_mpsc_i_node_set (&n->hook, nullptr, 0, 0);
+  malc_produce (l, n);
+}
+/*----------------------------------------------------------------------------*/
+/* there is only one flush command node. It is owned by whoever sets
+"flush_pending" */
+static void malc_send_flush (malc* l, uword seq)
+{
+  qnode_flush* f = &l->flush_node;
+  f->n.slots    = 0;
+  f->n.info.cmd = q_cmd_flush;
+  f->seq        = seq;
+  bl_mpsc_i_node_set (&f->n.hook, nullptr, 0, 0);
+  malc_produce (l, &f->n);
+}
+/*----------------------------------------------------------------------------*/
+/* consumer side */
+static void malc_publish_flush (malc* l, uword seq)
+{
+  bl_atomic_uword_store (&l->flush_done, seq, bl_mo_release);
+  uword req = bl_atomic_uword_load (&l->flush_req, bl_mo_seq_cst);
+  if (req == seq) {
+    bl_atomic_uword_store (&l->flush_pending, 0, bl_mo_seq_cst);
+    /* a ticket might have been taken after the first load but before the
+    flag was cleared, then its owner failed to take the flag */
+    req = bl_atomic_uword_load (&l->flush_req, bl_mo_seq_cst);
+    uword expected = 0;
+    if (req == seq || !bl_atomic_uword_strong_cas(
+      &l->flush_pending, &expected, 1, bl_mo_seq_cst, bl_mo_relaxed
+      )) {
+      return;
+    }
+  }
+  /* tickets taken while this command was on the queue aren't covered by it,
+  as their entries might be behind it. Send the command again. */
+  malc_send_flush (l, req);
 }
 /*----------------------------------------------------------------------------*/
-static void malc_send_blocking_flush (malc* l)
+static bool malc_wait_flushed_until(
+  malc const* l, size_t ticket, bl_timept64 const* deadline
+  )
 {
-  qnode               n;
   bl_nonblock_backoff b;
-
-  n.slots = 0;
-  n.info.cmd = q_cmd_flush;
-  bl_mpsc_i_node_set (&n.hook, nullptr, 0, 0);
-  bl_mpsc_i_produce_notag (&l->q, &n.hook);
-
   bl_nonblock_backoff_init (&b, 10, 15, 1, 2, 1, 100);
-  while (n.slots == 0) {
+  while (!malc_is_flushed (l, ticket)) {
+    if (deadline && bl_fast_timept_deadline_expired (*deadline)) {
+      return false;
+    }
     bl_nonblock_backoff_run (&b);
   }
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+/* its address identifies the calling thread as the consumer owner */
+static bl_thread_local u8 malc_consumer_tid;
+/*----------------------------------------------------------------------------*/
+static inline uword malc_this_thread_id (void)
+{
+  return (uword) &malc_consumer_tid;
+}
+/*----------------------------------------------------------------------------*/
+/* enters the consumer critical section. The owner of the consumer doesn't
+need the mutex, the rest of threads can't enter while there is an owner. */
+static bl_err malc_consumer_enter (malc* l, bool* mutexed)
+{
+  /* only this thread could have stored its own id */
+  if (bl_likely(
+    bl_atomic_uword_load_rlx (&l->consumer_owner) == malc_this_thread_id()
+    )) {
+    *mutexed = false;
+    return bl_mkok();
+  }
+  bl_err err = bl_mutex_lock (&l->produce_mutex);
+  if (bl_unlikely (err.own)) {
+    return err;
+  }
+  /* pairs with the release on "malc_consumer_release" */
+  if (bl_atomic_uword_load (&l->consumer_owner, bl_mo_acquire) != 0) {
+    bl_mutex_unlock (&l->produce_mutex);
+    return bl_mkerr (bl_locked);
+  }
+  *mutexed = true;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+static inline void malc_consumer_leave (malc* l, bool mutexed)
+{
+  if (mutexed) {
+    bl_mutex_unlock (&l->produce_mutex);
+  }
 }
 /*----------------------------------------------------------------------------*/
 static bool malc_try_run_idle_task (malc* l, bl_timept64 now)
@@ -136,6 +317,9 @@ static bool malc_try_run_idle_task (malc* l, bl_timept64 now)
     return false;
   }
   destinations_idle_task (&l->dst, bl_fast_timept_to_nsec (now));
+  if (l->tsc) {
+    tsc_calib_refresh (&l->tsc_calib);
+  }
   do {
     l->idle_deadline += bl_usec_to_fast_timept(
       l->consumer.idle_task_period_us
@@ -150,6 +334,13 @@ MALC_EXPORT size_t malc_get_size (void)
   return sizeof (malc);
 }
 /*----------------------------------------------------------------------------*/
+/* a thread exiting without "malc_consumer_release". Its id (a TLS address)
+could be reused by a new thread. */
+static void bl_tss_dtor_callconv malc_consumer_owner_exit (void* opaque)
+{
+  (void) malc_consumer_release ((malc*) opaque);
+}
+/*----------------------------------------------------------------------------*/
 MALC_EXPORT bl_err malc_create (malc* l, bl_alloc_tbl const* alloc)
 {
   if (!alloc) {
@@ -159,8 +350,13 @@ MALC_EXPORT bl_err malc_create (malc* l, bl_alloc_tbl const* alloc)
   if (err.own) {
     return err;
   }
+  err = bl_tss_init (&l->owner_tss, &malc_consumer_owner_exit);
+  if (err.own) {
+    return err;
+  }
   err = bl_mutex_init (&l->produce_mutex);
   if (err.own) {
+    bl_tss_destroy (l->owner_tss);
     return err;
   }
   err = memory_init (&l->mem, alloc);
@@ -176,18 +372,58 @@ MALC_EXPORT bl_err malc_create (malc* l, bl_alloc_tbl const* alloc)
     goto deserializer_destroy;
   }
   destinations_init (&l->dst, alloc);
+  log_batch_init (&l->batch);
+  reorder_buffer_init (&l->rb);
 
   /*Set all producer/consumer default settings*/
   l->consumer.idle_task_period_us = 300000;
   l->consumer.backoff_max_us      = 2000;
+  l->consumer.wait_strategy       = malc_wait_backoff;
   l->consumer.start_own_thread    = false;
+  l->consumer.batch_max_entries   = 0;
+  l->consumer.batch_max_us        = 1000;
+  l->consumer.reorder_max_entries = 0;
+  l->consumer.reorder_window_us   = 1000;
+  l->consumer.priority_max_streak = 64;
 #if BL_HAS_CPU_TIMEPT == 1
   l->producer.timestamp = true;
 #else
   l->producer.timestamp = false;
 #endif
+  l->producer.timestamp_delta = false;
+  l->producer.timestamp_tsc   = false;
+  l->producer.tls_spsc_lanes = false;
+  l->producer.tls_free_index = false;
+  l->producer.backpressure   = malc_backpressure_drop;
+  memset(
+    l->producer.backpressure_sev,
+    malc_backpressure_default,
+    sizeof l->producer.backpressure_sev
+    );
+  l->producer.backpressure_retry_us = 1000;
+  l->producer.priority_sev          = malc_sev_off;
+  l->lane_rr                 = 0;
+  l->lane_rescan             = 0;
+  l->prio_streak             = 0;
+  l->ts_delta                = false;
+  l->tsc                     = false;
+  l->ts_bases                = nullptr;
 
   bl_mpsc_i_init (&l->q);
+  bl_mpsc_i_init (&l->qprio);
+  waiter_init (&l->waiter);
+  bl_atomic_uword_store_rlx (&l->flush_req, 0);
+  bl_atomic_uword_store_rlx (&l->flush_pending, 0);
+  bl_atomic_uword_store_rlx (&l->flush_done, 0);
+  bl_atomic_uword_store_rlx (&l->reorder_late, 0);
+  bl_atomic_uword_store_rlx (&l->drops_dirty, 0);
+  bl_atomic_uword_store_rlx (&l->consumer_owner, 0);
+  drop_counters_init (&l->drops_shared);
+  drop_counters_init (&l->drops_seen);
+  drop_totals_init (&l->drops_retired);
+  for (uword i = 0; i < malc_drop_reason_count; ++i) {
+    l->drops_since[i] = bl_fast_timept_to_nsec (bl_fast_timept_get());
+  }
   l->alloc = alloc;
   bl_atomic_uword_store_rlx (&l->state, st_stopped);
   return bl_mkok();
@@ -198,6 +434,7 @@ deserializer_destroy:
   deserializer_destroy (&l->ds, alloc);
 memory_destroy:
   memory_destroy (&l->mem, alloc);
+  bl_tss_destroy (l->owner_tss);
   return err;
 }
 /*----------------------------------------------------------------------------*/
@@ -213,11 +450,16 @@ MALC_EXPORT bl_err malc_destroy (malc* l)
     bl_thread_join (&l->thread);
   }
   bl_mutex_destroy (&l->produce_mutex);
+  bl_tss_destroy (l->owner_tss);
   bl_time_extras_destroy();
   memory_destroy (&l->mem, l->alloc);
   deserializer_destroy (&l->ds, l->alloc);
   entry_parser_destroy (&l->ep);
   destinations_destroy (&l->dst);
+  log_batch_destroy (&l->batch, l->alloc);
+  reorder_buffer_destroy (&l->rb, l->alloc);
+  bl_dealloc (l->alloc, l->ts_bases);
+  waiter_destroy (&l->waiter);
   l->alloc = nullptr;
   return bl_mkok();
 }
@@ -232,6 +474,30 @@ MALC_EXPORT bl_err malc_get_cfg (malc const* l, malc_cfg* cfg)
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
+MALC_EXPORT bl_err malc_get_stats (malc const* l, malc_stats* stats)
+{
+  if (!l || !stats) {
+    return bl_mkerr (bl_invalid);
+  }
+  stats->reorder_late_entries =
+    bl_atomic_uword_load_rlx ((bl_atomic_uword*) &l->reorder_late);
+  for (uword i = 0; i < malc_drop_reason_count; ++i) {
+    stats->dropped_entries[i] = bl_atomic_uword_load_rlx(
+      (bl_atomic_uword*) &l->drops_seen.entries[i]
+      );
+    stats->dropped_bytes[i] = bl_atomic_uword_load_rlx(
+      (bl_atomic_uword*) &l->drops_seen.bytes[i]
+      );
+  }
+  uword faults, locked;
+  memory_prefault_stats (&l->mem, &faults, &locked);
+  stats->prefault_page_faults = faults;
+  stats->locked_bytes         = locked;
+  stats->heap_pool_bytes      = memory_heap_pool_bytes (&l->mem);
+  stats->write_error_entries  = destinations_write_errors (&l->dst);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
 static void malc_producer_thread_env_init (malc* l)
 {
     bl_timept64 now = bl_fast_timept_get();
@@ -245,11 +511,14 @@ static void malc_producer_thread_env_init (malc* l)
 static int malc_thread (void* d)
 {
   malc_producer_thread_env_init ((malc*) d);
+  /* no other thread is allowed to consume, so the mutex is skipped */
+  (void) malc_consumer_acquire ((malc*) d);
   bl_err err;
   do {
     err = malc_run_consume_task ((malc*) d, 200000);
   }
   while (!err.own || err.own == bl_nothing_to_do);
+  (void) malc_consumer_release ((malc*) d);
   return 0;
 }
 /*----------------------------------------------------------------------------*/
@@ -263,7 +532,44 @@ MALC_EXPORT bl_err malc_init (malc* l, malc_cfg const* cfg_readonly)
   else {
     malc_get_cfg (l, &cfg);
   }
-  if (cfg.consumer.backoff_max_us == 0) {
+  if (cfg.consumer.backoff_max_us == 0 ||
+    cfg.consumer.wait_strategy >= malc_wait_strategy_count
+    ) {
+    return bl_mkerr (bl_invalid);
+  }
+  if (cfg.producer.backpressure == malc_backpressure_default ||
+    cfg.producer.backpressure >= malc_backpressure_count
+    ) {
+    return bl_mkerr (bl_invalid);
+  }
+  for (uword i = 0; i < MALC_SEVERITY_COUNT; ++i) {
+    if (cfg.producer.backpressure_sev[i] >= malc_backpressure_count) {
+      return bl_mkerr (bl_invalid);
+    }
+  }
+  if (cfg.producer.priority_sev != malc_sev_off &&
+    (!malc_is_valid_severity (cfg.producer.priority_sev) ||
+      cfg.consumer.priority_max_streak == 0)
+    ) {
+    return bl_mkerr (bl_invalid);
+  }
+  if (cfg.consumer.wait_strategy == malc_wait_event_fd &&
+    (cfg.consumer.start_own_thread || !MALC_HAS_WAITER)
+    ) {
+    return bl_mkerr (bl_invalid);
+  }
+  if ((cfg.alloc.buffers_huge_pages || cfg.alloc.buffers_numa_local) &&
+    !MALC_HAS_PAGE_ALLOCATOR
+    ) {
+    return bl_mkerr (bl_invalid);
+  }
+  if (cfg.alloc.buffers_lock && !MALC_HAS_MLOCK) {
+    return bl_mkerr (bl_invalid);
+  }
+  if (cfg.alloc.slot_size < MALC_MIN_SLOT_SIZE ||
+    cfg.alloc.slot_size > MALC_MAX_SLOT_SIZE ||
+    !bl_is_pow2 (cfg.alloc.slot_size)
+    ) {
     return bl_mkerr (bl_invalid);
   }
   bl_err err = destinations_validate_rate_limit_settings (&l->dst, &cfg.sec);
@@ -273,14 +579,21 @@ MALC_EXPORT bl_err malc_init (malc* l, malc_cfg const* cfg_readonly)
   /* booleanization */
   cfg.consumer.start_own_thread = !!cfg.consumer.start_own_thread;
   cfg.producer.timestamp        = !!cfg.producer.timestamp;
+  cfg.producer.timestamp_delta  = !!cfg.producer.timestamp_delta;
+  cfg.producer.timestamp_tsc    = !!cfg.producer.timestamp_tsc;
+  cfg.producer.tls_spsc_lanes   = !!cfg.producer.tls_spsc_lanes;
+  cfg.producer.tls_free_index   = !!cfg.producer.tls_free_index;
   cfg.sec.sanitize_log_entries  = !!cfg.sec.sanitize_log_entries;
+  if (cfg.consumer.wait_strategy == malc_wait_blocking && !MALC_HAS_WAITER) {
+    cfg.consumer.wait_strategy = malc_wait_backoff;
+  }
 
   /* initialization */
   uword expected = st_stopped;
   if (!bl_atomic_uword_strong_cas_rlx (&l->state, &expected, st_initializing)) {
     return bl_mkerr (bl_preconditions);
   }
-  l->mem.cfg  = cfg.alloc;
+  memory_set_cfg (&l->mem, &cfg.alloc);
   l->consumer = cfg.consumer;
   l->producer = cfg.producer;
   l->ep.sanitize_log_entries = cfg.sec.sanitize_log_entries;
@@ -288,10 +601,63 @@ MALC_EXPORT bl_err malc_init (malc* l, malc_cfg const* cfg_readonly)
   if (err.own) {
     goto finish;
   }
+  switch (l->consumer.wait_strategy) {
+  case malc_wait_blocking:
+    err = waiter_reset (&l->waiter, waiter_futex);
+    break;
+  case malc_wait_event_fd:
+    err = waiter_reset (&l->waiter, waiter_fd);
+    break;
+  default:
+    err = waiter_reset (&l->waiter, waiter_none);
+    break;
+  }
+  if (err.own) {
+    goto finish;
+  }
   err = memory_bounded_buffer_init (&l->mem, l->alloc);
   if (err.own) {
     goto finish;
   }
+  err = log_batch_reset(
+    &l->batch,
+    l->consumer.batch_max_entries,
+    l->consumer.batch_max_entries * LOG_BATCH_ENTRY_AVG_BYTES,
+    l->alloc
+    );
+  if (err.own) {
+    goto finish;
+  }
+  /* ordering by consumer-side timestamps is meaningless */
+  err = reorder_buffer_reset(
+    &l->rb,
+    l->producer.timestamp ? l->consumer.reorder_max_entries : 0,
+    ((u64) l->consumer.reorder_window_us) * 1000,
+    l->alloc
+    );
+  if (err.own) {
+    goto finish;
+  }
+  /* the streams have to be decoded in order, see "timestamp_delta.h" */
+  l->ts_delta = l->producer.timestamp && l->producer.timestamp_delta &&
+    !l->producer.tls_spsc_lanes && !reorder_buffer_is_enabled (&l->rb);
+  if (l->ts_delta && !l->ts_bases) {
+    l->ts_bases = (bl_timept64*) bl_alloc(
+      l->alloc, ts_delta_max_streams * sizeof *l->ts_bases
+      );
+    if (!l->ts_bases) {
+      l->ts_delta = false;
+      err         = bl_mkerr (bl_alloc);
+      goto finish;
+    }
+  }
+  /* the clock is used when the TSC is not invariant */
+  l->tsc = l->producer.timestamp && l->producer.timestamp_tsc &&
+    tsc_is_invariant();
+  if (l->tsc) {
+    tsc_calib_init (&l->tsc_calib, 2000);
+  }
+  deserializer_set_tsc (&l->ds, l->tsc ? &l->tsc_calib : nullptr);
   if (l->consumer.start_own_thread) {
     err = bl_thread_init (&l->thread, malc_thread, l);
     if (!err.own) {
@@ -310,14 +676,58 @@ finish:
   return err;
 }
 /*----------------------------------------------------------------------------*/
-MALC_EXPORT bl_err malc_flush (malc* l)
+MALC_EXPORT bl_err malc_flush_async (malc* l, size_t* ticket)
 {
   uword current = st_get_updated_state_val;
   (void) bl_atomic_uword_strong_cas_rlx (&l->state, &current, st_invalid);
   if (bl_unlikely (current != st_running)) {
     return bl_mkerr (bl_preconditions);
   }
-  malc_send_blocking_flush (l);
+  uword t = bl_atomic_uword_fetch_add (&l->flush_req, 1, bl_mo_seq_cst) + 1;
+  uword expected = 0;
+  if (bl_atomic_uword_strong_cas(
+    &l->flush_pending, &expected, 1, bl_mo_seq_cst, bl_mo_relaxed
+    )) {
+    /* covers all the tickets taken until now, including "t" */
+    malc_send_flush (l, bl_atomic_uword_load (&l->flush_req, bl_mo_seq_cst));
+  }
+  /* else: the command is already on the queue, it will be resent by the
+  consumer if it doesn't cover "t" (see "malc_publish_flush") */
+  *ticket = (size_t) t;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+MALC_EXPORT bool malc_is_flushed (malc const* l, size_t ticket)
+{
+  uword done = bl_atomic_uword_load(
+    (bl_atomic_uword*) &l->flush_done, bl_mo_acquire
+    );
+  /* wraparound-safe */
+  return (word) (done - (uword) ticket) >= 0;
+}
+/*----------------------------------------------------------------------------*/
+MALC_EXPORT bl_err malc_wait_flushed(
+  malc* l, size_t ticket, unsigned timeout_us
+  )
+{
+  bl_timept64 deadline;
+  bl_err err = bl_fast_timept_deadline_init_usec (&deadline, timeout_us);
+  if (bl_unlikely (err.own)) {
+    return err;
+  }
+  return bl_mkerr(
+    malc_wait_flushed_until (l, ticket, &deadline) ? bl_ok : bl_timeout
+    );
+}
+/*----------------------------------------------------------------------------*/
+MALC_EXPORT bl_err malc_flush (malc* l)
+{
+  size_t ticket;
+  bl_err err = malc_flush_async (l, &ticket);
+  if (bl_unlikely (err.own)) {
+    return err;
+  }
+  (void) malc_wait_flushed_until (l, ticket, nullptr);
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
@@ -344,14 +754,41 @@ MALC_EXPORT bl_err malc_terminate (malc* l, bool nowait)
   n->slots = 0;
   n->info.cmd = q_cmd_terminate;
   bl_mpsc_i_node_set (&n->hook, nullptr, 0, 0);
-  bl_mpsc_i_produce_notag (&l->q, &n->hook);
+  malc_produce (l, n);
 
   if (!nowait) {
-    bl_err err;
-    do {
+    bl_err              err;
+    bool                waiting = false;
+    bl_timept64         deadline;
+    bl_nonblock_backoff b;
+    while (1) {
       err = malc_run_consume_task (l, 1000);
+      if (err.own == bl_ok || err.own == bl_nothing_to_do) {
+        continue;
+      }
+      if (err.own != bl_locked) {
+        break;
+      }
+      /* the consumer owner will process the termination command. If it
+      releases the consumer this thread takes over. */
+      if (bl_atomic_uword_load (&l->state, bl_mo_acquire) == st_stopped) {
+        err = bl_mkerr (bl_preconditions);
+        break;
+      }
+      bl_timept64 now = bl_fast_timept_get_fast();
+      if (!waiting) {
+        waiting = true;
+        (void) bl_fast_timept_deadline_init_usec_explicit(
+          &deadline, now, malc_terminate_owner_wait_us
+          );
+        bl_nonblock_backoff_init (&b, 10, 15, 1, 2, 1, 100);
+      }
+      else if (bl_fast_timept_deadline_expired_explicit (deadline, now)) {
+        /* the owner is gone or not running the consume task */
+        return bl_mkerr (bl_locked);
+      }
+      bl_nonblock_backoff_run (&b);
     }
-    while (err.own == bl_ok || err.own == bl_nothing_to_do);
     if (bl_unlikely (err.own != bl_preconditions)) {
       /* real error condition */
       return err;
@@ -370,180 +807,596 @@ MALC_EXPORT bl_err malc_producer_thread_local_init (malc* l, size_t bytes)
   n->n.slots = 0;
   n->n.info.cmd = q_cmd_tls_register;
   bl_err err = memory_tls_init_unregistered(
-    &l->mem, bytes, l->alloc, &malc_tls_destructor, l, &n->mem
+    &l->mem,
+    bytes,
+    l->alloc,
+    l->producer.tls_spsc_lanes,
+    l->producer.tls_free_index,
+    &malc_tls_segment_retire,
+    &malc_tls_destructor,
+    l,
+    &n->mem
     );
   if (bl_unlikely (err.own)) {
     bl_dealloc (l->alloc, n);
     return err;
   }
   bl_mpsc_i_node_set (&n->n.hook, nullptr, 0, 0);
-  bl_mpsc_i_produce_notag (&l->q, &n->n.hook);
+  malc_produce (l, &n->n);
   return err;
 }
 /*----------------------------------------------------------------------------*/
-MALC_EXPORT bl_err malc_run_consume_task (malc* l, unsigned timeout_us)
+static bl_err malc_consume (bl_mpsc_i* q, bl_mpsc_i_node** qn)
 {
-  bl_timept64 deadline;
-  bl_timept64 now = bl_fast_timept_get();
-  uword count  = 0;
-  bl_err err =
-    bl_fast_timept_deadline_init_usec_explicit (&deadline, now, timeout_us);
-
-  if (bl_unlikely (err.own)) {
-    return err;
+  bl_err err;
+  uword retries = 0;
+  while (1) {
+    *qn = nullptr;
+    err = bl_mpsc_i_consume (q, qn, 0);
+    if (err.own != bl_busy) {
+      return err;
+    }
+    ++retries;
+    if (retries > 5) {
+      bl_thread_yield();
+    }
+    else {
+      bl_processor_pause();
+      bl_processor_pause();
+    }
   }
-  err = bl_mutex_lock (&l->produce_mutex);
-  if (bl_unlikely (err.own)) {
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_err malc_consume_node (bl_mpsc_i* q, qnode** n)
+{
+  bl_mpsc_i_node* qn;
+  bl_err err = malc_consume (q, &qn);
+  *n = !err.own ? bl_to_type_containing (qn, hook, qnode) : nullptr;
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+/* round-robin between the shared queue and the busy TLS SPSC lanes, one node
+from each source at a time. The idle lanes are only polled by a rescan, done
+when the busy sources run out of nodes and every "lane_rescan" dequeues, so a
+dequeue doesn't cost O(threads) when there are many idle producers. */
+static bl_err malc_dequeue_normal (malc* l, qnode** n)
+{
+  bl_mpsc_i_node* qn;
+  bl_err          err;
+  if (!l->producer.tls_spsc_lanes) {
+    err = malc_consume (&l->q, &qn);
+    *n  = !err.own ? bl_to_type_containing (qn, hook, qnode) : nullptr;
     return err;
   }
-  if (timeout_us && bl_fast_timept_deadline_expired (deadline)) {
-    /* blocked at the mutex for too long.*/
-    count = 1; /* to return OK instead of nothing to do */
-    goto unlock;
-  }
-  uword state = bl_atomic_uword_load (&l->state, bl_mo_acquire);
-  if (bl_unlikely (state != st_running && state != st_terminating)) {
-    bl_mutex_unlock (&l->produce_mutex);
-    return bl_mkerr (bl_preconditions);
+  if (l->lane_rescan == 0) {
+    (void) memory_tls_lanes_rescan (&l->mem);
+    l->lane_rescan = memory_tls_lane_count (&l->mem) + 1;
   }
-  bl_mpsc_i_node* qn;
-  uword retries;
-  do {
-    retries = 0;
-    while (1) {
-      qn = nullptr;
-      err = bl_mpsc_i_consume (&l->q, &qn, 0);
-      if (err.own != bl_busy) {
-        break;
-      }
-      ++retries;
-      if (retries > 5) {
-        bl_thread_yield();
-      }
-      else {
-        bl_processor_pause();
-        bl_processor_pause();
-      }
-    }
-    if (bl_likely (!err.own)) {
-      ++count;
-      qnode* n = bl_to_type_containing (qn, hook, qnode);
-      switch (n->info.cmd) {
-      case q_cmd_entry: {
-        alloc_tag tag = n->info.tag;
-        u32 slots     = ((u32) n->slots) + 1;
-        deserializer_reset (&l->ds);
-        err = deserializer_execute(
-          &l->ds,
-          ((u8*) n) + sizeof *n,
-          ((u8*) n) + (slots * l->mem.cfg.slot_size),
-          n->info.has_timestamp,
-          l->alloc
-          );
+  --l->lane_rescan;
+  for (uword pass = 0; pass < 2; ++pass) {
+    /* source 0 is the shared queue, "i + 1" is the busy lane with index "i".
+    Each source is polled once: a busy lane found empty leaves the list and
+    its index is taken by a lane not polled yet. */
+    uword polls = memory_tls_lanes_busy (&l->mem) + 1;
+    for (uword i = 0; i < polls; ++i) {
+      uword sources = memory_tls_lanes_busy (&l->mem) + 1;
+      uword src     = l->lane_rr < sources ? l->lane_rr : 0;
+      l->lane_rr    = src + 1;
+      if (src == 0) {
+        err = malc_consume (&l->q, &qn);
         if (!err.own) {
-          log_entry le = deserializer_get_log_entry (&l->ds);
-          malc_log_strings strs;
-          bl_err entry_err = entry_parser_get_log_strings (&l->ep, &le, &strs);
-          if (bl_likely (!entry_err.own)) {
-            /*NOTE: Possible problem when using the rate_filter:
-
-            The format string pointer (to a constant) is used raw as an entry
-            id/hash. This can potentially lead to id/hash collisions on the
-            rate_filter if some entries have the same format string. (e.g. {})
-            and the linker optimizes them away (it should).
-
-            If I had to improve this, my preferred way would be to always
-            concatenate __LINE__ to the format string to decrease the chances
-            of the linker optimizing a given string. Then __LINE__ would
-            be just ignored by the entry_parser. This method decreases the
-            collision chance a lot withouth needing to bloat the binaries by
-            forcing the use of __FILE__.
-
-            Note that log lines that prefix the file and line are not affected
-            by this. */
-            destinations_write(
-              &l->dst,
-              (uword) le.entry->format,
-              l->ds.t,
-              le.entry->info[0],
-              &strs
-              );
-          }
+          *n = bl_to_type_containing (qn, hook, qnode);
+          return err;
         }
-        else {
-          assert (false && "bug or something malicious happenning");
-          /*in this case */
+        if (err.own != bl_empty) {
+          return err;
         }
-        memory_dealloc (&l->mem, (u8*) n, tag, slots);
-        break;
+      }
+      else {
+        *n = (qnode*) memory_tls_busy_lane_pop (&l->mem, src - 1);
+        if (*n) {
+          return bl_mkok();
         }
-      case q_cmd_tls_register:
-        /* a list will all the created TLS buffers is maintained. The
-        registered TLS buffers are serialized through the event loop, so they
-        avoid mutexes. This is done like this because they are also unregistered
-        by this function/thread. */
-        memory_tls_register (&l->mem, ((qnode_tls_alloc*) n)->mem, l->alloc);
-        bl_dealloc (l->alloc, n);
-        break;
-
-      case q_cmd_tls_dealloc_deregister:
-        /* when a thread goes out of scope the TLS destructor runs. This
-        destructor calls "malc_tls_destructor", which sends the whole TLS buffer
-        memory chunk as a queue node, so it is deallocated from this (consumer)
-        thread. This is to guarantee that all pending entries originated on each
-        TLS buffer are consumed before deallocating the buffer itself. See
-        "malc_tls_destructor". */
-        bl_assert_side_effect(
-          memory_tls_destroy (&l->mem, (void*) n, l->alloc)
-          );
-        break;
-
-      case q_cmd_flush:
-        destinations_flush (&l->dst);
-        ++n->slots; /* poor-man's signalling back to the caller */
-        break;
-
-      case q_cmd_terminate:
-        bl_assert(
-          bl_atomic_uword_load_rlx (&l->state) == st_terminating && "Malc BUG"
-          );
-        bl_assert(
-          bl_mpsc_i_consume (&l->q, &qn, 0).own == bl_empty &&
-          "client code BUG: sending messages after termination. May leak."
-          );
-        bl_dealloc (l->alloc, n);
-        destinations_terminate (&l->dst);
-        /*Destroy all registered TLS buffers. From now on all thread local
-        buffers from an hypothetical thread outliving the logger
-        ("bl_thread_local malc_tls") will be dangled. The docs say that threads
-        using TLS can't outlive the logger (reason on the next paragraph) so the
-        TLS buffers are dangled on purpose, forcing the user to investigate the
-        segfaults that doing this will (hopefully) trigger.
-
-        The reason why the threads with TLS buffers can't outlive the logger is
-        that a "thread local" variable can't be set from another thread (this
-        one), so there is no way to force a clean and safe shutdown sequence
-        (that I can think of) from inside the library (setting the pointer to
-        null + deallocating) without using heavyweight locking, which defeats
-        the purpose of this library. The user is forced to only use TLS on
-        threads that he owns, which is a good side effect IMO.*/
-        memory_tls_destroy_all (&l->mem, l->alloc);
-        /* release fence here to ensure that all the actions done on
-        "destinations_terminate" are visibile to the thread that called
-        "malc_terminate" */
-        bl_atomic_uword_store (&l->state, st_stopped, bl_mo_release);
-        goto unlock;
-      default:
-        bl_assert (0 && "bug or malicious code");
-        break;
+        l->lane_rr = src;
       }
+    }
+    if (memory_tls_lanes_rescan (&l->mem) == 0) {
+      break;
+    }
+  }
+  *n = nullptr;
+  return bl_mkerr (bl_empty);
+}
+/*----------------------------------------------------------------------------*/
+/* the priority queue goes first, but after "priority_max_streak" consecutive
+priority nodes a node from the normal sources is taken (if any) */
+static bl_err malc_dequeue (malc* l, qnode** n)
+{
+  if (l->producer.priority_sev == malc_sev_off) {
+    return malc_dequeue_normal (l, n);
+  }
+  bool prio_first = l->prio_streak < l->consumer.priority_max_streak;
+  bl_err err;
+  if (prio_first) {
+    err = malc_consume_node (&l->qprio, n);
+    if (err.own != bl_empty) {
+      l->prio_streak += !err.own;
+      return err;
+    }
+  }
+  l->prio_streak = 0;
+  err = malc_dequeue_normal (l, n);
+  if (err.own != bl_empty || prio_first) {
+    return err;
+  }
+  return malc_consume_node (&l->qprio, n);
+}
+/*----------------------------------------------------------------------------*/
+static bool malc_process_node (malc* l, qnode* n);
+/*----------------------------------------------------------------------------*/
+/* consumer side. The priority entries of a thread might be still on the
+queue when its commands are processed. */
+static void malc_prio_drain (malc* l)
+{
+  qnode* n;
+  if (l->producer.priority_sev == malc_sev_off) {
+    return;
+  }
+  while (!malc_consume_node (&l->qprio, &n).own) {
+    bl_assert (qnode_is_entry (n));
+    (void) malc_process_node (l, n);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void malc_tls_lane_drain (malc* l, tls_buffer* t)
+{
+  qnode* n;
+  while ((n = (qnode*) tls_buffer_lane_pop (t))) {
+    bl_assert (qnode_is_entry (n));
+    (void) malc_process_node (l, n);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void malc_tls_lanes_drain (malc* l)
+{
+  for (uword i = 0; i < memory_tls_lane_count (&l->mem); ++i) {
+    qnode* n;
+    while ((n = (qnode*) memory_tls_lane_pop (&l->mem, i))) {
+      bl_assert (qnode_is_entry (n));
+      (void) malc_process_node (l, n);
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void malc_write_batch (malc* l)
+{
+  if (log_batch_size (&l->batch)) {
+    destinations_write_batch (&l->dst, &l->batch);
+    log_batch_clear (&l->batch);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline bool malc_batch_expired (malc* l)
+{
+  return log_batch_size (&l->batch) &&
+    bl_fast_timept_deadline_expired_explicit(
+      l->batch_deadline, bl_fast_timept_get_fast()
+      );
+}
+/*----------------------------------------------------------------------------*/
+static void malc_write_entry(
+  malc* l, uword entry_id, u64 nsec, unsigned sev, malc_log_strings const* strs
+  )
+{
+  if (!log_batch_is_enabled (&l->batch)) {
+    destinations_write (&l->dst, entry_id, nsec, sev, strs);
+    return;
+  }
+  if (bl_unlikely (!log_batch_push (&l->batch, entry_id, nsec, sev, strs))) {
+    /* no arena space left: write the pending entries and retry */
+    malc_write_batch (l);
+    if (!log_batch_push (&l->batch, entry_id, nsec, sev, strs)) {
+      /* bigger than the whole arena, written unbatched */
+      destinations_write (&l->dst, entry_id, nsec, sev, strs);
+      return;
+    }
+  }
+  if (log_batch_size (&l->batch) == 1) {
+    (void) bl_fast_timept_deadline_init_usec_explicit(
+      &l->batch_deadline, bl_fast_timept_get_fast(), l->consumer.batch_max_us
+      );
+  }
+  if (log_batch_is_full (&l->batch)) {
+    malc_write_batch (l);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void malc_process_entry (malc* l, qnode* n)
+{
+  alloc_tag tag = n->info.tag;
+  u16 qidx      = n->qidx;
+  u32 slots     = qnode_entry_slots (n);
+  deserializer_reset (&l->ds);
+  if (alloc_tag_is_tls (tag) && qidx != 0) {
+    deserializer_set_timestamp_base(
+      &l->ds,
+      &l->ts_bases[ts_delta_qidx_stream (qidx)],
+      ts_delta_format_bytes (ts_delta_qidx_format (qidx))
+      );
+  }
+  bl_err err = deserializer_execute(
+    &l->ds,
+    qnode_entry_payload (n),
+    memory_entry_end (&l->mem, (u8*) n, tag, qidx, slots),
+    n->info.has_timestamp,
+    l->alloc
+    );
+  if (!err.own) {
+    log_entry le = deserializer_get_log_entry (&l->ds);
+    malc_log_strings strs;
+    bl_err entry_err = entry_parser_get_log_strings (&l->ep, &le, &strs);
+    if (bl_likely (!entry_err.own)) {
+      /* the rate filter needs an id per callsite. The entries not on the
+      callsite registry use the format string pointer, which may collide if
+      some entries have the same format string (e.g. {}) and the linker
+      merges them. */
+      uword entry_id = bl_likely (le.entry_id != callsite_no_id)
+        ? le.entry_id : (uword) le.entry->format;
+      malc_write_entry (l, entry_id, l->ds.t, le.entry->info[0], &strs);
+    }
+  }
+  else {
+    assert (false && "bug or something malicious happenning");
+    /*in this case */
+  }
+  memory_dealloc (&l->mem, (u8*) n, tag, qidx, slots);
+}
+/*----------------------------------------------------------------------------*/
+static void malc_reorder_release_ready (malc* l, u64 now_ns)
+{
+  qnode* n;
+  while ((n = (qnode*) reorder_buffer_pop_ready (&l->rb, now_ns))) {
+    malc_process_entry (l, n);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline void malc_reorder_release_expired (malc* l)
+{
+  if (reorder_buffer_size (&l->rb)) {
+    malc_reorder_release_ready(
+      l, bl_fast_timept_to_nsec (bl_fast_timept_get_fast())
+      );
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void malc_reorder_release_all (malc* l)
+{
+  qnode* n;
+  while ((n = (qnode*) reorder_buffer_pop (&l->rb))) {
+    malc_process_entry (l, n);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void malc_reorder_entry (malc* l, qnode* n)
+{
+  u64 nsec;
+  u32 slots  = qnode_entry_slots (n);
+  bl_err err = deserializer_peek_timestamp(
+    &l->ds,
+    qnode_entry_payload (n),
+    memory_entry_end (&l->mem, (u8*) n, n->info.tag, n->qidx, slots),
+    true,
+    &nsec
+    );
+  if (bl_unlikely (err.own)) {
+    malc_process_entry (l, n); /* lets it fail there */
+    return;
+  }
+  if (bl_unlikely (!reorder_buffer_push (&l->rb, nsec, n))) {
+    /* too late, a newer entry was already written. Single writer. */
+    bl_atomic_uword_store_rlx(
+      &l->reorder_late, bl_atomic_uword_load_rlx (&l->reorder_late) + 1
+      );
+    malc_process_entry (l, n);
+    return;
+  }
+  malc_reorder_release_ready (l, 0);
+}
+/*----------------------------------------------------------------------------*/
+static char const* const drop_reason_strings[] = {
+  "no memory",
+  "too big",
+  "not running",
+};
+bl_static_assert_ns(
+  bl_arr_elems (drop_reason_strings) == malc_drop_reason_count
+  );
+/*----------------------------------------------------------------------------*/
+/* writes a warning entry for each drop reason with new drops since the last
+call. The producers only flag that there are new drops, so this is a relaxed
+load most of the time. */
+static void malc_report_drops (malc* l)
+{
+  if (bl_likely (!bl_atomic_uword_load_rlx (&l->drops_dirty))) {
+    return;
+  }
+  /* pairs with the release on "malc_count_drop" */
+  (void) bl_atomic_uword_exchange (&l->drops_dirty, 0, bl_mo_acquire);
+  drop_totals t = l->drops_retired;
+  drop_counters_sum (&l->drops_shared, &t);
+  memory_tls_drops_sum (&l->mem, &t);
+
+  u64 now      = bl_fast_timept_to_nsec (bl_fast_timept_get());
+  bool ordered = false;
+  for (uword i = 0; i < malc_drop_reason_count; ++i) {
+    uword entries =
+      t.entries[i] - bl_atomic_uword_load_rlx (&l->drops_seen.entries[i]);
+    uword bytes =
+      t.bytes[i] - bl_atomic_uword_load_rlx (&l->drops_seen.bytes[i]);
+    if (entries == 0) {
+      continue;
+    }
+    if (!ordered) {
+      /* the retained entries are older than the report */
+      malc_reorder_release_all (l);
+      ordered = true;
+    }
+    char text[128];
+    int len = snprintf(
+      text,
+      sizeof text,
+      "[malc] %" FMT_UWORD " entries (%" FMT_UWORD " bytes) dropped (%s) "
+        "since t=%" FMT_U64 ".%09" FMT_U64,
+      entries,
+      bytes,
+      drop_reason_strings[i],
+      l->drops_since[i] / bl_nsec_in_sec,
+      l->drops_since[i] % bl_nsec_in_sec
+      );
+    malc_log_strings strs;
+    entry_parser_get_internal_log_strings(
+      &l->ep,
+      now,
+      malc_sev_warning,
+      text,
+      (uword) bl_min (len, (int) sizeof text - 1),
+      &strs
+      );
+    /* the reason string address is the entry id for the rate filter */
+    malc_write_entry(
+      l, (uword) drop_reason_strings[i], now, malc_sev_warning, &strs
+      );
+    bl_atomic_uword_store_rlx (&l->drops_seen.entries[i], t.entries[i]);
+    bl_atomic_uword_store_rlx (&l->drops_seen.bytes[i], t.bytes[i]);
+    l->drops_since[i] = now;
+  }
+}
+/*----------------------------------------------------------------------------*/
+/* returns false when the node was the termination command */
+static bool malc_process_node (malc* l, qnode* n)
+{
+  switch (n->info.cmd) {
+  case q_cmd_entry:
+  case q_cmd_large_entry:
+    if (reorder_buffer_is_enabled (&l->rb) && n->info.has_timestamp) {
+      malc_reorder_entry (l, n);
+    }
+    else {
+      malc_process_entry (l, n);
+    }
+    break;
+
+  case q_cmd_tls_register:
+    /* a list will all the created TLS buffers is maintained. The
+    registered TLS buffers are serialized through the event loop, so they
+    avoid mutexes. This is done like this because they are also unregistered
+    by this function/thread. */
+    memory_tls_register (&l->mem, ((qnode_tls_alloc*) n)->mem, l->alloc);
+    bl_dealloc (l->alloc, n);
+    break;
+
+  case q_cmd_tls_dealloc_deregister:
+    /* when a thread goes out of scope the TLS destructor runs. This
+    destructor calls "malc_tls_destructor", which sends the whole TLS buffer
+    memory chunk as a queue node, so it is deallocated from this (consumer)
+    thread. This is to guarantee that all pending entries originated on each
+    TLS buffer are consumed before deallocating the buffer itself. See
+    "malc_tls_destructor". Entries on the SPSC lane are not ordered with
+    respect to the shared queue, so the lane is drained first. */
+    if (tls_buffer_has_lane ((tls_buffer*) n)) {
+      malc_tls_lane_drain (l, (tls_buffer*) n);
+    }
+    malc_prio_drain (l);
+    /* retained entries might be allocated on this buffer */
+    malc_reorder_release_all (l);
+    /* the drop counters of the thread outlive its buffer */
+    drop_counters_sum (&((tls_buffer*) n)->drops, &l->drops_retired);
+    bl_assert_side_effect (memory_tls_destroy (&l->mem, (void*) n));
+    break;
+
+  case q_cmd_tls_segment_retire:
+    /* the entries on the segment might be on any of the queues of the
+    producer thread */
+    malc_tls_lanes_drain (l);
+    malc_prio_drain (l);
+    malc_reorder_release_all (l);
+    memory_tls_segment_release (&l->mem, (tls_segment*) n);
+    break;
+
+  case q_cmd_flush:
+    malc_tls_lanes_drain (l);
+    malc_prio_drain (l);
+    malc_reorder_release_all (l);
+    malc_report_drops (l);
+    malc_write_batch (l);
+    destinations_flush (&l->dst);
+    malc_publish_flush (l, ((qnode_flush*) n)->seq);
+    break;
+
+  case q_cmd_terminate: {
+    bl_mpsc_i_node* qn = nullptr;
+    (void) qn;
+    bl_assert(
+      bl_atomic_uword_load_rlx (&l->state) == st_terminating && "Malc BUG"
+      );
+    bl_assert(
+      bl_mpsc_i_consume (&l->q, &qn, 0).own == bl_empty &&
+      "client code BUG: sending messages after termination. May leak."
+      );
+    bl_dealloc (l->alloc, n);
+    malc_tls_lanes_drain (l);
+    malc_prio_drain (l);
+    malc_reorder_release_all (l);
+    malc_report_drops (l);
+    malc_write_batch (l);
+    destinations_terminate (&l->dst);
+    /*Destroy all registered TLS buffers. From now on all thread local
+    buffers from an hypothetical thread outliving the logger
+    ("bl_thread_local malc_tls") will be dangled. The docs say that threads
+    using TLS can't outlive the logger (reason on the next paragraph) so the
+    TLS buffers are dangled on purpose, forcing the user to investigate the
+    segfaults that doing this will (hopefully) trigger.
+
+    The reason why the threads with TLS buffers can't outlive the logger is
+    that a "thread local" variable can't be set from another thread (this
+    one), so there is no way to force a clean and safe shutdown sequence
+    (that I can think of) from inside the library (setting the pointer to
+    null + deallocating) without using heavyweight locking, which defeats
+    the purpose of this library. The user is forced to only use TLS on
+    threads that he owns, which is a good side effect IMO.*/
+    memory_tls_destroy_all (&l->mem);
+    /* unblock the flush waiters */
+    bl_atomic_uword_store_rlx (&l->flush_pending, 0);
+    bl_atomic_uword_store(
+      &l->flush_done, bl_atomic_uword_load_rlx (&l->flush_req), bl_mo_release
+      );
+    /* release fence here to ensure that all the actions done on
+    "destinations_terminate" are visibile to the thread that called
+    "malc_terminate" */
+    bl_atomic_uword_store (&l->state, st_stopped, bl_mo_release);
+    return false;
+    }
+  default:
+    bl_assert (0 && "bug or malicious code");
+    break;
+  }
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+/* time until the first of "until", the idle task deadline or the reorder
+window expiration */
+static u64 malc_sleep_ns (malc* l, bl_timept64 now, bl_timept64 until)
+{
+  if (bl_fast_timept_get_diff (l->idle_deadline, until) < 0) {
+    until = l->idle_deadline;
+  }
+  if (bl_fast_timept_get_diff (until, now) <= 0) {
+    return 0;
+  }
+  u64 ns = bl_fast_timept_to_nsec (until - now);
+  if (reorder_buffer_size (&l->rb)) {
+    ns = bl_min (ns, l->rb.window_ns);
+  }
+  return ns;
+}
+/*----------------------------------------------------------------------------*/
+/* blocks until a producer enqueues something or until "malc_sleep_ns" expires.
+Returns a node if the queues were found non-empty when rechecking. */
+static qnode* malc_block (malc* l, bl_timept64 now, bl_timept64 deadline)
+{
+  qnode* n = nullptr;
+  u64 timeout_ns = malc_sleep_ns (l, now, deadline);
+  if (timeout_ns == 0) {
+    return nullptr;
+  }
+  waiter_prepare (&l->waiter);
+  /* recheck: a producer may have enqueued before seeing the flag */
+  bl_err err = malc_dequeue (l, &n);
+  if (err.own == bl_empty) {
+    waiter_wait (&l->waiter, timeout_ns);
+  }
+  waiter_done (&l->waiter);
+  return !err.own ? n : nullptr;
+}
+/*----------------------------------------------------------------------------*/
+MALC_EXPORT bl_err malc_run_consume_task (malc* l, unsigned timeout_us)
+{
+  bl_timept64 deadline;
+  bl_timept64 now = bl_fast_timept_get();
+  uword count  = 0;
+  bl_err err =
+    bl_fast_timept_deadline_init_usec_explicit (&deadline, now, timeout_us);
+
+  if (bl_unlikely (err.own)) {
+    return err;
+  }
+  bool mutexed;
+  err = malc_consumer_enter (l, &mutexed);
+  if (bl_unlikely (err.own)) {
+    return err;
+  }
+  if (mutexed && timeout_us && bl_fast_timept_deadline_expired (deadline)) {
+    /* blocked at the mutex for too long.*/
+    count = 1; /* to return OK instead of nothing to do */
+    goto unlock;
+  }
+  uword state = bl_atomic_uword_load (&l->state, bl_mo_acquire);
+  if (bl_unlikely (state != st_running && state != st_terminating)) {
+    malc_consumer_leave (l, mutexed);
+    return bl_mkerr (bl_preconditions);
+  }
+  qnode* n = nullptr;
+  do {
+    /* "n" might come already dequeued from "malc_block" */
+    err = n ? bl_mkok() : malc_dequeue (l, &n);
+    if (bl_likely (!err.own)) {
+      /* keep dequeueing until the queue is empty or the batch entry limit is
+      reached. When batching is disabled only one node is processed. */
+      uword consumed = 0;
+      do {
+        ++count;
+        ++consumed;
+        if (bl_unlikely (!malc_process_node (l, n))) {
+          goto unlock; /* terminated */
+        }
+        if (consumed >= l->consumer.batch_max_entries) {
+          break;
+        }
+        err = malc_dequeue (l, &n);
+      }
+      while (!err.own);
+      malc_report_drops (l);
+      if (err.own == bl_empty) {
+        malc_reorder_release_expired (l);
+      }
+      if (err.own == bl_empty || malc_batch_expired (l)) {
+        malc_write_batch (l);
+      }
+      n = nullptr;
       bl_nonblock_backoff_init_default(
         &l->cbackoff, l->consumer.backoff_max_us
         );
     }
     else if (err.own == bl_empty) {
+      /* everything might be getting dropped */
+      malc_report_drops (l);
+      malc_reorder_release_expired (l);
+      if (l->consumer.wait_strategy == malc_wait_busy_spin) {
+        bl_processor_pause();
+        now = bl_fast_timept_get_fast();
+        (void) malc_try_run_idle_task (l, now);
+        continue;
+      }
       bl_timeoft64 next_sleep_us =
         bl_nonblock_backoff_next_sleep_us (&l->cbackoff);
+      if (next_sleep_us && l->consumer.wait_strategy == malc_wait_blocking) {
+        /* past the spin/yield phase: block instead of sleeping */
+        if (!malc_try_run_idle_task (l, now)) {
+          n   = malc_block (l, now, deadline);
+          now = bl_fast_timept_get();
+        }
+        continue;
+      }
       bool do_backoff = true;
       if (l->idle_boundary_us < next_sleep_us)  {
         do_backoff = !malc_try_run_idle_task (l, now);
@@ -560,7 +1413,122 @@ MALC_EXPORT bl_err malc_run_consume_task (malc* l, unsigned timeout_us)
   }
   while (!bl_fast_timept_deadline_expired_explicit (deadline, now));
 unlock:
+  /* entries are never retained across calls */
+  malc_write_batch (l);
+  malc_consumer_leave (l, mutexed);
+  return bl_mkerr (count ? bl_ok : bl_nothing_to_do);
+}
+/*----------------------------------------------------------------------------*/
+MALC_EXPORT bl_err malc_consumer_acquire (malc* l)
+{
+  uword me = malc_this_thread_id();
+  if (bl_atomic_uword_load_rlx (&l->consumer_owner) == me) {
+    return bl_mkok();
+  }
+  /* waits for the consume tasks running on the mutex path to finish */
+  bl_err err = bl_mutex_lock (&l->produce_mutex);
+  if (bl_unlikely (err.own)) {
+    return err;
+  }
+  uword expected = 0;
+  bool acquired  = bl_atomic_uword_strong_cas(
+    &l->consumer_owner, &expected, me, bl_mo_acquire, bl_mo_relaxed
+    );
   bl_mutex_unlock (&l->produce_mutex);
+  if (!acquired) {
+    return bl_mkerr (bl_locked);
+  }
+  err = bl_tss_set (l->owner_tss, l);
+  if (bl_unlikely (err.own)) {
+    (void) malc_consumer_release (l);
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+MALC_EXPORT bl_err malc_consumer_release (malc* l)
+{
+  uword expected = malc_this_thread_id();
+  /* publishes the consumer state to the next owner or mutex path user */
+  if (!bl_atomic_uword_strong_cas(
+    &l->consumer_owner, &expected, 0, bl_mo_release, bl_mo_relaxed
+    )) {
+    return bl_mkerr (bl_preconditions);
+  }
+  (void) bl_tss_set (l->owner_tss, nullptr);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+MALC_EXPORT bl_err malc_get_consumer_fd (malc const* l, int* fd)
+{
+  if (bl_unlikely (!l || !fd)) {
+    return bl_mkerr (bl_invalid);
+  }
+  uword state = bl_atomic_uword_load (&l->state, bl_mo_acquire);
+  if (state != st_running || waiter_get_fd (&l->waiter) < 0) {
+    return bl_mkerr (bl_preconditions);
+  }
+  *fd = waiter_get_fd (&l->waiter);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+MALC_EXPORT bl_err malc_run_consume_task_ready (malc* l)
+{
+  uword  count = 0;
+  qnode* n;
+  bool   mutexed;
+  bl_err err = malc_consumer_enter (l, &mutexed);
+  if (bl_unlikely (err.own)) {
+    return err;
+  }
+  uword state = bl_atomic_uword_load (&l->state, bl_mo_acquire);
+  if (bl_unlikely(
+    (state != st_running && state != st_terminating) ||
+    l->consumer.wait_strategy != malc_wait_event_fd
+    )) {
+    malc_consumer_leave (l, mutexed);
+    return bl_mkerr (bl_preconditions);
+  }
+  /* producers don't need to signal while the queues are being drained */
+  waiter_done (&l->waiter);
+  waiter_fd_clear (&l->waiter);
+  while (1) {
+    while (!(err = malc_dequeue (l, &n)).own) {
+      ++count;
+      if (bl_unlikely (!malc_process_node (l, n))) {
+        goto unlock; /* terminated */
+      }
+    }
+    if (bl_unlikely (err.own != bl_empty)) {
+      goto unlock;
+    }
+    malc_report_drops (l);
+    malc_reorder_release_expired (l);
+    malc_write_batch (l);
+    waiter_prepare (&l->waiter);
+    /* recheck: a producer may have enqueued before seeing the flag */
+    err = malc_dequeue (l, &n);
+    if (err.own == bl_empty) {
+      break;
+    }
+    waiter_done (&l->waiter);
+    if (bl_unlikely (err.own)) {
+      goto unlock;
+    }
+    ++count;
+    if (bl_unlikely (!malc_process_node (l, n))) {
+      goto unlock; /* terminated */
+    }
+  }
+  bl_timept64 now = bl_fast_timept_get();
+  (void) malc_try_run_idle_task (l, now);
+  waiter_fd_arm (&l->waiter, malc_sleep_ns (l, now, l->idle_deadline));
+  err = bl_mkok();
+unlock:
+  malc_write_batch (l);
+  malc_consumer_leave (l, mutexed);
+  if (bl_unlikely (err.own && err.own != bl_empty)) {
+    return err;
+  }
   return bl_mkerr (count ? bl_ok : bl_nothing_to_do);
 }
 /*----------------------------------------------------------------------------*/
@@ -601,6 +1569,159 @@ MALC_EXPORT unsigned malc_get_min_severity (malc const* l)
   return destinations_min_severity (&l->dst);
 }
 /*----------------------------------------------------------------------------*/
+static inline unsigned malc_backpressure_policy (malc const* l, unsigned sev)
+{
+  unsigned p = malc_backpressure_default;
+  if (malc_is_valid_severity (sev)) {
+    p = l->producer.backpressure_sev[sev - malc_sev_debug];
+  }
+  return p != malc_backpressure_default ? p : l->producer.backpressure;
+}
+/*----------------------------------------------------------------------------*/
+/* slow path, all the memory sources are exhausted */
+static bl_err malc_alloc_backpressure(
+  malc*      l,
+  u8**       mem,
+  alloc_tag* tag,
+  u16*       qidx,
+  u32*       slots,
+  u32        size,
+  u32        max_n_slots,
+  unsigned   sev
+  )
+{
+  bl_timept64         deadline;
+  bl_nonblock_backoff b;
+  bl_err              err;
+
+  unsigned policy = malc_backpressure_policy (l, sev);
+  if (policy == malc_backpressure_drop) {
+    return bl_mkerr (bl_alloc);
+  }
+  bool timed = policy == malc_backpressure_retry;
+  if (timed) {
+    err = bl_fast_timept_deadline_init_usec(
+      &deadline, l->producer.backpressure_retry_us
+      );
+    if (bl_unlikely (err.own)) {
+      return err;
+    }
+  }
+  bl_nonblock_backoff_init (&b, 10, 15, 1, 2, 1, 100);
+  do {
+    if (timed && bl_fast_timept_deadline_expired (deadline)) {
+      return bl_mkerr (bl_alloc);
+    }
+    if (bl_unlikely (bl_atomic_uword_load_rlx (&l->state) != st_running)) {
+      return bl_mkerr (bl_preconditions);
+    }
+    bl_nonblock_backoff_run (&b);
+    err = memory_alloc (&l->mem, mem, tag, qidx, slots, size, max_n_slots);
+  }
+  while (err.own == bl_alloc);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+/* slow path, the entry is lost */
+static void malc_count_drop (malc* l, bl_err err, uword bytes)
+{
+  unsigned reason = malc_drop_no_memory;
+  if (err.own == bl_range) {
+    reason = malc_drop_too_big;
+  }
+  else if (err.own == bl_preconditions) {
+    reason = malc_drop_not_running;
+  }
+  /* after termination the TLS buffers are dangling, they are not touched */
+  if (reason == malc_drop_not_running
+    || !tls_buffer_count_drop (reason, bytes)
+    ) {
+    drop_counters_add_shared (&l->drops_shared, reason, bytes);
+  }
+  bl_atomic_uword_store (&l->drops_dirty, 1, bl_mo_release);
+}
+/*----------------------------------------------------------------------------*/
+static inline void malc_entry_node_init(
+  malc* l, qnode* n, u8 cmd, alloc_tag tag, u16 qidx, unsigned sev
+  )
+{
+  n->qidx  = qidx;
+  n->info.cmd = cmd;
+  n->info.tag = tag;
+  n->info.has_timestamp = l->producer.timestamp;
+  n->info.priority      = sev >= l->producer.priority_sev;
+  bl_mpsc_i_node_set (&n->hook, nullptr, 0, 0);
+}
+/*----------------------------------------------------------------------------*/
+/* "timestamp_delta": allocates the entry on the thread's TLS buffer with its
+timestamp relative to the previous one of the thread. On failure "se" keeps
+the full timestamp. */
+static inline bool malc_alloc_ts_delta(
+  malc*       l,
+  serializer* se,
+  u8**        mem,
+  alloc_tag*  tag,
+  u16*        qidx,
+  u32*        slots,
+  size_t      payload_size
+  )
+{
+  ts_delta_producer* p = tls_buffer_ts_delta();
+  if (!p) {
+    return false;
+  }
+  bl_timept64 t = serializer_get_timestamp (se);
+  u64         v;
+  uword format  = ts_delta_producer_format (p, t, &v);
+  serializer_set_timestamp (se, v, ts_delta_format_bytes (format));
+  size_t size = sizeof (qnode) + serializer_log_entry_size (se, payload_size);
+  bl_err err  = memory_tls_alloc_entry(
+    &l->mem, mem, tag, slots, size, qnode_max_slots
+    );
+  if (err.own) {
+    serializer_set_timestamp (se, t, 8);
+    return false;
+  }
+  ts_delta_producer_commit (p, t, format);
+  *qidx = ts_delta_qidx (format, p->stream);
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+/* slow path, entries too big for "qnode.slots". "size" includes a "qnode". */
+static bl_err malc_log_entry_prepare_large(
+  malc*                   l,
+  malc_serializer*        ext_ser,
+  serializer*             se,
+  malc_const_entry const* entry,
+  size_t                  size
+  )
+{
+  alloc_tag tag;
+  u8*       mem   = nullptr;
+  u32       slots = 0;
+  u16       qidx;
+
+  size += sizeof (qnode_large) - sizeof (qnode);
+  bl_err err = memory_alloc(
+    &l->mem, &mem, &tag, &qidx, &slots, size, qnode_large_max_slots
+    );
+  if (bl_unlikely (err.own == bl_alloc)) {
+    err = malc_alloc_backpressure(
+      l, &mem, &tag, &qidx, &slots, size, qnode_large_max_slots, entry->info[0]
+      );
+  }
+  if (bl_unlikely (err.own)) {
+    malc_count_drop (l, err, size);
+    return err;
+  }
+  qnode_large* n = (qnode_large*) mem;
+  n->slots   = slots;
+  n->n.slots = 0;
+  malc_entry_node_init (l, &n->n, q_cmd_large_entry, tag, qidx, entry->info[0]);
+  *ext_ser = serializer_prepare_external_serializer (se, mem, mem + sizeof *n);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
 MALC_EXPORT bl_err malc_log_entry_prepare(
   malc*                   l,
   malc_serializer*        ext_ser,
@@ -627,29 +1748,57 @@ MALC_EXPORT bl_err malc_log_entry_prepare(
     entry->info
     );
 #endif
+  serializer se;
   uword state = bl_atomic_uword_load_rlx (&l->state);
   if (bl_unlikely (state != st_running)) {
+    /* cold path, the serializer is only set up to size the dropped entry */
+    serializer_init (&se, entry, l->producer.timestamp);
+    malc_count_drop(
+      l,
+      bl_mkerr (bl_preconditions),
+      sizeof (qnode) + serializer_log_entry_size (&se, payload_size)
+      );
     return bl_mkerr (bl_preconditions);
   }
-  serializer se;
-  serializer_init (&se, entry, l->producer.timestamp);
+  if (l->tsc) {
+    serializer_init_timestamp (&se, entry, tsc_get());
+  }
+  else {
+    serializer_init (&se, entry, l->producer.timestamp);
+  }
   size_t size  =
     sizeof (qnode) + serializer_log_entry_size (&se, payload_size);
   alloc_tag tag;
   u8* mem = nullptr;
-  /*entries are limited at 8KB*/
-  u32 max_n_slots = (1 << (bl_sizeof_member (qnode, slots) * 8));
+  /*entries are limited at 256 slots (e.g. 16KB with 64 byte slots) */
+  u32 max_n_slots = qnode_max_slots;
   u32 slots = 0;
-  bl_err err = memory_alloc (&l->mem, &mem, &tag, &slots, size, max_n_slots);
+  u16 qidx;
+  bl_err err;
+  if (l->ts_delta
+    && entry->info[0] < l->producer.priority_sev
+    && malc_alloc_ts_delta (l, &se, &mem, &tag, &qidx, &slots, payload_size)
+    ) {
+    err = bl_mkok();
+  }
+  else {
+    err = memory_alloc (&l->mem, &mem, &tag, &qidx, &slots, size, max_n_slots);
+    if (bl_unlikely (err.own == bl_alloc)) {
+      err = malc_alloc_backpressure(
+        l, &mem, &tag, &qidx, &slots, size, max_n_slots, entry->info[0]
+        );
+    }
+  }
   if (bl_unlikely (err.own)) {
+    if (err.own == bl_range && size > max_n_slots * l->mem.cfg.slot_size) {
+      return malc_log_entry_prepare_large (l, ext_ser, &se, entry, size);
+    }
+    malc_count_drop (l, err, size);
     return err;
   }
   qnode* n = (qnode*) mem;
   n->slots = slots - 1;
-  n->info.cmd = q_cmd_entry;
-  n->info.tag = tag;
-  n->info.has_timestamp = l->producer.timestamp;
-  bl_mpsc_i_node_set (&n->hook, nullptr, 0, 0);
+  malc_entry_node_init (l, n, q_cmd_entry, tag, qidx, entry->info[0]);
   *ext_ser = serializer_prepare_external_serializer (&se, mem, mem + sizeof *n);
   return bl_mkok();
 }
@@ -658,7 +1807,14 @@ MALC_EXPORT void malc_log_entry_commit(
   malc* l, malc_serializer const* ext_ser
   )
 {
-  bl_mpsc_i_produce_notag (&l->q, &((qnode*) ext_ser->node_mem)->hook);
+  qnode* n = (qnode*) ext_ser->node_mem;
+  if (bl_unlikely (n->info.priority)) {
+    bl_mpsc_i_produce_notag (&l->qprio, &n->hook);
+  }
+  else if (!alloc_tag_is_tls (n->info.tag) || !tls_buffer_lane_push (n)) {
+    bl_mpsc_i_produce_notag (&l->q, &n->hook);
+  }
+  waiter_wake (&l->waiter);
 }
 /*----------------------------------------------------------------------------*/
 #ifdef __cplusplus
@@ -20,28 +20,179 @@ bl_err memory_init (memory* m, bl_alloc_tbl const* alloc)
   if (err.own) {
     return err;
   }
-  m->cfg.msg_allocator             = alloc;
+  err = bl_mutex_init (&m->seg_mutex);
+  if (err.own) {
+    bl_tss_destroy (m->tss_key);
+    return err;
+  }
+  err = heap_pool_init (&m->heap_pool, alloc, MALC_HEAP_POOL_DEFAULT_BYTES);
+  if (err.own) {
+    bl_mutex_destroy (&m->seg_mutex);
+    bl_tss_destroy (m->tss_key);
+    return err;
+  }
+  m->cfg.msg_allocator             = &m->heap_pool.tbl;
+  m->cfg.heap_pool_max_bytes       = MALC_HEAP_POOL_DEFAULT_BYTES;
   m->cfg.slot_size                 = 64;
   m->cfg.fixed_allocator_bytes     = 0;
   m->cfg.fixed_allocator_max_slots = 0;
   m->cfg.fixed_allocator_per_cpu   = 0;
+  memset(
+    m->cfg.fixed_allocator_class_bytes,
+    0,
+    sizeof m->cfg.fixed_allocator_class_bytes
+    );
+  m->cfg.tls_segment_bytes         = 0;
+  m->cfg.tls_max_segments          = 8;
+  m->cfg.tls_max_total_segments    = 256;
+  m->cfg.buffers_huge_pages        = false;
+  m->cfg.buffers_numa_local        = false;
+  m->cfg.buffers_prefault          = false;
+  m->cfg.buffers_lock              = false;
+  m->alloc                         = alloc;
+  m->seg_pool                      = nullptr;
+  m->seg_total                     = 0;
+  m->seg_alloc                     = alloc;
+  ts_delta_ids_init (&m->ts_ids);
+  page_alloc_init (&m->tls_pages, false, false);
+  page_alloc_init (&m->bb_pages, false, false);
+  prefault_alloc_init (&m->tls_prefault);
+  prefault_alloc_init (&m->bb_prefault);
+  prefault_alloc_set_cfg (&m->tls_prefault, alloc, false);
+  prefault_alloc_set_cfg (&m->bb_prefault, alloc, false);
   boundedb_init (&m->bb);
   mem_array_init_empty (&m->tss_list);
+  mem_array_init_empty (&m->lanes_busy);
+  m->lanes_busy_count = 0;
   tls_buffer_thread_local_set (nullptr); /* for smoke testing mostly */
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
+static void memory_tls_segment_pool_destroy (memory* m)
+{
+  while (m->seg_pool) {
+    tls_segment* s = m->seg_pool;
+    m->seg_pool    = s->next;
+    bl_dealloc (m->seg_alloc, s);
+  }
+  m->seg_total = 0;
+}
+/*----------------------------------------------------------------------------*/
 void memory_destroy (memory* m, bl_alloc_tbl const* alloc)
 {
+  memory_tls_segment_pool_destroy (m);
+  bl_mutex_destroy (&m->seg_mutex);
   bl_tss_destroy (m->tss_key);
   boundedb_destroy (&m->bb, alloc);
   mem_array_destroy (&m->tss_list, alloc);
+  mem_array_destroy (&m->lanes_busy, alloc);
+  heap_pool_destroy (&m->heap_pool);
+}
+/*----------------------------------------------------------------------------*/
+static inline bool memory_is_page_backed (memory const* m)
+{
+  return m->cfg.buffers_huge_pages || m->cfg.buffers_numa_local;
+}
+/*----------------------------------------------------------------------------*/
+static inline bool memory_is_prefaulted (memory const* m)
+{
+  return m->cfg.buffers_prefault || m->cfg.buffers_lock;
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_alloc_tbl const* memory_tls_alloc(
+  memory* m, bl_alloc_tbl const* alloc
+  )
+{
+  if (memory_is_prefaulted (m)) {
+    return &m->tls_prefault.tbl; /* wraps one of the allocators below */
+  }
+  return memory_is_page_backed (m) ? &m->tls_pages.tbl : alloc;
+}
+/*----------------------------------------------------------------------------*/
+void memory_set_cfg (memory* m, malc_alloc_cfg const* cfg)
+{
+  /* the pooled segments may have a different size or allocator */
+  memory_tls_segment_pool_destroy (m);
+  m->cfg = *cfg;
+  m->cfg.buffers_huge_pages = !!m->cfg.buffers_huge_pages;
+  m->cfg.buffers_numa_local = !!m->cfg.buffers_numa_local;
+  page_alloc_init(
+    &m->tls_pages, m->cfg.buffers_huge_pages, m->cfg.buffers_numa_local
+    );
+  page_alloc_init(
+    &m->bb_pages, m->cfg.buffers_huge_pages, m->cfg.buffers_numa_local
+    );
+  m->cfg.buffers_prefault   = !!m->cfg.buffers_prefault;
+  m->cfg.buffers_lock       = !!m->cfg.buffers_lock;
+  bool page_backed = memory_is_page_backed (m);
+  prefault_alloc_set_cfg(
+    &m->tls_prefault,
+    page_backed ? &m->tls_pages.tbl : m->alloc,
+    m->cfg.buffers_lock
+    );
+  prefault_alloc_set_cfg(
+    &m->bb_prefault,
+    page_backed ? &m->bb_pages.tbl : m->alloc,
+    m->cfg.buffers_lock
+    );
+  heap_pool_set_max_bytes (&m->heap_pool, m->cfg.heap_pool_max_bytes);
+  /* the segments are taken by the thread that grows, so they are local too */
+  m->seg_alloc = memory_tls_alloc (m, m->alloc);
+}
+/*----------------------------------------------------------------------------*/
+static inline u32 memory_tls_segment_slots (memory const* m)
+{
+  return bl_div_ceil (m->cfg.tls_segment_bytes, m->cfg.slot_size);
+}
+/*----------------------------------------------------------------------------*/
+/* producer side, slow path */
+static tls_segment* memory_tls_segment_get (void* context)
+{
+  memory*      m = (memory*) context;
+  tls_segment* s = nullptr;
+  if (bl_unlikely (bl_mutex_lock (&m->seg_mutex).own)) {
+    return nullptr;
+  }
+  if (m->seg_pool) {
+    s           = m->seg_pool;
+    m->seg_pool = s->next;
+    tls_segment_reset (s);
+  }
+  else if (m->seg_total < m->cfg.tls_max_total_segments) {
+    s = tls_segment_create(
+      m->cfg.slot_size, memory_tls_segment_slots (m), m->seg_alloc
+      );
+    m->seg_total += s ? 1 : 0;
+  }
+  bl_mutex_unlock (&m->seg_mutex);
+  return s;
+}
+/*----------------------------------------------------------------------------*/
+void memory_tls_segment_release (memory* m, tls_segment* s)
+{
+  bl_err err = bl_mutex_lock (&m->seg_mutex);
+  bl_assert (!err.own);
+  (void) err;
+  s->next     = m->seg_pool;
+  m->seg_pool = s;
+  bl_mutex_unlock (&m->seg_mutex);
+}
+/*----------------------------------------------------------------------------*/
+static void memory_tls_release_segments (memory* m, tls_buffer* t)
+{
+  for (uword i = 0; i < t->seg_count; ++i) {
+    memory_tls_segment_release (m, t->segs[i]);
+  }
+  t->seg_count = 0;
 }
 /*----------------------------------------------------------------------------*/
 bl_err memory_tls_init_unregistered(
   memory*             m,
   size_t              bytes,
   bl_alloc_tbl const* alloc,
+  bool                spsc_lane,
+  bool                free_index,
+  tls_segment_retire  segment_retire,
   tls_destructor      destructor_fn,
   void*               destructor_context,
   void**              tls_buffer_addr
@@ -51,12 +202,29 @@ bl_err memory_tls_init_unregistered(
     return bl_mkerr (bl_locked);
   }
   tls_buffer* t;
+  alloc        = memory_tls_alloc (m, alloc);
   size_t slots = bl_div_ceil (bytes, (u32) m->cfg.slot_size);
   if (slots != ((u32) slots)) {
     return bl_mkerr (bl_would_overflow);
   }
+  tls_growth growth;
+  growth.seg_slots      = memory_tls_segment_slots (m);
+  growth.seg_max        = m->cfg.tls_max_segments;
+  growth.get            = &memory_tls_segment_get;
+  growth.get_context    = (void*) m;
+  growth.retire         = segment_retire;
+  growth.retire_context = destructor_context;
+  bool grows = growth.seg_slots != 0 && growth.seg_max != 0;
   bl_err err = tls_buffer_init(
-    &t, m->cfg.slot_size, (u32) slots, alloc, destructor_fn, destructor_context
+    &t,
+    m->cfg.slot_size,
+    (u32) slots,
+    alloc,
+    spsc_lane,
+    free_index,
+    grows ? &growth : nullptr,
+    destructor_fn,
+    destructor_context
     );
   if (err.own) {
     return err;
@@ -66,6 +234,7 @@ bl_err memory_tls_init_unregistered(
     bl_dealloc (alloc, t);
     return err;
   }
+  ts_delta_producer_init (&t->ts, ts_delta_ids_acquire (&m->ts_ids));
   *tls_buffer_addr = (void*) t;
   tls_buffer_thread_local_set ((void*) t);
   return bl_mkok();
@@ -73,13 +242,46 @@ bl_err memory_tls_init_unregistered(
 /*----------------------------------------------------------------------------*/
 bl_err memory_bounded_buffer_init (memory* m, bl_alloc_tbl const* alloc)
 {
+  malc_alloc_cfg const* c = &m->cfg;
+  boundedb_class classes[malc_fixed_class_count];
+  uword          class_count = 0;
+  u32            class_bytes = 0;
+
+  for (uword i = 0; i < malc_fixed_class_count; ++i) {
+    class_bytes |= c->fixed_allocator_class_bytes[i];
+  }
+  if (class_bytes == 0) {
+    /* a single queue for all the entry sizes */
+    classes[0].bytes     = c->fixed_allocator_bytes;
+    classes[0].min_slots = 1;
+    classes[0].max_slots = c->fixed_allocator_max_slots;
+    class_count          = 1;
+  }
+  else {
+    static const u32 class_max[malc_fixed_class_count] = { 1, 4, (u32) -1 };
+    u32 min_slots = 1;
+    for (uword i = 0; i < malc_fixed_class_count; ++i) {
+      u32 max_slots = bl_min (class_max[i], c->fixed_allocator_max_slots);
+      if (c->fixed_allocator_class_bytes[i] != 0 && min_slots > max_slots) {
+        /* the class can't hold any entry under "fixed_allocator_max_slots" */
+        return bl_mkerr (bl_invalid);
+      }
+      classes[i].bytes     = c->fixed_allocator_class_bytes[i];
+      classes[i].min_slots = min_slots;
+      classes[i].max_slots = max_slots;
+      min_slots            = class_max[i] + 1;
+    }
+    class_count = malc_fixed_class_count;
+  }
   return boundedb_reset(
     &m->bb,
     alloc,
-    m->cfg.fixed_allocator_bytes,
-    m->cfg.slot_size,
-    m->cfg.fixed_allocator_max_slots,
-    m->cfg.fixed_allocator_per_cpu
+    memory_is_page_backed (m) ? &m->bb_pages : nullptr,
+    memory_is_prefaulted (m) ? &m->bb_prefault : nullptr,
+    classes,
+    class_count,
+    c->slot_size,
+    c->fixed_allocator_per_cpu
     );
 }
 /*----------------------------------------------------------------------------*/
@@ -91,7 +293,12 @@ bl_err memory_tls_register (memory* m, void* mem, bl_alloc_tbl const* alloc)
       return bl_mkok();
     }
   }
-  bl_err err = mem_array_grow (&m->tss_list, 1, alloc);
+  /* the busy list never has to grow when adding a lane */
+  bl_err err = mem_array_grow (&m->lanes_busy, 1, alloc);
+  if (err.own) {
+    return err;
+  }
+  err = mem_array_grow (&m->tss_list, 1, alloc);
   if (err.own) {
     return err;
   }
@@ -99,11 +306,30 @@ bl_err memory_tls_register (memory* m, void* mem, bl_alloc_tbl const* alloc)
   return err;
 }
 /*----------------------------------------------------------------------------*/
-bool memory_tls_destroy (memory* m, void* mem, bl_alloc_tbl const* alloc)
+static void memory_tls_lane_unbusy (memory* m, uword idx)
 {
+  bl_assert (idx < m->lanes_busy_count);
+  void** busy = mem_array_at (&m->lanes_busy, idx);
+  ((tls_buffer*) *busy)->lane.busy = false;
+  --m->lanes_busy_count;
+  *busy = *mem_array_at (&m->lanes_busy, m->lanes_busy_count);
+}
+/*----------------------------------------------------------------------------*/
+bool memory_tls_destroy (memory* m, void* mem)
+{
+  if (((tls_buffer*) mem)->lane.busy) {
+    for (uword i = 0; i < m->lanes_busy_count; ++i) {
+      if (*mem_array_at (&m->lanes_busy, i) == mem) {
+        memory_tls_lane_unbusy (m, i);
+        break;
+      }
+    }
+  }
   bl_dynarray_foreach (mem_array, void*, &m->tss_list, it) {
     if (*it == mem) {
-      bl_dealloc (alloc, mem);
+      memory_tls_release_segments (m, (tls_buffer*) mem);
+      ts_delta_ids_release (&m->ts_ids, ((tls_buffer*) mem)->ts.stream);
+      bl_dealloc (((tls_buffer*) mem)->alloc, mem);
       *it = nullptr;
       return true;
     }
@@ -111,11 +337,14 @@ bool memory_tls_destroy (memory* m, void* mem, bl_alloc_tbl const* alloc)
   return false;
 }
 /*----------------------------------------------------------------------------*/
-void memory_tls_destroy_all (memory* m, bl_alloc_tbl const* alloc)
+void memory_tls_destroy_all (memory* m)
 {
+  m->lanes_busy_count = 0;
   bl_dynarray_foreach (mem_array, void*, &m->tss_list, it) {
     if (*it != nullptr) {
-      bl_dealloc (alloc, *it);
+      memory_tls_release_segments (m, (tls_buffer*) *it);
+      ts_delta_ids_release (&m->ts_ids, ((tls_buffer*) *it)->ts.stream);
+      bl_dealloc (((tls_buffer*) *it)->alloc, *it);
       *it = nullptr;
     }
   }
@@ -127,22 +356,110 @@ extern bl_err memory_tls_try_run_destructor (memory* m)
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
-bl_err memory_alloc(
-  memory* m, u8** mem, alloc_tag* tag, u32* slots, u32 n_bytes, u32 max_n_slots
+uword memory_tls_lane_count (memory const* m)
+{
+  return mem_array_size (&m->tss_list);
+}
+/*----------------------------------------------------------------------------*/
+u8* memory_tls_lane_pop (memory* m, uword idx)
+{
+  bl_assert (idx < mem_array_size (&m->tss_list));
+  tls_buffer* t = (tls_buffer*) *mem_array_at (&m->tss_list, idx);
+  if (!t || !tls_buffer_has_lane (t)) {
+    return nullptr;
+  }
+  return (u8*) tls_buffer_lane_pop (t);
+}
+/*----------------------------------------------------------------------------*/
+u8* memory_tls_busy_lane_pop (memory* m, uword idx)
+{
+  bl_assert (idx < m->lanes_busy_count);
+  tls_buffer* t = (tls_buffer*) *mem_array_at (&m->lanes_busy, idx);
+  u8* node      = (u8*) tls_buffer_lane_pop (t);
+  if (!node) {
+    memory_tls_lane_unbusy (m, idx);
+  }
+  return node;
+}
+/*----------------------------------------------------------------------------*/
+uword memory_tls_lanes_rescan (memory* m)
+{
+  uword added = 0;
+  bl_dynarray_foreach (mem_array, void*, &m->tss_list, it) {
+    tls_buffer* t = (tls_buffer*) *it;
+    if (!t || !tls_buffer_has_lane (t) || t->lane.busy) {
+      continue;
+    }
+    if (!tls_buffer_lane_is_empty (t)) {
+      t->lane.busy = true;
+      *mem_array_at (&m->lanes_busy, m->lanes_busy_count) = t;
+      ++m->lanes_busy_count;
+      ++added;
+    }
+  }
+  return added;
+}
+/*----------------------------------------------------------------------------*/
+void memory_tls_drops_sum (memory const* m, drop_totals* t)
+{
+  for (uword i = 0; i < mem_array_size (&m->tss_list); ++i) {
+    tls_buffer const* b =
+      (tls_buffer const*) *mem_array_at ((mem_array*) &m->tss_list, i);
+    if (b) {
+      drop_counters_sum (&b->drops, t);
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+bl_err memory_tls_alloc_entry(
+  memory*    m,
+  u8**       mem,
+  alloc_tag* tag,
+  u32*       slots,
+  u32        n_bytes,
+  u32        max_n_slots
   )
 {
   bl_assert (m && mem && tag && slots);
+  if (bl_div_ceil (n_bytes, m->cfg.slot_size) > max_n_slots) {
+    return bl_mkerr (bl_range);
+  }
+  bool free_index;
+  bl_err err = tls_buffer_alloc_entry(
+    mem, slots, n_bytes, max_n_slots, &free_index
+    );
+  *tag = free_index ? alloc_tag_tls_idx : alloc_tag_tls;
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+bl_err memory_alloc(
+  memory*    m,
+  u8**       mem,
+  alloc_tag* tag,
+  u16*       qidx,
+  u32*       slots,
+  u32        n_bytes,
+  u32        max_n_slots
+  )
+{
+  bl_assert (m && mem && tag && qidx && slots);
+  *qidx = 0;
   *slots = bl_div_ceil (n_bytes, m->cfg.slot_size);
   if (*slots > max_n_slots) {
     return bl_mkerr (bl_range);
   }
-  bl_err err = tls_buffer_alloc (mem, *slots);
+  u32  tls_slots;
+  bool free_index;
+  bl_err err = tls_buffer_alloc_entry(
+    mem, &tls_slots, n_bytes, max_n_slots, &free_index
+    );
   if (bl_likely (!err.own)) {
-    *tag = alloc_tag_tls;
+    *slots = tls_slots;
+    *tag   = free_index ? alloc_tag_tls_idx : alloc_tag_tls;
     return bl_mkok();
   }
-  if (m->cfg.fixed_allocator_bytes > 0) {
-    err = boundedb_alloc (&m->bb, mem, slots, n_bytes, max_n_slots);
+  if (boundedb_is_enabled (&m->bb)) {
+    err = boundedb_alloc (&m->bb, mem, qidx, slots, n_bytes, max_n_slots);
     *tag = alloc_tag_bounded;
     if (bl_likely (!err.own)) {
       return bl_mkok();
@@ -153,21 +470,45 @@ bl_err memory_alloc(
     if (*slots > max_n_slots) {
       return bl_mkerr (bl_range);
     }
-    *mem = (u8*) bl_alloc (m->cfg.msg_allocator, *slots * m->cfg.slot_size);
-    *tag = alloc_tag_heap;
+    /* exact size, see "memory_entry_end" */
+    *mem  = (u8*) bl_alloc (m->cfg.msg_allocator, n_bytes);
+    *tag  = alloc_tag_heap;
+    *qidx = (u16) ((*slots * m->cfg.slot_size) - n_bytes);
     return bl_mkerr (*mem ? bl_ok : bl_alloc);
   }
   return err;
 }
 /*----------------------------------------------------------------------------*/
-void memory_dealloc (memory* m, u8* mem, alloc_tag tag, u32 slots)
+void memory_prefault_stats (memory const* m, uword* faults, uword* locked_bytes)
+{
+  *faults = bl_atomic_uword_load_rlx(
+      (bl_atomic_uword*) &m->tls_prefault.faults
+      )
+    + bl_atomic_uword_load_rlx ((bl_atomic_uword*) &m->bb_prefault.faults);
+  *locked_bytes = bl_atomic_uword_load_rlx(
+      (bl_atomic_uword*) &m->tls_prefault.locked_bytes
+      )
+    + bl_atomic_uword_load_rlx(
+      (bl_atomic_uword*) &m->bb_prefault.locked_bytes
+      );
+}
+/*----------------------------------------------------------------------------*/
+uword memory_heap_pool_bytes (memory const* m)
+{
+  return heap_pool_bytes (&m->heap_pool);
+}
+/*----------------------------------------------------------------------------*/
+void memory_dealloc (memory* m, u8* mem, alloc_tag tag, u16 qidx, u32 slots)
 {
   switch (tag) {
   case alloc_tag_tls:
     tls_buffer_dealloc (mem, slots, m->cfg.slot_size);
     break;
+  case alloc_tag_tls_idx:
+    tls_buffer_dealloc_indexed (mem, slots, m->cfg.slot_size);
+    break;
   case alloc_tag_bounded:
-    boundedb_dealloc (&m->bb, mem, slots);
+    boundedb_dealloc (&m->bb, mem, qidx, slots);
     break;
   case alloc_tag_heap:
     bl_dealloc (m->cfg.msg_allocator, mem);
@@ -10,6 +10,10 @@
 #include <malc/common.h>
 #include <malc/tls_buffer.h>
 #include <malc/bounded_buffer.h>
+#include <malc/page_allocator.h>
+#include <malc/prefault_allocator.h>
+#include <malc/heap_pool.h>
+#include <malc/timestamp_delta.h>
 
 /*----------------------------------------------------------------------------*/
 enum alloc_tags {
@@ -17,19 +21,45 @@ enum alloc_tags {
   alloc_tag_tls     = 1,
   alloc_tag_bounded = 2,
   alloc_tag_heap    = 3,
-  alloc_tag_total   = 4,
+  alloc_tag_tls_idx = 4, /* TLS buffer using the "free_index" protocol */
+  alloc_tag_total   = 5,
 };
 typedef u8 alloc_tag;
 #define alloc_tag_bits (bl_static_log2_ceil_u (alloc_tag_total))
 #define alloc_tag_mask (bl_u_lsb_set (alloc_tag_bits))
 /*----------------------------------------------------------------------------*/
+static inline bool alloc_tag_is_tls (alloc_tag t)
+{
+  return t == alloc_tag_tls || t == alloc_tag_tls_idx;
+}
+/*----------------------------------------------------------------------------*/
 bl_define_dynarray_types (mem_array, void*)
 /*----------------------------------------------------------------------------*/
 typedef struct memory {
-  malc_alloc_cfg cfg;
-  bl_tss         tss_key;
-  mem_array      tss_list;
-  boundedb       bb;
+  malc_alloc_cfg      cfg;
+  bl_tss              tss_key;
+  mem_array           tss_list;
+  /* consumer side: the "lanes_busy_count" first entries are the buffers whose
+  lane had nodes when last seen. Sized as "tss_list". */
+  mem_array           lanes_busy;
+  uword               lanes_busy_count;
+  boundedb            bb;
+  bl_alloc_tbl const* alloc;
+  /* "buffers_huge_pages" and "buffers_numa_local" backing */
+  page_alloc          tls_pages;
+  page_alloc          bb_pages;
+  /* "buffers_prefault" and "buffers_lock", wrapping the allocators above */
+  prefault_alloc      tls_prefault;
+  prefault_alloc      bb_prefault;
+  /* default "msg_allocator" */
+  heap_pool           heap_pool;
+  /* TLS segment pool, accessed from both the producers and the consumer */
+  bl_mutex            seg_mutex;
+  tls_segment*        seg_pool;
+  uword               seg_total;
+  bl_alloc_tbl const* seg_alloc;
+  /* stream ids of the TLS buffers, see "timestamp_delta.h" */
+  ts_delta_ids        ts_ids;
 }
 memory;
 /*----------------------------------------------------------------------------*/
@@ -37,32 +67,112 @@ extern bl_err memory_init (memory* m, bl_alloc_tbl const* alloc);
 /*----------------------------------------------------------------------------*/
 extern void memory_destroy (memory* m, bl_alloc_tbl const* alloc);
 /*----------------------------------------------------------------------------*/
+/* to be called before initializing the bounded buffer. The TLS buffers already
+   created keep their configuration. */
+extern void memory_set_cfg (memory* m, malc_alloc_cfg const* cfg);
+/*----------------------------------------------------------------------------*/
 extern bl_err memory_tls_init_unregistered(
   memory*             m,
   size_t              bytes,
   bl_alloc_tbl const* alloc,
+  bool                spsc_lane,
+  bool                free_index,
+  tls_segment_retire  segment_retire, /* see "tls_growth" */
   tls_destructor      thread_exit_destructor,
-  void*               thread_exit_destructor_context,
+  void*               thread_exit_destructor_context, /* also for "retire" */
   void**              tls_buffer_addr
   );
 /*----------------------------------------------------------------------------*/
 extern bl_err memory_bounded_buffer_init (memory* m, bl_alloc_tbl const* alloc);
 /*----------------------------------------------------------------------------*/
+/* "memory_alloc" restricted to the calling thread's TLS buffer */
+extern bl_err memory_tls_alloc_entry(
+  memory*    m,
+  u8**       mem,
+  alloc_tag* tag,
+  u32*       slots,
+  u32        n_bytes,
+  u32        max_n_slots
+  );
+/*----------------------------------------------------------------------------*/
+/* "qidx" depends on "tag":
+  - "alloc_tag_bounded": the bounded queue index (see "boundedb_alloc").
+  - "alloc_tag_heap": the bytes missing to fill the last slot (see
+    "memory_entry_end").
+  - TLS tags: 0. The caller may use it to place the "timestamp_delta" stream
+    and format (see "ts_delta_qidx"), 0 is an entry not on a stream. */
 extern bl_err memory_alloc(
-  memory* m, u8** mem, alloc_tag* tag, u32* slots, u32 n_bytes, u32 max_n_slots
+  memory*    m,
+  u8**       mem,
+  alloc_tag* tag,
+  u16*       qidx,
+  u32*       slots,
+  u32        n_bytes,
+  u32        max_n_slots
   );
 /*----------------------------------------------------------------------------*/
-extern void memory_dealloc (memory* m, u8* mem, alloc_tag tag, u32 slots);
+/* end of the data of an entry from "memory_alloc". The heap allocations have
+the exact size requested, the rest are whole slots. */
+static inline u8* memory_entry_end(
+  memory const* m, u8* mem, alloc_tag tag, u16 qidx, u32 slots
+  )
+{
+  u8* end = mem + (slots * m->cfg.slot_size);
+  return bl_likely (tag != alloc_tag_heap) ? end : end - qidx;
+}
+/*----------------------------------------------------------------------------*/
+extern void memory_dealloc(
+  memory* m, u8* mem, alloc_tag tag, u16 qidx, u32 slots
+  );
 /*----------------------------------------------------------------------------*/
 extern bl_err memory_tls_register(
   memory* m, void* mem, bl_alloc_tbl const* alloc
   );
 /*----------------------------------------------------------------------------*/
-extern bool memory_tls_destroy (memory* m, void* mem, bl_alloc_tbl const* alloc);
+extern bool memory_tls_destroy (memory* m, void* mem);
 /*----------------------------------------------------------------------------*/
-extern void memory_tls_destroy_all (memory* m, bl_alloc_tbl const* alloc);
+extern void memory_tls_destroy_all (memory* m);
 /*----------------------------------------------------------------------------*/
 extern bl_err memory_tls_try_run_destructor (memory* m);
 /*----------------------------------------------------------------------------*/
+/* number of TLS SPSC lanes, some of them might be unregistered (empty) */
+extern uword memory_tls_lane_count (memory const* m);
+/*----------------------------------------------------------------------------*/
+/* pops a node from the SPSC lane of the TLS buffer with index "idx". Returns
+   null if the lane is empty or if there is no registered buffer on "idx". */
+extern u8* memory_tls_lane_pop (memory* m, uword idx);
+/*----------------------------------------------------------------------------*/
+/* The busy list allows polling only the lanes that are in use. A lane is added
+   by "memory_tls_lanes_rescan" and removed when found empty by
+   "memory_tls_busy_lane_pop". */
+static inline uword memory_tls_lanes_busy (memory const* m)
+{
+  return m->lanes_busy_count;
+}
+/*----------------------------------------------------------------------------*/
+/* pops a node from the lane with index "idx" on the busy list. If the lane is
+   empty it is removed from the list, its index is taken by the last busy lane
+   and null is returned. */
+extern u8* memory_tls_busy_lane_pop (memory* m, uword idx);
+/*----------------------------------------------------------------------------*/
+/* adds the lanes with nodes to the busy list. O(lanes). Returns the number of
+   lanes added. */
+extern uword memory_tls_lanes_rescan (memory* m);
+/*----------------------------------------------------------------------------*/
+/* returns a retired TLS segment to the pool. All its entries have to be
+   already consumed. */
+extern void memory_tls_segment_release (memory* m, tls_segment* s);
+/*----------------------------------------------------------------------------*/
+/* page faults taken when pre-faulting the buffers and bytes currently locked */
+extern void memory_prefault_stats(
+  memory const* m, uword* faults, uword* locked_bytes
+  );
+/*----------------------------------------------------------------------------*/
+/* bytes taken by the blocks of the default "msg_allocator" */
+extern uword memory_heap_pool_bytes (memory const* m);
+/*----------------------------------------------------------------------------*/
+/* adds the drop counters of all the registered TLS buffers to "t" */
+extern void memory_tls_drops_sum (memory const* m, drop_totals* t);
+/*----------------------------------------------------------------------------*/
 
 #endif // __MALC_ALLOCATOR__
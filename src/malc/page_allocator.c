@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include <bl/base/assert.h>
+#include <bl/base/utility.h>
+#include <bl/base/to_type_containing.h>
+
+#include <malc/page_allocator.h>
+
+#if MALC_HAS_PAGE_ALLOCATOR
+  #include <stdio.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <linux/mempolicy.h>
+#endif
+
+#define page_alloc_header_bytes   64 /* keeps the cache line alignment */
+#define page_alloc_huge_page_size (2 * 1024 * 1024)
+#define page_alloc_max_nodes      64
+#define page_alloc_mask_bits      (sizeof (unsigned long) * 8)
+
+/*----------------------------------------------------------------------------*/
+#if MALC_HAS_PAGE_ALLOCATOR
+/*----------------------------------------------------------------------------*/
+static void page_alloc_bind (page_alloc const* p, void* mem, size_t size)
+{
+  int node = p->node;
+  if (node == page_alloc_node_local) {
+    unsigned cpu, n;
+    if (syscall (SYS_getcpu, &cpu, &n, nullptr) != 0) {
+      return;
+    }
+    node = (int) n;
+  }
+  if (node < 0 || node >= page_alloc_max_nodes) {
+    return;
+  }
+  unsigned long mask[page_alloc_max_nodes / page_alloc_mask_bits];
+  memset (mask, 0, sizeof mask);
+  mask[node / page_alloc_mask_bits] |= 1ul << (node % page_alloc_mask_bits);
+  /* "preferred" instead of "bind": a full node is not worth an OOM kill. The
+  kernel reads "maxnode - 1" bits. Failing is harmless, so it's ignored. */
+  (void) syscall(
+    SYS_mbind, mem, size, MPOL_PREFERRED, mask, page_alloc_max_nodes + 1, 0
+    );
+}
+/*----------------------------------------------------------------------------*/
+static void* page_alloc_alloc (size_t bytes, bl_alloc_tbl const* invoker)
+{
+  page_alloc* p    = bl_to_type_containing (invoker, tbl, page_alloc);
+  size_t      size = bytes + page_alloc_header_bytes;
+  bool        huge = p->huge_pages && size >= page_alloc_huge_page_size;
+  void*       mem  = MAP_FAILED;
+  int         prot = PROT_READ | PROT_WRITE;
+  int         flag = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  if (huge) {
+    size = bl_round_to_next_multiple (size, page_alloc_huge_page_size);
+    mem  = mmap (nullptr, size, prot, flag | MAP_HUGETLB, -1, 0);
+  }
+  if (mem == MAP_FAILED) {
+    size = bl_round_to_next_multiple (size, (size_t) sysconf (_SC_PAGESIZE));
+    mem  = mmap (nullptr, size, prot, flag, -1, 0);
+    if (mem == MAP_FAILED) {
+      return nullptr;
+    }
+    if (huge) {
+      (void) madvise (mem, size, MADV_HUGEPAGE);
+    }
+  }
+  /* before the first touch (the header write) */
+  if (p->numa) {
+    page_alloc_bind (p, mem, size);
+  }
+  *((size_t*) mem) = size;
+  return ((u8*) mem) + page_alloc_header_bytes;
+}
+/*----------------------------------------------------------------------------*/
+static void page_alloc_dealloc (void const* mem, bl_alloc_tbl const* invoker)
+{
+  (void) invoker;
+  if (!mem) {
+    return;
+  }
+  u8* map = ((u8*) mem) - page_alloc_header_bytes;
+  (void) munmap (map, *((size_t*) map));
+}
+/*----------------------------------------------------------------------------*/
+static void* page_alloc_realloc(
+  void* mem, size_t new_size, bl_alloc_tbl const* invoker
+  )
+{
+  if (!mem) {
+    return page_alloc_alloc (new_size, invoker);
+  }
+  size_t old_size = *((size_t*) (((u8*) mem) - page_alloc_header_bytes));
+  old_size       -= page_alloc_header_bytes;
+  void* new_mem   = page_alloc_alloc (new_size, invoker);
+  if (new_mem) {
+    memcpy (new_mem, mem, bl_min (old_size, new_size));
+    page_alloc_dealloc (mem, invoker);
+  }
+  return new_mem;
+}
+/*----------------------------------------------------------------------------*/
+int page_alloc_cpu_node (uword cpu)
+{
+  char path[64];
+  for (int node = 0; node < page_alloc_max_nodes; ++node) {
+    (void) snprintf(
+      path,
+      sizeof path,
+      "/sys/devices/system/cpu/cpu%u/node%d",
+      (unsigned) cpu,
+      node
+      );
+    if (access (path, F_OK) == 0) {
+      return node;
+    }
+  }
+  return page_alloc_node_any;
+}
+/*----------------------------------------------------------------------------*/
+#else /* MALC_HAS_PAGE_ALLOCATOR */
+/*----------------------------------------------------------------------------*/
+static void* page_alloc_alloc (size_t bytes, bl_alloc_tbl const* invoker)
+{
+  (void) bytes;
+  (void) invoker;
+  return nullptr;
+}
+/*----------------------------------------------------------------------------*/
+static void* page_alloc_realloc(
+  void* mem, size_t new_size, bl_alloc_tbl const* invoker
+  )
+{
+  (void) mem;
+  (void) new_size;
+  (void) invoker;
+  return nullptr;
+}
+/*----------------------------------------------------------------------------*/
+static void page_alloc_dealloc (void const* mem, bl_alloc_tbl const* invoker)
+{
+  (void) invoker;
+  bl_assert (!mem && "page allocator unavailable on this platform");
+}
+/*----------------------------------------------------------------------------*/
+int page_alloc_cpu_node (uword cpu)
+{
+  (void) cpu;
+  return page_alloc_node_any;
+}
+/*----------------------------------------------------------------------------*/
+#endif /* MALC_HAS_PAGE_ALLOCATOR */
+/*----------------------------------------------------------------------------*/
+void page_alloc_init (page_alloc* p, bool huge_pages, bool numa)
+{
+  p->tbl.alloc   = page_alloc_alloc;
+  p->tbl.realloc = page_alloc_realloc;
+  p->tbl.dealloc = page_alloc_dealloc;
+  p->huge_pages  = huge_pages;
+  p->numa        = numa;
+  p->node        = page_alloc_node_local;
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,49 @@
+#ifndef __MALC_PAGE_ALLOCATOR_H__
+#define __MALC_PAGE_ALLOCATOR_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/allocator.h>
+
+/* An allocator table backed by anonymous "mmap" mappings, used for the big and
+long lived buffers that the producers write on (the TLS buffers and the
+bounded queues).
+
+- huge_pages: allocations of at least one huge page are placed on huge pages
+  ("MAP_HUGETLB"). If none are reserved the mapping falls back to normal pages
+  with a transparent huge page hint ("MADV_HUGEPAGE").
+
+- numa: the mapping memory policy prefers the NUMA node on "node" (it is set
+  before the memory is touched).
+
+Each allocation has a small header in front to store the mapping size, so the
+sizes are rounded up after adding it.
+
+Only available on Linux, on the other platforms the allocation always fails. */
+
+#if defined (BL_LINUX)
+  #define MALC_HAS_PAGE_ALLOCATOR 1
+#else
+  #define MALC_HAS_PAGE_ALLOCATOR 0
+#endif
+/*----------------------------------------------------------------------------*/
+enum page_alloc_nodes {
+  page_alloc_node_local = -1, /* the node of the CPU running the caller */
+  page_alloc_node_any   = -2, /* no NUMA policy */
+};
+/*----------------------------------------------------------------------------*/
+typedef struct page_alloc {
+  bl_alloc_tbl tbl; /* has to be the first member */
+  bool         huge_pages;
+  bool         numa;
+  int          node; /* can be changed between allocations */
+}
+page_alloc;
+/*----------------------------------------------------------------------------*/
+extern void page_alloc_init (page_alloc* p, bool huge_pages, bool numa);
+/*----------------------------------------------------------------------------*/
+/* NUMA node of "cpu", "page_alloc_node_any" if unknown */
+extern int page_alloc_cpu_node (uword cpu);
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_PAGE_ALLOCATOR_H__ */
@@ -0,0 +1,183 @@
+#if defined (__linux__) && !defined (_GNU_SOURCE)
+  #define _GNU_SOURCE /* RUSAGE_THREAD */
+#endif
+
+#include <string.h>
+
+#include <bl/base/assert.h>
+#include <bl/base/utility.h>
+#include <bl/base/to_type_containing.h>
+
+#include <malc/prefault_allocator.h>
+
+#if MALC_HAS_MLOCK
+  #include <unistd.h>
+  #include <sys/mman.h>
+#endif
+#if defined (BL_LINUX)
+  #include <sys/resource.h>
+#endif
+
+#define prefault_header_bytes 64 /* keeps the parent alignment */
+
+/*----------------------------------------------------------------------------*/
+typedef struct prefault_header {
+  size_t              size;
+  bl_alloc_tbl const* parent;
+  bool                locked;
+}
+prefault_header;
+/*----------------------------------------------------------------------------*/
+bl_static_assert_ns (sizeof (prefault_header) <= prefault_header_bytes);
+/*----------------------------------------------------------------------------*/
+static uword prefault_page_size (void)
+{
+#if MALC_HAS_MLOCK
+  long size = sysconf (_SC_PAGESIZE);
+  return size > 0 ? (uword) size : 4096;
+#else
+  return 4096;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+static uword prefault_thread_faults (void)
+{
+#if defined (BL_LINUX) && defined (RUSAGE_THREAD)
+  struct rusage ru;
+  if (getrusage (RUSAGE_THREAD, &ru) == 0) {
+    return (uword) (ru.ru_minflt + ru.ru_majflt);
+  }
+#endif
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+/* returns the page faults taken */
+static uword prefault_touch (u8* mem, size_t size)
+{
+  uword page   = prefault_page_size();
+  uword faults = prefault_thread_faults();
+  uword pages  = 0;
+  uword end    = (uword) (mem + size);
+  uword addr   = (uword) mem;
+  for (; addr < end; addr = (addr & ~(page - 1)) + page) {
+    /* a write, reading only maps the shared zero page */
+    volatile u8* v = (volatile u8*) addr;
+    *v = *v;
+    ++pages;
+  }
+#if defined (BL_LINUX) && defined (RUSAGE_THREAD)
+  (void) pages;
+  return prefault_thread_faults() - faults;
+#else
+  (void) faults;
+  return pages;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+/* only the pages fully inside the allocation are locked, as the locks don't
+nest and the partial ones might be shared with other allocations */
+static bool prefault_lock_range (u8* mem, size_t size, u8** beg, size_t* len)
+{
+  uword page  = prefault_page_size();
+  uword first = bl_round_to_next_multiple ((uword) mem, page);
+  uword last  = ((uword) (mem + size)) & ~(page - 1);
+  if (first >= last) {
+    return false;
+  }
+  *beg = (u8*) first;
+  *len = (size_t) (last - first);
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static void* prefault_alloc_alloc (size_t bytes, bl_alloc_tbl const* invoker)
+{
+  prefault_alloc* p    = bl_to_type_containing (invoker, tbl, prefault_alloc);
+  size_t          size = bytes + prefault_header_bytes;
+  u8*             mem  = (u8*) bl_alloc (p->parent, size);
+  if (!mem) {
+    return nullptr;
+  }
+  prefault_header* h = (prefault_header*) mem;
+  h->size   = size;
+  h->parent = p->parent;
+  h->locked = false;
+  uword faults = prefault_touch (mem, size);
+  bl_atomic_uword_fetch_add_rlx (&p->faults, faults);
+#if MALC_HAS_MLOCK
+  u8*    lbeg;
+  size_t llen;
+  if (p->lock
+    && prefault_lock_range (mem, size, &lbeg, &llen)
+    && mlock (lbeg, llen) == 0
+    ) {
+    h->locked = true;
+    bl_atomic_uword_fetch_add_rlx (&p->locked_bytes, llen);
+  }
+#endif
+  return mem + prefault_header_bytes;
+}
+/*----------------------------------------------------------------------------*/
+static inline prefault_header* prefault_get_header (void const* mem)
+{
+  return (prefault_header*) (((u8*) mem) - prefault_header_bytes);
+}
+/*----------------------------------------------------------------------------*/
+static void prefault_alloc_dealloc(
+  void const* mem, bl_alloc_tbl const* invoker
+  )
+{
+  if (!mem) {
+    return;
+  }
+  prefault_alloc*  p = bl_to_type_containing (invoker, tbl, prefault_alloc);
+  prefault_header* h = prefault_get_header (mem);
+#if MALC_HAS_MLOCK
+  u8*    lbeg;
+  size_t llen;
+  if (h->locked && prefault_lock_range ((u8*) h, h->size, &lbeg, &llen)) {
+    /* the parent might not return the memory to the OS */
+    (void) munlock (lbeg, llen);
+    bl_atomic_uword_fetch_sub_rlx (&p->locked_bytes, llen);
+  }
+#else
+  (void) p;
+#endif
+  bl_dealloc (h->parent, h);
+}
+/*----------------------------------------------------------------------------*/
+static void* prefault_alloc_realloc(
+  void* mem, size_t new_size, bl_alloc_tbl const* invoker
+  )
+{
+  if (!mem) {
+    return prefault_alloc_alloc (new_size, invoker);
+  }
+  prefault_header* h = prefault_get_header (mem);
+  size_t old_size    = h->size - prefault_header_bytes;
+  void* new_mem      = prefault_alloc_alloc (new_size, invoker);
+  if (new_mem) {
+    memcpy (new_mem, mem, bl_min (old_size, new_size));
+    prefault_alloc_dealloc (mem, invoker);
+  }
+  return new_mem;
+}
+/*----------------------------------------------------------------------------*/
+void prefault_alloc_init (prefault_alloc* p)
+{
+  p->tbl.alloc   = prefault_alloc_alloc;
+  p->tbl.realloc = prefault_alloc_realloc;
+  p->tbl.dealloc = prefault_alloc_dealloc;
+  p->parent      = nullptr;
+  p->lock        = false;
+  bl_atomic_uword_store_rlx (&p->faults, 0);
+  bl_atomic_uword_store_rlx (&p->locked_bytes, 0);
+}
+/*----------------------------------------------------------------------------*/
+void prefault_alloc_set_cfg(
+  prefault_alloc* p, bl_alloc_tbl const* parent, bool lock
+  )
+{
+  p->parent = parent;
+  p->lock   = lock;
+}
+/*----------------------------------------------------------------------------*/
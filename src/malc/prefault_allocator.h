@@ -0,0 +1,47 @@
+#ifndef __MALC_PREFAULT_ALLOCATOR_H__
+#define __MALC_PREFAULT_ALLOCATOR_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/allocator.h>
+#include <bl/base/atomic.h>
+
+/* An allocator table wrapping another one ("parent") that touches every page
+of each allocation before returning it, so the page faults are taken when the
+buffers are created instead of on the first log calls writing on them.
+
+- lock: the pages are also locked in RAM ("mlock"), so they can't be swapped
+  out. Failing to lock (e.g. because of "RLIMIT_MEMLOCK") is not an error, the
+  locked bytes are counted to make it visible.
+
+Each allocation has a small header in front to store its size and its parent,
+so the parent can be changed between allocations.
+
+The page faults taken while touching are measured on Linux. On the other
+platforms the touched pages are counted instead. "mlock" is only available on
+POSIX. */
+
+#if defined (BL_POSIX)
+  #define MALC_HAS_MLOCK 1
+#else
+  #define MALC_HAS_MLOCK 0
+#endif
+/*----------------------------------------------------------------------------*/
+typedef struct prefault_alloc {
+  bl_alloc_tbl        tbl; /* has to be the first member */
+  bl_alloc_tbl const* parent;
+  bool                lock;
+  bl_atomic_uword     faults;       /* taken on the allocations */
+  bl_atomic_uword     locked_bytes; /* currently locked */
+}
+prefault_alloc;
+/*----------------------------------------------------------------------------*/
+extern void prefault_alloc_init (prefault_alloc* p);
+/*----------------------------------------------------------------------------*/
+/* to be called before allocating. The counters are kept. */
+extern void prefault_alloc_set_cfg(
+  prefault_alloc* p, bl_alloc_tbl const* parent, bool lock
+  );
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_PREFAULT_ALLOCATOR_H__ */
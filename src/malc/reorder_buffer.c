@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include <bl/base/assert.h>
+#include <bl/base/utility.h>
+
+#include <malc/reorder_buffer.h>
+
+/*----------------------------------------------------------------------------*/
+void reorder_buffer_init (reorder_buffer* rb)
+{
+  memset (rb, 0, sizeof *rb);
+}
+/*----------------------------------------------------------------------------*/
+bl_err reorder_buffer_reset(
+  reorder_buffer*     rb,
+  uword               capacity,
+  u64                 window_ns,
+  bl_alloc_tbl const* alloc
+  )
+{
+  bl_assert (rb && alloc);
+  reorder_buffer_destroy (rb, alloc);
+  if (capacity == 0) {
+    return bl_mkok();
+  }
+  rb->heap = (reorder_node*) bl_alloc (alloc, capacity * sizeof *rb->heap);
+  if (!rb->heap) {
+    return bl_mkerr (bl_alloc);
+  }
+  rb->capacity  = capacity;
+  rb->window_ns = window_ns;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+void reorder_buffer_destroy (reorder_buffer* rb, bl_alloc_tbl const* alloc)
+{
+  bl_assert (rb->size == 0);
+  if (rb->heap) {
+    bl_dealloc (alloc, rb->heap);
+  }
+  reorder_buffer_init (rb);
+}
+/*----------------------------------------------------------------------------*/
+static inline bool reorder_node_less(
+  reorder_node const* a, reorder_node const* b
+  )
+{
+  return a->nsec < b->nsec || (a->nsec == b->nsec && a->seq < b->seq);
+}
+/*----------------------------------------------------------------------------*/
+bool reorder_buffer_push (reorder_buffer* rb, u64 nsec, void* node)
+{
+  bl_assert (reorder_buffer_is_enabled (rb) && rb->size < rb->capacity);
+  if (bl_unlikely (nsec < rb->last_ns)) {
+    return false;
+  }
+  rb->newest_ns = bl_max (rb->newest_ns, nsec);
+  reorder_node v;
+  v.nsec = nsec;
+  v.seq  = rb->seq++;
+  v.node = node;
+  /* sift up */
+  uword i = rb->size++;
+  while (i > 0) {
+    uword parent = (i - 1) / 2;
+    if (!reorder_node_less (&v, &rb->heap[parent])) {
+      break;
+    }
+    rb->heap[i] = rb->heap[parent];
+    i = parent;
+  }
+  rb->heap[i] = v;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+void* reorder_buffer_pop (reorder_buffer* rb)
+{
+  if (rb->size == 0) {
+    return nullptr;
+  }
+  reorder_node top = rb->heap[0];
+  reorder_node v   = rb->heap[--rb->size];
+  /* sift down */
+  uword i = 0;
+  while (1) {
+    uword child = (i * 2) + 1;
+    if (child >= rb->size) {
+      break;
+    }
+    if (child + 1 < rb->size &&
+      reorder_node_less (&rb->heap[child + 1], &rb->heap[child])
+      ) {
+      ++child;
+    }
+    if (!reorder_node_less (&rb->heap[child], &v)) {
+      break;
+    }
+    rb->heap[i] = rb->heap[child];
+    i = child;
+  }
+  if (rb->size != 0) {
+    rb->heap[i] = v;
+  }
+  rb->last_ns = top.nsec;
+  return top.node;
+}
+/*----------------------------------------------------------------------------*/
+void* reorder_buffer_pop_ready (reorder_buffer* rb, u64 now_ns)
+{
+  if (rb->size == 0) {
+    return nullptr;
+  }
+  if (rb->size < rb->capacity) {
+    u64 ref = bl_max (rb->newest_ns, now_ns);
+    if (rb->heap[0].nsec + rb->window_ns > ref) {
+      return nullptr;
+    }
+  }
+  return reorder_buffer_pop (rb);
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,76 @@
+#ifndef __MALC_REORDER_BUFFER_H__
+#define __MALC_REORDER_BUFFER_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/allocator.h>
+#include <bl/base/error.h>
+
+/* A bounded min-heap of queue nodes keyed on their (producer) timestamps, used
+to merge the entries coming from different sources (e.g. TLS SPSC lanes) in
+timestamp order.
+
+A node is released when it is older than the newest seen timestamp (or the
+current time) minus the reorder window, or when the heap is full. Nodes with
+the same timestamp are released in insertion order.
+
+Nodes older than the last released one can't be ordered anymore, they are
+rejected by "reorder_buffer_push" and have to be written right away. */
+
+/*----------------------------------------------------------------------------*/
+typedef struct reorder_node {
+  u64   nsec;
+  u64   seq;
+  void* node;
+}
+reorder_node;
+/*----------------------------------------------------------------------------*/
+typedef struct reorder_buffer {
+  reorder_node* heap;
+  uword         size;
+  uword         capacity;
+  u64           seq;
+  u64           window_ns;
+  u64           newest_ns;
+  u64           last_ns;
+}
+reorder_buffer;
+/*----------------------------------------------------------------------------*/
+extern void reorder_buffer_init (reorder_buffer* rb);
+/*----------------------------------------------------------------------------*/
+/* capacity 0 disables the buffer */
+extern bl_err reorder_buffer_reset(
+  reorder_buffer*     rb,
+  uword               capacity,
+  u64                 window_ns,
+  bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+extern void reorder_buffer_destroy(
+  reorder_buffer* rb, bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+/* returns false when the node is too late to be ordered. Requires the buffer
+to be non-full (see "reorder_buffer_pop_ready") */
+extern bool reorder_buffer_push (reorder_buffer* rb, u64 nsec, void* node);
+/*----------------------------------------------------------------------------*/
+/* pops the oldest node if the buffer is full or if it is out of the reorder
+window with respect to both the newest seen timestamp and "now_ns" (0 to
+ignore). Returns null otherwise. */
+extern void* reorder_buffer_pop_ready (reorder_buffer* rb, u64 now_ns);
+/*----------------------------------------------------------------------------*/
+/* pops the oldest node unconditionally. Returns null when empty. */
+extern void* reorder_buffer_pop (reorder_buffer* rb);
+/*----------------------------------------------------------------------------*/
+static inline bool reorder_buffer_is_enabled (reorder_buffer const* rb)
+{
+  return rb->capacity != 0;
+}
+/*----------------------------------------------------------------------------*/
+static inline uword reorder_buffer_size (reorder_buffer const* rb)
+{
+  return rb->size;
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_REORDER_BUFFER_H__ */
@@ -0,0 +1,48 @@
+#ifndef __MALC_RSEQ_CPU_H__
+#define __MALC_RSEQ_CPU_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+
+/* Current CPU number read from the restartable sequences ("rseq") area that
+glibc (2.35 or newer) registers for each thread. The kernel updates it on
+every migration, so it is always current and reading it is a plain load.
+
+"rseq_cpu_get" returns a negative value when the area is unavailable (older
+glibc, registration disabled by the "glibc.pthread.rseq" tunable or failed), the
+callers are to fall back to "bl_get_cpu" then.
+
+Only available on Linux with glibc. */
+
+#if defined (BL_LINUX) && defined (__GLIBC__) && defined (__has_include)
+  #if __has_include (<sys/rseq.h>)
+    #include <sys/rseq.h>
+    #if defined (RSEQ_SIG) && defined (__has_builtin)
+      #if __has_builtin (__builtin_thread_pointer)
+        #define MALC_HAS_RSEQ_CPU 1
+      #endif
+    #endif
+  #endif
+#endif
+
+#ifndef MALC_HAS_RSEQ_CPU
+  #define MALC_HAS_RSEQ_CPU 0
+#endif
+/*----------------------------------------------------------------------------*/
+static inline int rseq_cpu_get (void)
+{
+#if MALC_HAS_RSEQ_CPU
+  if (__rseq_size == 0) {
+    return -1;
+  }
+  struct rseq const volatile* rs = (struct rseq const volatile*)
+    (((char*) __builtin_thread_pointer()) + __rseq_offset);
+  /* negative while unregistered (RSEQ_CPU_ID_REGISTRATION_FAILED) */
+  return (int) rs->cpu_id;
+#else
+  return -1;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_RSEQ_CPU_H__ */
@@ -10,6 +10,13 @@
 #include <malc/malc.h>
 #include <malc/serialization.h>
 #include <malc/impl/serialization.h>
+#include <malc/group_varint.h>
+
+#if MALC_BUILTIN_COMPRESSION && MALC_BUILTIN_COMPRESSION_GROUP_VARINT
+  #define GROUP_VARINT 1
+#else
+  #define GROUP_VARINT 0
+#endif
 
 #ifndef __cplusplus
   #define DECODE_NAME_BUILD(suffix) bl_pp_tokconcat(decode, suffix)
@@ -20,7 +27,7 @@
 bl_declare_autoarray_funcs (log_args, log_argument);
 bl_declare_autoarray_funcs (log_refs, malc_ref);
 /*----------------------------------------------------------------------------*/
-#if MALC_BUILTIN_COMPRESSION
+#if MALC_BUILTIN_COMPRESSION && !GROUP_VARINT
 static bl_err decode_compressed_32(
   compressed_header* ch, u8** mem, u8* mem_end, u32* v
   )
@@ -60,6 +67,37 @@ static bl_err decode_compressed_64(
   ++ch->idx;
   return bl_mkok();
 }
+/*----------------------------------------------------------------------------*/
+#elif GROUP_VARINT
+/*----------------------------------------------------------------------------*/
+/* the sign is restored by the caller, see "gvarint_unzigzag32" */
+static bl_err decode_compressed_32(
+  compressed_header* ch, u8** mem, u8* mem_end, u32* v
+  )
+{
+  bl_uword size = gvarint_size32 (gvarint_code (ch->hdr, ch->idx));
+  if (bl_unlikely (*mem + size > mem_end)) {
+    return bl_mkerr (bl_invalid);
+  }
+  *v    = (u32) gvarint_load (*mem, mem_end, size);
+  *mem += size;
+  ++ch->idx;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+static bl_err decode_compressed_64(
+  compressed_header* ch, u8** mem, u8* mem_end, u64* v
+  )
+{
+  bl_uword size = gvarint_size64 (gvarint_code (ch->hdr, ch->idx));
+  if (bl_unlikely (*mem + size > mem_end)) {
+    return bl_mkerr (bl_invalid);
+  }
+  *v    = gvarint_load (*mem, mem_end, size);
+  *mem += size;
+  ++ch->idx;
+  return bl_mkok();
+}
 #endif /* #if MALC_BUILTIN_COMPRESSION */
 /*----------------------------------------------------------------------------*/
 static inline bl_err DECODE_NAME_BUILD(_8) (
@@ -313,42 +351,86 @@ static inline bl_err DECODE_NAME_BUILD(_obj_flag)(
 /*----------------------------------------------------------------------------*/
 #if MALC_BUILTIN_COMPRESSION == 0
 /*----------------------------------------------------------------------------*/
-void serializer_init(
-  serializer* se, malc_const_entry const* entry, bool has_tstamp
+static inline void serializer_init_impl(
+  serializer* se, malc_const_entry const* entry, bool has_tstamp, u64 t
   )
 {
   se->entry      = entry;
+  se->entry_id   = callsite_get_id (entry);
   se->has_tstamp = has_tstamp;
   se->ch         = nullptr;
+  se->t          = t;
+  se->t_bytes    = sizeof se->t;
   se->internal_fields_size =
-    MALC_PTR_BYTE_COUNT + (has_tstamp ? sizeof se->t : 0);
-  if (has_tstamp) {
-    se->t = bl_fast_timept_get_fast();
-  }
+    serialized_entry_size (se->entry_id) + (has_tstamp ? sizeof se->t : 0);
+}
+/*----------------------------------------------------------------------------*/
+void serializer_set_timestamp (serializer* se, u64 v, uword bytes)
+{
+  bl_assert (se->has_tstamp);
+  bl_assert (bytes == 2 || bytes == 4 || bytes == 8);
+  se->t                    = v;
+  se->t_bytes              = bytes;
+  se->internal_fields_size = serialized_entry_size (se->entry_id) + bytes;
 }
 /*----------------------------------------------------------------------------*/
 #else /* MALC_BUILTIN_COMPRESSION == 0 */
 /*----------------------------------------------------------------------------*/
-void serializer_init(
-  serializer* se, malc_const_entry const* entry, bool has_tstamp
+static inline void serializer_init_impl(
+  serializer* se, malc_const_entry const* entry, bool has_tstamp, u64 t
   )
 {
   se->entry      = entry;
+  se->entry_id   = callsite_get_id (entry);
   se->has_tstamp = has_tstamp ? 1 : 0;
   se->chval.idx  = 0;
   se->chval.hdr  = nullptr;
   se->ch         = &se->chval;
-  if (has_tstamp) {
-    se->t = malc_get_compressed_u64 (bl_fast_timept_get_fast());
-  }
-  se->comp_hdr_size = bl_div_ceil (entry->compressed_count + se->has_tstamp, 2);
+  se->t          = malc_get_compressed_u64 (t);
+  se->comp_hdr_size =
+    compressed_header_size (entry->compressed_count, se->has_tstamp);
   se->internal_fields_size =
-    MALC_PTR_BYTE_COUNT +
+    serialized_entry_size (se->entry_id) +
     (has_tstamp ? malc_compressed_get_size (se->t.format_nibble) + 1 : 0);
 }
 /*----------------------------------------------------------------------------*/
+void serializer_set_timestamp (serializer* se, u64 v, uword bytes)
+{
+  (void) bytes;
+  bl_assert (se->has_tstamp);
+  se->t = malc_get_compressed_u64 (v);
+  se->internal_fields_size = serialized_entry_size (se->entry_id) +
+    malc_compressed_get_size (se->t.format_nibble) + 1;
+}
+/*----------------------------------------------------------------------------*/
 #endif /* MALC_BUILTIN_COMPRESSION == 0 */
 /*----------------------------------------------------------------------------*/
+void serializer_init(
+  serializer* se, malc_const_entry const* entry, bool has_tstamp
+  )
+{
+  serializer_init_impl(
+    se, entry, has_tstamp, has_tstamp ? bl_fast_timept_get_fast() : 0
+    );
+}
+/*----------------------------------------------------------------------------*/
+void serializer_init_timestamp(
+  serializer* se, malc_const_entry const* entry, bl_timept64 t
+  )
+{
+  serializer_init_impl (se, entry, true, t);
+}
+/*----------------------------------------------------------------------------*/
+static inline void serialize_entry (malc_serializer* s, serializer const* ser)
+{
+  u16 id = (u16) ser->entry_id;
+  memcpy (s->field_mem, &id, sizeof id);
+  s->field_mem += sizeof id;
+  if (bl_unlikely (id == callsite_no_id)) {
+    malc_serialize (s, (void*) ser->entry);
+  }
+}
+/*----------------------------------------------------------------------------*/
 /* write the header and return it ready to serialize write the varargs*/
 malc_serializer serializer_prepare_external_serializer(
   serializer* ser, u8* node_mem, u8* mem
@@ -358,19 +440,34 @@ malc_serializer serializer_prepare_external_serializer(
   s.node_mem = node_mem;
 #if MALC_BUILTIN_COMPRESSION == 0
   s.field_mem = mem;
-  malc_serialize (&s, (void*) ser->entry);
+  serialize_entry (&s, ser);
   if (ser->has_tstamp) {
-    malc_serialize (&s, ser->t);
+    switch (ser->t_bytes) {
+    case 2:
+      malc_serialize (&s, (u16) ser->t);
+      break;
+    case 4:
+      malc_serialize (&s, (u32) ser->t);
+      break;
+    default:
+      malc_serialize (&s, ser->t);
+      break;
+    }
   }
 #else /* #if MALC_BUILTIN_COMPRESSION == 0 */
   s.field_mem = mem;
-  malc_serialize (&s, (void*) ser->entry);
+  serialize_entry (&s, ser);
   s.compressed_header_idx = 0;
   s.compressed_header     = s.field_mem;
   memset (s.compressed_header, 0, ser->comp_hdr_size);
   s.field_mem += ser->comp_hdr_size;
   if (ser->has_tstamp) {
     malc_serialize (&s, ser->t);
+#if MALC_BUILTIN_COMPRESSION_GROUP_VARINT
+    /* the arguments start on the next header byte */
+    s.compressed_header    += 1;
+    s.compressed_header_idx = 0;
+#endif
   }
 #if 0 //old
   s.compressed_header     = mem;
@@ -395,6 +492,8 @@ malc_serializer serializer_prepare_external_serializer(
 bl_err deserializer_init (deserializer* ds, bl_alloc_tbl const* alloc)
 {
   memset (ds, 0, sizeof *ds);
+  decode_plans_init (&ds->plans);
+  ds->t_bytes = 8;
 #if MALC_BUILTIN_COMPRESSION == 0
   ds->ch = nullptr;
 #else
@@ -413,6 +512,7 @@ bl_err deserializer_init (deserializer* ds, bl_alloc_tbl const* alloc)
 /*----------------------------------------------------------------------------*/
 void deserializer_destroy (deserializer* ds, bl_alloc_tbl const* alloc)
 {
+  decode_plans_destroy (&ds->plans, alloc);
   log_args_destroy (&ds->args, alloc);
   log_refs_destroy (&ds->refs, alloc);
 }
@@ -422,49 +522,92 @@ void deserializer_reset (deserializer* ds)
   log_args_drop_tail_n (&ds->args, log_args_size (&ds->args));
   log_refs_drop_tail_n (&ds->refs, log_refs_size (&ds->refs));
   ds->entry           = nullptr;
+  ds->entry_id        = callsite_no_id;
+  ds->plan            = nullptr;
   ds->refdtor.func    = nullptr;
   ds->refdtor.context = nullptr;
+  ds->t_base          = nullptr;
+  ds->t_bytes         = 8;
 //#if MALC_BUILTIN_COMPRESSION
   //ds->ch = nullptr;
 //#endif
 }
 /*----------------------------------------------------------------------------*/
-bl_err deserializer_execute(
-  deserializer*       ds,
-  u8*                 mem,
-  u8*                 mem_end,
-  bool                has_timestamp,
-  bl_alloc_tbl const* alloc
+static inline void deserializer_apply_timestamp_base (deserializer* ds)
+{
+  if (!ds->t_base) {
+    return;
+  }
+  if (ds->t_bytes != 8) {
+    ds->t += *ds->t_base;
+  }
+  *ds->t_base = ds->t;
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_err deserializer_decode_entry(
+  deserializer* ds, u8** mem, u8* mem_end
   )
 {
-#if MALC_BUILTIN_COMPRESSION == 0
+  u16 id;
+  if (bl_unlikely (*mem + sizeof id > mem_end)) {
+    return bl_mkerr (bl_invalid);
+  }
+  memcpy (&id, *mem, sizeof id);
+  *mem        += sizeof id;
+  ds->entry_id = id;
+  if (bl_likely (id != callsite_no_id)) {
+    ds->entry = callsite_get_entry (id);
+    return bl_mkok();
+  }
   void* entry;
-  bl_err err = decode (ds->ch, &mem, mem_end, &entry);
+  bl_err err = DECODE_NAME_BUILD(_ptr) (ds->ch, mem, mem_end, &entry);
+  ds->entry  = (malc_const_entry const*) entry;
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+/* decodes the internal fields (entry and timestamp) */
+static bl_err deserializer_execute_header(
+  deserializer* ds, u8** mem_ptr, u8* mem_end, bool has_timestamp
+  )
+{
+  u8* mem = *mem_ptr;
+#if MALC_BUILTIN_COMPRESSION == 0
+  bl_err err = deserializer_decode_entry (ds, &mem, mem_end);
   if (bl_unlikely (err.own)) {
     return err;
   }
-  ds->entry = (malc_const_entry const*) entry;
   if (has_timestamp) {
     ds->t = 0;
-    err   = decode (ds->ch, &mem, mem_end, &ds->t);
+    if (bl_likely (ds->t_bytes == 8)) {
+      err = decode (ds->ch, &mem, mem_end, &ds->t);
+    }
+    else if (ds->t_bytes == 4) {
+      u32 d = 0;
+      err   = decode (ds->ch, &mem, mem_end, &d);
+      ds->t = d;
+    }
+    else {
+      u16 d = 0;
+      err   = decode (ds->ch, &mem, mem_end, &d);
+      ds->t = d;
+    }
     if (bl_unlikely (err.own)) {
       return err;
     }
+    deserializer_apply_timestamp_base (ds);
   }
   else {
     ds->t = bl_fast_timept_get_fast();
   }
 #else /* MALC_BUILTIN_COMPRESSION == 0 */
-  void* entry;
-  ds->entry   = nullptr;
-  bl_err err = DECODE_NAME_BUILD(_ptr) (ds->ch, &mem, mem_end, &entry);
+  ds->entry  = nullptr;
+  bl_err err = deserializer_decode_entry (ds, &mem, mem_end);
   if (bl_unlikely (err.own)) {
     return err;
   }
-  ds->entry   = (malc_const_entry const*) entry;
   ds->ch->hdr = mem;
   ds->ch->idx = 0;
-  mem += bl_div_ceil (ds->entry->compressed_count + !!has_timestamp, 2);
+  mem += compressed_header_size (ds->entry->compressed_count, has_timestamp);
   if (has_timestamp) {
     ds->t = 0;
     bl_static_assert_ns_funcscope (sizeof ds->t == (64 / 8));
@@ -472,6 +615,11 @@ bl_err deserializer_execute(
     if (bl_unlikely (err.own)) {
       return err;
     }
+    deserializer_apply_timestamp_base (ds);
+#if GROUP_VARINT
+    ++ds->ch->hdr;
+    ds->ch->idx = 0;
+#endif
   }
   else {
     ds->t = bl_fast_timept_get_fast();
@@ -507,11 +655,175 @@ bl_err deserializer_execute(
 #endif //OLD
 
 #endif /* MALC_BUILTIN_COMPRESSION == 0 */
-  ds->t = bl_fast_timept_to_nsec (ds->t);
+  ds->t    = bl_likely (!has_timestamp || !ds->tsc)
+    ? bl_fast_timept_to_nsec (ds->t) : tsc_calib_to_nsec (ds->tsc, ds->t);
+  *mem_ptr = mem;
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+bl_err deserializer_peek_timestamp(
+  deserializer* ds, u8* mem, u8* mem_end, bool has_timestamp, u64* nsec
+  )
+{
+  bl_timept64* t_base = ds->t_base;
+  bl_uword     t_bytes = ds->t_bytes;
+  deserializer_set_timestamp_base (ds, nullptr, 8);
+  bl_err err = deserializer_execute_header (ds, &mem, mem_end, has_timestamp);
+  deserializer_set_timestamp_base (ds, t_base, t_bytes);
+  *nsec = ds->t;
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+#if GROUP_VARINT
+/*----------------------------------------------------------------------------*/
+/* 4 32-bit integer arguments starting on a header byte boundary */
+static inline bool deserializer_is_group32 (deserializer* ds, char const* t)
+{
+  return (ds->ch->idx & 3) == 0
+    && (t[0] == malc_type_i32 || t[0] == malc_type_u32)
+    && (t[1] == malc_type_i32 || t[1] == malc_type_u32)
+    && (t[2] == malc_type_i32 || t[2] == malc_type_u32)
+    && (t[3] == malc_type_i32 || t[3] == malc_type_u32);
+}
+/*----------------------------------------------------------------------------*/
+/* "mem" has "gvarint_group_max_bytes" readable bytes */
+static bl_err deserializer_execute_group32(
+  deserializer* ds, u8** mem, char const* t, bl_alloc_tbl const* alloc
+  )
+{
+  u32 v[4];
+  *mem += gvarint_decode4_u32 (*mem, ds->ch->hdr[ds->ch->idx / 4], v);
+  ds->ch->idx += 4;
+  for (bl_uword i = 0; i < 4; ++i) {
+    log_argument larg;
+    larg.vu32 = t[i] == malc_type_i32 ? gvarint_unzigzag32 (v[i]) : v[i];
+    bl_err err = log_args_insert_tail (&ds->args, &larg, alloc);
+    if (bl_unlikely (err.own)) {
+      return err;
+    }
+  }
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+#endif /* GROUP_VARINT */
+/*----------------------------------------------------------------------------*/
+/* wire width of the arguments that have a fixed one, 0 for the others */
+static inline bl_uword decode_plan_arg_width (char type)
+{
+  switch (type) {
+  case malc_type_i8:
+  case malc_type_u8:
+    return 1;
+  case malc_type_i16:
+  case malc_type_u16:
+    return 2;
+  case malc_type_float:
+    return sizeof (float);
+  case malc_type_double:
+    return sizeof (double);
+#if MALC_BUILTIN_COMPRESSION == 0
+  case malc_type_i32:
+  case malc_type_u32:
+    return 4;
+  case malc_type_i64:
+  case malc_type_u64:
+    return 8;
+#endif
+#if MALC_PTR_MSB_BYTES_CUT_COUNT == 0
+  case malc_type_ptr:
+  case malc_type_lit:
+    return sizeof (void*);
+#endif
+  default:
+    return 0;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void decode_plan_build (decode_plan* p, char const* partype)
+{
+  bl_uword bytes = 0;
+  bl_uword i     = 0;
+  p->state = decode_plan_variable;
+  for (; partype[i]; ++i) {
+    bl_uword width = decode_plan_arg_width (partype[i]);
+    if (width == 0 || i == decode_plan_max_args) {
+      return;
+    }
+    p->offset[i] = (u16) bytes;
+    p->width[i]  = (u8) width;
+    bytes       += width;
+  }
+  p->count = (u8) i;
+  p->bytes = (u16) bytes;
+  p->state = decode_plan_fixed;
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_err deserializer_execute_plan(
+  deserializer* ds, decode_plan const* p, u8* mem, u8* mem_end
+  )
+{
+  if (bl_unlikely (mem + p->bytes > mem_end)) {
+    return bl_mkerr (bl_invalid);
+  }
+  for (bl_uword i = 0; i < p->count; ++i) {
+    log_argument* arg = &ds->plan_args[i];
+    u8 const*     src = mem + p->offset[i];
+    switch (p->width[i]) {
+    case 1:
+      arg->vu8 = *src;
+      break;
+    case 2:
+      memcpy (&arg->vu16, src, sizeof arg->vu16);
+      break;
+    case 4:
+      memcpy (&arg->vu32, src, sizeof arg->vu32);
+      break;
+    default:
+      memcpy (&arg->vu64, src, sizeof arg->vu64);
+      break;
+    }
+  }
+  ds->plan = p;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+bl_err deserializer_execute(
+  deserializer*       ds,
+  u8*                 mem,
+  u8*                 mem_end,
+  bool                has_timestamp,
+  bl_alloc_tbl const* alloc
+  )
+{
+  bl_err err = deserializer_execute_header (ds, &mem, mem_end, has_timestamp);
+  if (bl_unlikely (err.own)) {
+    return err;
+  }
   char const* partype = &ds->entry->info[1];
+  if (bl_likely (ds->entry_id != callsite_no_id)) {
+    decode_plan* p = decode_plans_get (&ds->plans, ds->entry_id, alloc);
+    if (bl_unlikely (p && p->state == decode_plan_unset)) {
+      decode_plan_build (p, partype);
+    }
+    if (bl_likely (p && p->state == decode_plan_fixed)) {
+      return deserializer_execute_plan (ds, p, mem, mem_end);
+    }
+  }
   log_argument larg;
 
   while (*partype) {
+#if GROUP_VARINT
+    if (deserializer_is_group32 (ds, partype)
+      && mem + gvarint_group_max_bytes <= mem_end
+      ) {
+      err = deserializer_execute_group32 (ds, &mem, partype, alloc);
+      if (bl_unlikely (err.own)) {
+        return err;
+      }
+      partype += 4;
+      continue;
+    }
+#endif
     bl_uword push_this_arg = true;
     switch (*partype) {
     case malc_type_i8:
@@ -525,6 +837,10 @@ bl_err deserializer_execute(
     case malc_type_i32:
     case malc_type_u32:
       err = decode (ds->ch, &mem, mem_end, &larg.vu32);
+#if GROUP_VARINT
+      larg.vu32 = *partype == malc_type_i32
+        ? gvarint_unzigzag32 (larg.vu32) : larg.vu32;
+#endif
       break;
     case malc_type_float:
       err = decode (ds->ch, &mem, mem_end, &larg.vfloat);
@@ -532,6 +848,10 @@ bl_err deserializer_execute(
     case malc_type_i64:
     case malc_type_u64:
       err = decode (ds->ch, &mem, mem_end, &larg.vu64);
+#if GROUP_VARINT
+      larg.vu64 = *partype == malc_type_i64
+        ? gvarint_unzigzag64 (larg.vu64) : larg.vu64;
+#endif
       break;
     case malc_type_double:
       err = decode (ds->ch, &mem, mem_end, &larg.vdouble);
@@ -589,10 +909,17 @@ log_entry deserializer_get_log_entry (deserializer const* ds)
 {
   log_entry le;
   le.entry      = ds->entry;
+  le.entry_id   = ds->entry_id;
   le.timestamp  = ds->t;
   le.refdtor    = ds->refdtor;
-  le.args       = log_args_beg (&ds->args);
-  le.args_count = log_args_size (&ds->args);
+  if (ds->plan) {
+    le.args       = ds->plan_args;
+    le.args_count = ds->plan->count;
+  }
+  else {
+    le.args       = log_args_beg (&ds->args);
+    le.args_count = log_args_size (&ds->args);
+  }
   le.refs       = log_refs_beg (&ds->refs);
   le.refs_count = log_refs_size (&ds->refs);
   return le;
@@ -10,6 +10,9 @@
 #include <malc/malc.h>
 #include <malc/log_entry.h>
 #include <malc/impl/serialization.h>
+#include <malc/tsc.h>
+#include <malc/callsite.h>
+#include <malc/decode_plan.h>
 
 /*----------------------------------------------------------------------------*/
 bl_define_autoarray_types (log_args, log_argument);
@@ -21,12 +24,35 @@ typedef struct compressed_header {
 }
 compressed_header;
 /*----------------------------------------------------------------------------*/
+/* bytes of the header of the compressed fields. On "group_varint" the
+timestamp has a byte on its own, so the arguments start on a byte boundary */
+static inline bl_uword compressed_header_size(
+  bl_uword compressed_count, bool has_tstamp
+  )
+{
+#if MALC_BUILTIN_COMPRESSION_GROUP_VARINT == 0
+  return bl_div_ceil (compressed_count + has_tstamp, 2);
+#else
+  return has_tstamp + bl_div_ceil (compressed_count, 4);
+#endif
+}
+/*----------------------------------------------------------------------------*/
+/* bytes taken by the entry reference: the callsite id, followed by the entry
+pointer when there is no id (see "callsite.h") */
+static inline bl_uword serialized_entry_size (bl_uword entry_id)
+{
+  return sizeof (bl_u16) +
+    (entry_id == callsite_no_id ? MALC_PTR_BYTE_COUNT : 0);
+}
+/*----------------------------------------------------------------------------*/
 #if MALC_BUILTIN_COMPRESSION == 0
 /*----------------------------------------------------------------------------*/
 typedef struct serializer {
   malc_const_entry const* entry;
+  bl_uword                entry_id;
   bool                    has_tstamp;
   bl_timept64             t;
+  bl_uword                t_bytes;
   bl_uword                internal_fields_size;
   compressed_header*      ch;
 }
@@ -36,6 +62,7 @@ serializer;
 /*----------------------------------------------------------------------------*/
 typedef struct serializer {
   malc_const_entry const* entry;
+  bl_uword                entry_id;
   bool                    has_tstamp;
   malc_compressed_64      t;
   bl_uword                internal_fields_size;
@@ -51,6 +78,28 @@ extern void serializer_init(
   serializer* se, malc_const_entry const* entry, bool has_tstamp
   );
 /*----------------------------------------------------------------------------*/
+/* "serializer_init" with a timestamp taken by the caller, e.g. a raw TSC
+value (see "tsc.h") */
+extern void serializer_init_timestamp(
+  serializer* se, malc_const_entry const* entry, bl_timept64 t
+  );
+/*----------------------------------------------------------------------------*/
+/* replaces the timestamp taken by "serializer_init" (requires "has_tstamp")
+by "v", e.g. a difference against a previous one (see "timestamp_delta.h").
+"bytes" (2, 4 or 8) is ignored with compressed builtins. */
+extern void serializer_set_timestamp(
+  serializer* se, bl_u64 v, bl_uword bytes
+  );
+/*----------------------------------------------------------------------------*/
+static inline bl_timept64 serializer_get_timestamp (serializer const* se)
+{
+#if MALC_BUILTIN_COMPRESSION == 0
+  return se->t;
+#else
+  return (bl_timept64) se->t.v;
+#endif
+}
+/*----------------------------------------------------------------------------*/
 extern malc_serializer serializer_prepare_external_serializer(
   serializer* ser, bl_u8* node_mem, bl_u8* mem
   );
@@ -71,11 +120,18 @@ typedef struct deserializer {
   log_refs                refs;
   malc_refdtor            refdtor;
   malc_const_entry const* entry;
+  bl_uword                entry_id; /* "callsite_no_id" if unregistered */
   bl_timept64             t;
   compressed_header*      ch;
 #if MALC_BUILTIN_COMPRESSION
   compressed_header       chval;
 #endif
+  bl_timept64*            t_base;  /* see "deserializer_set_timestamp_base" */
+  bl_uword                t_bytes;
+  tsc_calib const*        tsc;     /* see "deserializer_set_tsc" */
+  decode_plans            plans;
+  decode_plan const*      plan;    /* non null: the args are on "plan_args" */
+  log_argument            plan_args[decode_plan_max_args];
 }
 deserializer;
 /*----------------------------------------------------------------------------*/
@@ -85,6 +141,25 @@ extern void deserializer_destroy (deserializer* ds, bl_alloc_tbl const* alloc);
 /*----------------------------------------------------------------------------*/
 extern void deserializer_reset (deserializer* ds);
 /*----------------------------------------------------------------------------*/
+/* the serialized timestamps are raw TSC values to convert with "tsc". Null
+(default) for "bl_fast_timept" values. Kept by "deserializer_reset". */
+static inline void deserializer_set_tsc (deserializer* ds, tsc_calib const* tsc)
+{
+  ds->tsc = tsc;
+}
+/*----------------------------------------------------------------------------*/
+/* for the next "deserializer_execute" (until "deserializer_reset"): the
+timestamp is relative to "*t_base" unless "t_bytes" is 8, then "*t_base" is
+updated with the absolute value. Without compressed builtins "t_bytes" (2, 4
+or 8) is also the serialized size. */
+static inline void deserializer_set_timestamp_base(
+  deserializer* ds, bl_timept64* t_base, bl_uword t_bytes
+  )
+{
+  ds->t_base  = t_base;
+  ds->t_bytes = t_bytes;
+}
+/*----------------------------------------------------------------------------*/
 extern bl_err deserializer_execute(
   deserializer*       ds,
   bl_u8*              mem,
@@ -93,6 +168,16 @@ extern bl_err deserializer_execute(
   bl_alloc_tbl const* alloc
   );
 /*----------------------------------------------------------------------------*/
+/* decodes only the timestamp (in nanoseconds) of a serialized entry. Doesn't
+follow "deserializer_set_timestamp_base". */
+extern bl_err deserializer_peek_timestamp(
+  deserializer* ds,
+  bl_u8*        mem,
+  bl_u8*        mem_end,
+  bool          has_timestamp,
+  bl_u64*       nsec
+  );
+/*----------------------------------------------------------------------------*/
 extern log_entry deserializer_get_log_entry (deserializer const* ds);
 /*----------------------------------------------------------------------------*/
 #endif
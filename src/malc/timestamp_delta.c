@@ -0,0 +1,48 @@
+#include <bl/base/assert.h>
+
+#include <malc/timestamp_delta.h>
+
+#define uword_bits (sizeof (uword) * 8)
+
+/*----------------------------------------------------------------------------*/
+void ts_delta_ids_init (ts_delta_ids* ids)
+{
+  for (uword i = 0; i < ts_delta_id_words; ++i) {
+    bl_atomic_uword_store_rlx (&ids->used[i], 0);
+  }
+}
+/*----------------------------------------------------------------------------*/
+u16 ts_delta_ids_acquire (ts_delta_ids* ids)
+{
+  for (uword i = 0; i < ts_delta_id_words; ++i) {
+    uword used = bl_atomic_uword_load_rlx (&ids->used[i]);
+    while (~used) {
+      uword bit = 0;
+      while (used & bl_u_bit (bit)) {
+        ++bit;
+      }
+      if (bl_atomic_uword_weak_cas(
+        &ids->used[i], &used, used | bl_u_bit (bit), bl_mo_acquire,
+        bl_mo_relaxed
+        )) {
+        return (u16) ((i * uword_bits) + bit);
+      }
+    }
+  }
+  return ts_delta_no_stream;
+}
+/*----------------------------------------------------------------------------*/
+void ts_delta_ids_release (ts_delta_ids* ids, u16 id)
+{
+  if (id == ts_delta_no_stream) {
+    return;
+  }
+  bl_assert (id < ts_delta_max_streams);
+  bl_atomic_uword* w    = &ids->used[id / uword_bits];
+  uword            used = bl_atomic_uword_load_rlx (w);
+  while (!bl_atomic_uword_weak_cas(
+    w, &used, used & ~bl_u_bit (id % uword_bits), bl_mo_release,
+    bl_mo_relaxed
+    ));
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,138 @@
+#ifndef __MALC_TIMESTAMP_DELTA_H__
+#define __MALC_TIMESTAMP_DELTA_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/integer_manipulation.h>
+#include <bl/base/atomic.h>
+#include <bl/base/time.h>
+#include <bl/base/static_assert.h>
+
+/* Delta encoded producer timestamps ("malc_producer_cfg.timestamp_delta").
+
+Each TLS buffer gets a stream id. The entries allocated on it carry the
+difference against the timestamp of the previous entry of the same stream on
+16 or 32 bits (with compressed builtins the difference just compresses better)
+instead of the full 64-bit value. The stream id and the timestamp format go on
+the "qidx" field of the queue node, which is unused for TLS allocations. The
+consumer keeps the last timestamp of each stream to rebuild the absolute time.
+
+The first entry of a stream, the entries whose difference doesn't fit on 32
+bits (or is negative) and one every "ts_delta_keyframe_period" entries are
+keyframes with the full timestamp.
+
+Rebuilding requires decoding the entries of each stream in production order,
+so the mode is disabled with "tls_spsc_lanes" (a full lane falls back to the
+shared queue) and with the reorder buffer (it peeks the timestamps on arrival
+and decodes later). The priority entries (different queue) and the entries not
+allocated on the TLS buffer always have full timestamps and are not part of the
+stream. */
+
+/*----------------------------------------------------------------------------*/
+enum ts_delta_formats {
+  ts_delta_none = 0, /* full timestamp, not on a stream */
+  ts_delta_key  = 1, /* full timestamp, restarts the stream */
+  ts_delta_16   = 2,
+  ts_delta_32   = 3,
+};
+/*----------------------------------------------------------------------------*/
+#define ts_delta_stream_bits     14
+#define ts_delta_max_streams     4096 /* bounds the consumer table */
+#define ts_delta_no_stream       ((u16) -1)
+#define ts_delta_keyframe_period 1024
+/*----------------------------------------------------------------------------*/
+/* the stream and the format fit on the 16-bit "qidx". The consumer takes
+"qidx != 0" as an entry on a stream, the formats of those are never 0. */
+bl_static_assert_ns (ts_delta_max_streams <= bl_pow2_u (ts_delta_stream_bits));
+bl_static_assert_ns (ts_delta_32 < bl_pow2_u (16 - ts_delta_stream_bits));
+bl_static_assert_ns (ts_delta_key != ts_delta_none);
+bl_static_assert_ns (ts_delta_16 != ts_delta_none);
+bl_static_assert_ns (ts_delta_32 != ts_delta_none);
+/*----------------------------------------------------------------------------*/
+static inline u16 ts_delta_qidx (uword format, uword stream)
+{
+  return (u16) ((format << ts_delta_stream_bits) | stream);
+}
+/*----------------------------------------------------------------------------*/
+static inline uword ts_delta_qidx_format (u16 qidx)
+{
+  return qidx >> ts_delta_stream_bits;
+}
+/*----------------------------------------------------------------------------*/
+static inline uword ts_delta_qidx_stream (u16 qidx)
+{
+  return qidx & bl_u_lsb_set (ts_delta_stream_bits);
+}
+/*----------------------------------------------------------------------------*/
+/* serialized timestamp bytes of each format, without compressed builtins */
+static inline uword ts_delta_format_bytes (uword format)
+{
+  return format == ts_delta_16 ? 2 : (format == ts_delta_32 ? 4 : 8);
+}
+/*----------------------------------------------------------------------------*/
+/* producer side, on each TLS buffer. Only touched by the owner thread. */
+typedef struct ts_delta_producer {
+  bl_timept64 prev;
+  u16         stream;    /* "ts_delta_no_stream": ids exhausted */
+  u16         since_key;
+}
+ts_delta_producer;
+/*----------------------------------------------------------------------------*/
+static inline void ts_delta_producer_init (ts_delta_producer* p, u16 stream)
+{
+  p->prev      = 0;
+  p->stream    = stream;
+  p->since_key = ts_delta_keyframe_period; /* the first entry is a keyframe */
+}
+/*----------------------------------------------------------------------------*/
+/* returns the format for an entry at "t" and the value to serialize on "v".
+The state is only updated by "ts_delta_producer_commit", as the entry might
+end up not being allocated on the TLS buffer. */
+static inline uword ts_delta_producer_format(
+  ts_delta_producer const* p, bl_timept64 t, u64* v
+  )
+{
+  u64 d = (u64) (t - p->prev);
+  *v    = d;
+  if (t < p->prev || p->since_key >= ts_delta_keyframe_period) {
+    *v = (u64) t;
+    return ts_delta_key;
+  }
+  if (d <= 0xffff) {
+    return ts_delta_16;
+  }
+  if (d <= 0xffffffff) {
+    return ts_delta_32;
+  }
+  *v = (u64) t;
+  return ts_delta_key;
+}
+/*----------------------------------------------------------------------------*/
+static inline void ts_delta_producer_commit(
+  ts_delta_producer* p, bl_timept64 t, uword format
+  )
+{
+  p->prev      = t;
+  p->since_key = format == ts_delta_key ? 0 : p->since_key + 1;
+}
+/*----------------------------------------------------------------------------*/
+/* stream id allocation, shared by the producers (acquire, when creating the
+TLS buffers) and the consumer (release, when destroying them). The ids are
+released after all the entries of the stream have been decoded, as the TLS
+buffer deallocation command goes through the same queue. */
+#define ts_delta_id_words (ts_delta_max_streams / (sizeof (uword) * 8))
+/*----------------------------------------------------------------------------*/
+typedef struct ts_delta_ids {
+  bl_atomic_uword used[ts_delta_id_words];
+}
+ts_delta_ids;
+/*----------------------------------------------------------------------------*/
+extern void ts_delta_ids_init (ts_delta_ids* ids);
+/*----------------------------------------------------------------------------*/
+/* returns "ts_delta_no_stream" when all the ids are in use */
+extern u16 ts_delta_ids_acquire (ts_delta_ids* ids);
+/*----------------------------------------------------------------------------*/
+extern void ts_delta_ids_release (ts_delta_ids* ids, u16 id);
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_TIMESTAMP_DELTA_H__ */
@@ -26,11 +26,35 @@ void* tls_buffer_thread_local_get (void)
   return malc_tls;
 }
 /*----------------------------------------------------------------------------*/
+#define uword_bits (sizeof (uword) * 8)
+/*----------------------------------------------------------------------------*/
+static inline uword tls_free_index_bitmap_words (uword slot_count)
+{
+  return bl_div_ceil (slot_count, uword_bits);
+}
+/*----------------------------------------------------------------------------*/
+static void tls_free_index_init(
+  tls_free_index* x, u8* mem, uword slot_count, uword* done
+  )
+{
+  x->alloc       = 0;
+  x->freed_cache = 0;
+  bl_atomic_uword_store_rlx (&x->freed, 0);
+  x->mem         = mem;
+  x->slot_count  = slot_count;
+  x->freed_max   = 0;
+  x->done        = done;
+  memset (done, 0, tls_free_index_bitmap_words (slot_count) * sizeof *done);
+}
+/*----------------------------------------------------------------------------*/
 bl_err tls_buffer_init(
   tls_buffer**        out,
   u32                 slot_size_and_align,
   u32                 slot_count,
   bl_alloc_tbl const* alloc,
+  bool                spsc_lane,
+  bool                free_index,
+  tls_growth const*   growth,
   tls_destructor      destructor_fn,
   void*               destructor_context
   )
@@ -38,6 +62,23 @@ bl_err tls_buffer_init(
   bl_assert (bl_is_pow2 (slot_size_and_align));
   bl_uword allocsize = sizeof (tls_buffer) + slot_size_and_align;
   allocsize      += slot_size_and_align * slot_count;
+  bl_uword seg_max = growth ? growth->seg_max : 0;
+  allocsize       += sizeof (tls_segment*) * (seg_max + 1);
+  bl_uword lane_entries = 0;
+  if (spsc_lane) {
+    /* the segments can hold nodes too */
+    bl_uword max_nodes = slot_count;
+    if (growth) {
+      max_nodes += growth->seg_slots * growth->seg_max;
+    }
+    lane_entries = bl_round_next_pow2_u (max_nodes);
+    allocsize   += sizeof (bl_atomic_uword) * (lane_entries + 1);
+  }
+  bl_uword bitmap_words = 0;
+  if (free_index) {
+    bitmap_words = tls_free_index_bitmap_words (slot_count);
+    allocsize   += sizeof (uword) * (bitmap_words + 1);
+  }
 
   tls_buffer* t = (tls_buffer*) bl_alloc (alloc, allocsize);
   if (!t) {
@@ -45,6 +86,7 @@ bl_err tls_buffer_init(
   }
   t->destructor_fn      = destructor_fn;
   t->destructor_context = destructor_context;
+  t->alloc              = alloc;
   t->slot_size          = slot_size_and_align;
   t->slot_count         = slot_count;
 
@@ -53,7 +95,42 @@ bl_err tls_buffer_init(
   t->mem       = (u8*) mem;
   t->mem_end   = t->mem + (slot_count * t->slot_size);
   t->slot      = t->mem;
-  tls_buffer_dealloc (t->mem, slot_count, t->slot_size);
+  memset (&t->lane, 0, sizeof t->lane);
+  drop_counters_init (&t->drops);
+  /* placed after the slots */
+  t->segs = (tls_segment**) bl_round_to_next_multiple(
+    (bl_uword) t->mem_end, sizeof (tls_segment*)
+    );
+  if (growth) {
+    t->growth = *growth;
+  }
+  else {
+    memset (&t->growth, 0, sizeof t->growth);
+  }
+  t->seg_count = 0;
+  t->seg_cur   = 0;
+  t->seg_used  = false;
+  ts_delta_producer_init (&t->ts, ts_delta_no_stream);
+  if (spsc_lane) {
+    /* placed after the segment pointers */
+    t->lane.ring = (bl_atomic_uword*) bl_round_to_next_multiple(
+      (bl_uword) (t->segs + seg_max), sizeof (bl_atomic_uword)
+      );
+    t->lane.mask = lane_entries - 1;
+  }
+  t->free_index = free_index;
+  if (free_index) {
+    /* placed after the lane ring (or the segment pointers) */
+    u8* prev = spsc_lane ?
+      (u8*) (t->lane.ring + lane_entries) : (u8*) (t->segs + seg_max);
+    uword* done = (uword*) bl_round_to_next_multiple(
+      (bl_uword) prev, sizeof (uword)
+      );
+    tls_free_index_init (&t->fidx, t->mem, slot_count, done);
+  }
+  else {
+    tls_buffer_dealloc (t->mem, slot_count, t->slot_size);
+  }
   *out = t;
   return bl_mkok();
 }
@@ -74,41 +151,226 @@ void bl_tss_dtor_callconv tls_buffer_out_of_scope_destroy (void* opaque)
   }
 }
 /*----------------------------------------------------------------------------*/
-bl_err tls_buffer_alloc (u8** mem, u32 slots)
+/* allocates from a contiguous region of slots, "wrapped" is set when the
+allocation restarts from the region beginning. */
+static inline bool region_alloc(
+  u8**  slot,
+  u8*   mem,
+  u8*   mem_end,
+  uword slot_size,
+  u32   slots,
+  bool  may_wrap,
+  u8**  out,
+  bool* wrapped
+  )
 {
-  /* Some GDB versions segfault on TLS var access, set breakpoints afterwards*/
-  tls_buffer* t = (tls_buffer*) malc_tls;
-  if (bl_unlikely (!t)) {
-    return bl_mkerr (bl_alloc);
-  }
-  bl_assert (slots != 0 && mem && t);
-  if (bl_unlikely (slots > t->slot_count)) {
-    return bl_mkerr (bl_alloc);
-  }
   /* Segfaults here are most bl_likely caused by a thread enqueueing after the
   termination function has been called, which is forbidden but not enforced
   (enforcing it would require heavyweight synchronization on the fast-path) */
-  u8* slot_start = t->slot;
-  u8* slot_end   = t->slot + (slots * t->slot_size);
+  u8* slot_start = *slot;
+  u8* slot_end   = *slot + (slots * slot_size);
 
-  if (bl_unlikely (slot_end > t->mem_end)) {
+  *wrapped = false;
+  if (bl_unlikely (slot_end > mem_end)) {
+    if (!may_wrap) {
+      return false;
+    }
     /* memory region wrapping */
-    slot_start = t->mem;
-    slot_end   = t->mem + (slots * t->slot_size);
+    slot_start = mem;
+    slot_end   = mem + (slots * slot_size);
+    *wrapped   = true;
+    if (bl_unlikely (slot_end > mem_end)) {
+      return false; /* bigger than the region */
+    }
   }
   u8* check_iter = slot_start;
   while (check_iter < slot_end) {
     bl_uword first_word = bl_atomic_uword_load_rlx ((bl_atomic_uword*) check_iter);
     if (bl_unlikely (first_word != TLS_BUFFER_FREE_UWORD)) {
-      return bl_mkerr (bl_alloc);
+      return false;
+    }
+    check_iter += slot_size;
+  }
+  *slot = slot_end;
+  *out  = slot_start;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+/* "region_alloc" for the "free_index" protocol */
+static inline bool region_alloc_indexed(
+  tls_free_index* x,
+  u8**            slot,
+  u8*             mem,
+  u8*             mem_end,
+  uword           slot_size,
+  u32             slots,
+  bool            may_wrap,
+  u8**            out,
+  bool*           wrapped
+  )
+{
+  u8*   slot_start = *slot;
+  uword consumed   = slots; /* includes the skipped tail */
+
+  *wrapped = false;
+  if (bl_unlikely (*slot + (slots * slot_size) > mem_end)) {
+    if (!may_wrap || mem + (slots * slot_size) > mem_end) {
+      return false;
     }
-    check_iter += t->slot_size;
+    slot_start = mem;
+    consumed  += (uword) (mem_end - *slot) / slot_size;
+    *wrapped   = true;
   }
-  t->slot = slot_end;
-  *mem    = slot_start;
+  if (bl_unlikely (x->alloc + consumed > x->freed_cache + x->slot_count)) {
+    /* looks full: only now the consumer cache line is read */
+    x->freed_cache = bl_atomic_uword_load (&x->freed, bl_mo_acquire);
+    if (x->alloc + consumed > x->freed_cache + x->slot_count) {
+      return false;
+    }
+  }
+  if (*wrapped && *slot != mem_end) {
+    bl_atomic_uword_store_rlx ((bl_atomic_uword*) *slot, TLS_BUFFER_SKIP_UWORD);
+  }
+  x->alloc += consumed;
+  *slot     = slot_start + (slots * slot_size);
+  /* so the consumer can find the region */
+  *((tls_free_index**) (*slot - TLS_BUFFER_INDEX_TRAILER_BYTES)) = x;
+  *out      = slot_start;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+/* "idx" as on "tls_buffer.seg_cur" */
+static inline bool tls_buffer_region_alloc(
+  tls_buffer* t, uword idx, u8** mem, u32 slots, bool may_wrap, bool* wrapped
+  )
+{
+  if (idx == 0) {
+    if (t->free_index) {
+      return region_alloc_indexed(
+        &t->fidx,
+        &t->slot,
+        t->mem,
+        t->mem_end,
+        t->slot_size,
+        slots,
+        may_wrap,
+        mem,
+        wrapped
+        );
+    }
+    return region_alloc(
+      &t->slot, t->mem, t->mem_end, t->slot_size, slots, may_wrap, mem, wrapped
+      );
+  }
+  tls_segment* s = t->segs[idx - 1];
+  if (t->free_index) {
+    return region_alloc_indexed(
+      &s->fidx,
+      &s->slot,
+      s->mem,
+      s->mem_end,
+      t->slot_size,
+      slots,
+      may_wrap,
+      mem,
+      wrapped
+      );
+  }
+  return region_alloc(
+    &s->slot, s->mem, s->mem_end, t->slot_size, slots, may_wrap, mem, wrapped
+    );
+}
+/*----------------------------------------------------------------------------*/
+/* a whole lap on the own region without needing the segments: one of them is
+given back. One at a time, to avoid oscillations. */
+static void tls_buffer_try_shrink (tls_buffer* t)
+{
+  if (t->seg_count && !t->seg_used) {
+    bl_assert (t->seg_cur == 0);
+    --t->seg_count;
+    t->growth.retire (t->segs[t->seg_count], t->growth.retire_context);
+  }
+  t->seg_used = false;
+}
+/*----------------------------------------------------------------------------*/
+static bl_err tls_buffer_alloc_slow (tls_buffer* t, u8** mem, u32 slots)
+{
+  bool wrapped;
+  /* the own region is tried first, so the segments can go idle */
+  for (uword i = 0; i <= t->seg_count; ++i) {
+    if (i == 0 && t->seg_cur == 0) {
+      continue; /* just failed */
+    }
+    if (tls_buffer_region_alloc (t, i, mem, slots, true, &wrapped)) {
+      t->seg_cur   = i;
+      t->seg_used |= i != 0;
+      return bl_mkok();
+    }
+  }
+  if (t->seg_count >= t->growth.seg_max || slots > t->growth.seg_slots) {
+    return bl_mkerr (bl_alloc);
+  }
+  tls_segment* s = t->growth.get (t->growth.get_context);
+  if (!s) {
+    return bl_mkerr (bl_alloc);
+  }
+  t->segs[t->seg_count] = s;
+  ++t->seg_count;
+  t->seg_cur  = t->seg_count;
+  t->seg_used = true;
+  bl_assert_side_effect(
+    tls_buffer_region_alloc (t, t->seg_cur, mem, slots, true, &wrapped)
+    );
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
+static inline bl_err tls_buffer_alloc_impl (tls_buffer* t, u8** mem, u32 slots)
+{
+  bl_assert (slots != 0 && mem && t);
+  bool wrapped;
+  /* the segments go back to the own region (if it has space) at the end of
+  each lap */
+  if (bl_likely (tls_buffer_region_alloc(
+    t, t->seg_cur, mem, slots, t->seg_cur == 0, &wrapped
+    ))) {
+    if (bl_unlikely (wrapped && t->seg_cur == 0)) {
+      tls_buffer_try_shrink (t);
+    }
+    return bl_mkok();
+  }
+  return tls_buffer_alloc_slow (t, mem, slots);
+}
+/*----------------------------------------------------------------------------*/
+bl_err tls_buffer_alloc (u8** mem, u32 slots)
+{
+  /* Some GDB versions segfault on TLS var access, set breakpoints afterwards*/
+  tls_buffer* t = (tls_buffer*) malc_tls;
+  if (bl_unlikely (!t)) {
+    return bl_mkerr (bl_alloc);
+  }
+  return tls_buffer_alloc_impl (t, mem, slots);
+}
+/*----------------------------------------------------------------------------*/
+bl_err tls_buffer_alloc_entry(
+  u8** mem, u32* slots, u32 n_bytes, u32 max_slots, bool* free_index
+  )
+{
+  /* Some GDB versions segfault on TLS var access, set breakpoints afterwards*/
+  tls_buffer* t = (tls_buffer*) malc_tls;
+  if (bl_unlikely (!t)) {
+    return bl_mkerr (bl_alloc);
+  }
+  if (t->free_index) {
+    n_bytes += TLS_BUFFER_INDEX_TRAILER_BYTES;
+  }
+  *slots      = bl_div_ceil (n_bytes, (u32) t->slot_size);
+  *free_index = t->free_index;
+  if (bl_unlikely (*slots > max_slots)) {
+    return bl_mkerr (bl_alloc); /* the trailer didn't fit, try elsewhere */
+  }
+  return tls_buffer_alloc_impl (t, mem, *slots);
+}
+/*----------------------------------------------------------------------------*/
 void tls_buffer_dealloc (void* mem, u32 slots, u32 slot_size)
 {
   /* check right alignment */
@@ -120,4 +382,160 @@ void tls_buffer_dealloc (void* mem, u32 slots, u32 slot_size)
   }
 }
 /*----------------------------------------------------------------------------*/
+static inline bool bitmap_test (uword const* b, uword i)
+{
+  return (b[i / uword_bits] >> (i % uword_bits)) & 1;
+}
+/*----------------------------------------------------------------------------*/
+static inline void bitmap_set (uword* b, uword i)
+{
+  b[i / uword_bits] |= ((uword) 1) << (i % uword_bits);
+}
+/*----------------------------------------------------------------------------*/
+static inline void bitmap_clear (uword* b, uword i)
+{
+  b[i / uword_bits] &= ~(((uword) 1) << (i % uword_bits));
+}
+/*----------------------------------------------------------------------------*/
+void tls_buffer_dealloc_indexed (void* mem, u32 slots, u32 slot_size)
+{
+  u8* end = ((u8*) mem) + (slots * slot_size);
+  tls_free_index* x =
+    *((tls_free_index**) (end - TLS_BUFFER_INDEX_TRAILER_BYTES));
+  uword count = x->slot_count;
+  uword pos   = (uword) (((u8*) mem) - x->mem) / slot_size;
+  bl_assert (pos + slots <= count);
+  /* only written from here */
+  uword freed = bl_atomic_uword_load_rlx (&x->freed);
+  /* the allocations not freed yet are less than a lap ahead of "freed" */
+  uword start  = freed + ((pos + count - (freed % count)) % count);
+  x->freed_max = bl_max (x->freed_max, start + slots);
+  for (uword i = pos; i < pos + slots; ++i) {
+    bitmap_set (x->done, i);
+  }
+  uword adv = freed;
+  uword p   = freed % count;
+  while (adv < x->freed_max) {
+    if (bitmap_test (x->done, p)) {
+      bitmap_clear (x->done, p);
+      ++adv;
+      p = (p + 1 == count) ? 0 : p + 1;
+      continue;
+    }
+    /* either an entry not consumed yet or a skipped region tail. A skipped
+    tail can only be told apart once an allocation of the next lap is seen.
+    An allocation starts with a qnode, so the first word can't be a skip mark
+    left by a previous lap. */
+    uword lap_end = adv + (count - p);
+    if (x->freed_max > lap_end &&
+      bl_atomic_uword_load_rlx ((bl_atomic_uword*) (x->mem + (p * slot_size)))
+        == TLS_BUFFER_SKIP_UWORD
+      ) {
+      adv = lap_end;
+      p   = 0;
+      continue;
+    }
+    break;
+  }
+  if (adv != freed) {
+    bl_atomic_uword_store (&x->freed, adv, bl_mo_release);
+  }
+}
+/*----------------------------------------------------------------------------*/
+bool tls_buffer_lane_push (void* node)
+{
+  /* Some GDB versions segfault on TLS var access, set breakpoints afterwards*/
+  tls_buffer* t = (tls_buffer*) malc_tls;
+  bl_assert (t);
+  if (!tls_buffer_has_lane (t)) {
+    return false;
+  }
+  /* only this thread writes "tail" */
+  uword tail = bl_atomic_uword_load_rlx (&t->lane.tail);
+  bl_atomic_uword_store_rlx (&t->lane.ring[tail & t->lane.mask], (uword) node);
+  bl_atomic_uword_store (&t->lane.tail, tail + 1, bl_mo_release);
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+void* tls_buffer_lane_pop (tls_buffer* t)
+{
+  bl_assert (tls_buffer_has_lane (t));
+  uword head = t->lane.head;
+  if (head == t->lane.tail_cache) {
+    /* the producer cache line is only touched when the cached tail is
+    exhausted */
+    t->lane.tail_cache = bl_atomic_uword_load (&t->lane.tail, bl_mo_acquire);
+    if (head == t->lane.tail_cache) {
+      return nullptr;
+    }
+  }
+  void* node =
+    (void*) bl_atomic_uword_load_rlx (&t->lane.ring[head & t->lane.mask]);
+  t->lane.head = head + 1;
+  return node;
+}
+/*----------------------------------------------------------------------------*/
+bool tls_buffer_lane_is_empty (tls_buffer* t)
+{
+  bl_assert (tls_buffer_has_lane (t));
+  if (t->lane.head != t->lane.tail_cache) {
+    return false;
+  }
+  t->lane.tail_cache = bl_atomic_uword_load (&t->lane.tail, bl_mo_acquire);
+  return t->lane.head == t->lane.tail_cache;
+}
+/*----------------------------------------------------------------------------*/
+tls_segment* tls_segment_create(
+  u32 slot_size_and_align, u32 slot_count, bl_alloc_tbl const* alloc
+  )
+{
+  bl_assert (bl_is_pow2 (slot_size_and_align));
+  /* the "free_index" bitmap is placed after the slots */
+  bl_uword bitmap_words = tls_free_index_bitmap_words (slot_count);
+  tls_segment* s = (tls_segment*) bl_alloc(
+    alloc,
+    sizeof (tls_segment) + slot_size_and_align * (slot_count + 1) +
+      sizeof (uword) * bitmap_words
+    );
+  if (!s) {
+    return nullptr;
+  }
+  bl_uword mem   = ((bl_uword) s) + sizeof (*s) + slot_size_and_align;
+  mem           &= ~(((bl_uword) slot_size_and_align) - 1);
+  s->mem         = (u8*) mem;
+  s->mem_end     = s->mem + (slot_count * slot_size_and_align);
+  s->fidx.done   = (uword*) s->mem_end;
+  s->fidx.slot_count = slot_count;
+  tls_segment_reset (s);
+  return s;
+}
+/*----------------------------------------------------------------------------*/
+void tls_segment_reset (tls_segment* s)
+{
+  uword slot_size = (uword) (s->mem_end - s->mem) / s->fidx.slot_count;
+  s->next = nullptr;
+  s->slot = s->mem;
+  /* the owner of the segment might use either protocol */
+  tls_buffer_dealloc (s->mem, (u32) s->fidx.slot_count, (u32) slot_size);
+  tls_free_index_init (&s->fidx, s->mem, s->fidx.slot_count, s->fidx.done);
+}
+/*----------------------------------------------------------------------------*/
+bool tls_buffer_count_drop (unsigned reason, uword bytes)
+{
+  /* Some GDB versions segfault on TLS var access, set breakpoints afterwards*/
+  tls_buffer* t = (tls_buffer*) malc_tls;
+  if (!t) {
+    return false;
+  }
+  drop_counters_add_owned (&t->drops, reason, bytes);
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+ts_delta_producer* tls_buffer_ts_delta (void)
+{
+  /* Some GDB versions segfault on TLS var access, set breakpoints afterwards*/
+  tls_buffer* t = (tls_buffer*) malc_tls;
+  return (t && t->ts.stream != ts_delta_no_stream) ? &t->ts : nullptr;
+}
+/*----------------------------------------------------------------------------*/
 #endif
\ No newline at end of file
@@ -5,6 +5,11 @@
 #include <bl/base/allocator.h>
 #include <bl/base/error.h>
 #include <bl/base/thread.h>
+#include <bl/base/atomic.h>
+#include <bl/base/cache.h>
+
+#include <malc/drops.h>
+#include <malc/timestamp_delta.h>
 
 /* This trivial (but very specialized) SPSC algorithm relies on
    TLS_BUFFER_FREE_UWORD being a forbidden value on the first bl_word of then
@@ -21,17 +26,115 @@
    */
 
 #define TLS_BUFFER_FREE_UWORD ((uword) 1)
+
+/* Alternative protocol ("free_index" on "tls_buffer_init"): the slots are not
+   marked. The consumer publishes how many slots it has freed ("freed") on its
+   own cache line and the producer compares against a cached copy of it, so the
+   producer only reads a cache line written by the consumer when the region
+   looks full.
+
+   The consumer can free out of order (e.g. priority entries), so it records
+   the freed slots on a private bitmap and only advances "freed" over
+   contiguous runs. When an allocation doesn't fit on the region tail the
+   producer skips it and marks the first skipped slot with
+   TLS_BUFFER_SKIP_UWORD.
+
+   The consumer finds the region of an allocation through a pointer that the
+   producer stores on the last TLS_BUFFER_INDEX_TRAILER_BYTES of it, so the
+   callers have to reserve them (see "tls_buffer_alloc_entry"). */
+
+#define TLS_BUFFER_SKIP_UWORD          ((uword) 3)
+#define TLS_BUFFER_INDEX_TRAILER_BYTES (sizeof (void*))
+/*----------------------------------------------------------------------------*/
+typedef struct tls_free_index {
+  /* producer */
+  uword           alloc;       /* slots allocated or skipped, monotonic */
+  uword           freed_cache; /* last "freed" value read */
+  bl_declare_cache_pad_member;
+  bl_atomic_uword freed;       /* slots freed, monotonic. Consumer written */
+  bl_declare_cache_pad_member;
+  /* consumer */
+  u8*             mem;
+  uword           slot_count;
+  uword           freed_max; /* end of the furthest freed allocation */
+  uword*          done;      /* bitmap of the freed slots beyond "freed" */
+}
+tls_free_index;
 /*----------------------------------------------------------------------------*/
 typedef void (*tls_destructor) (void* mem, void* context);
 /*----------------------------------------------------------------------------*/
+/* Optional extra memory regions linked to a TLS buffer when its own region is
+   full, so a thread can start with a small buffer. The segments come from a
+   pool and are given back ("retire") when the thread stops needing them.
+
+   A retired segment might still have entries on the queues, so the "retire"
+   callback has to defer its return to the pool until they are consumed. */
+typedef struct tls_segment {
+  /* "next" and "slot" are overwritten when the segment is retired (it is sent
+  to the consumer as a queue node) */
+  struct tls_segment* next; /* pool link */
+  u8*                 slot;
+  u8*                 mem;
+  u8*                 mem_end;
+  tls_free_index      fidx; /* only used by buffers with "free_index" */
+}
+tls_segment;
+/*----------------------------------------------------------------------------*/
+typedef tls_segment* (*tls_segment_get) (void* context);
+typedef void (*tls_segment_retire) (tls_segment* s, void* context);
+/*----------------------------------------------------------------------------*/
+typedef struct tls_growth {
+  u32                seg_slots; /* slots on each segment */
+  u32                seg_max;   /* maximum segments linked to a buffer */
+  tls_segment_get    get;       /* returns null when the pool is exhausted */
+  void*              get_context;
+  tls_segment_retire retire;
+  void*              retire_context;
+}
+tls_growth;
+/*----------------------------------------------------------------------------*/
+/* Optional wait-free SPSC queue of the nodes allocated on the buffer, used to
+   avoid the shared MPSC queue. The producer pushes and the consumer pops.
+
+   As each node takes at least one slot of the buffer and the nodes are popped
+   before they are deallocated, a ring with as many entries as slots can never
+   overflow, so the producer doesn't need to read the consumer index. */
+typedef struct tls_lane {
+  bl_atomic_uword* ring;
+  uword            mask;
+  bl_declare_cache_pad_member;
+  bl_atomic_uword  tail;       /* producer */
+  bl_declare_cache_pad_member;
+  uword            head;       /* consumer */
+  uword            tail_cache; /* consumer */
+  bool             busy;       /* consumer, on the busy list of "memory" */
+  bl_declare_cache_pad_member;
+}
+tls_lane;
+/*----------------------------------------------------------------------------*/
 typedef struct tls_buffer {
-  tls_destructor destructor_fn;
-  void*          destructor_context;
-  u8*            mem;
-  u8*            mem_end;
-  u8*            slot;
-  uword          slot_count;
-  uword          slot_size;
+  /* "destructor_fn" and "destructor_context" are overwritten when the buffer
+  is sent to the consumer as a queue node on thread exit */
+  tls_destructor      destructor_fn;
+  void*               destructor_context;
+  bl_alloc_tbl const* alloc; /* the one that allocated this struct */
+  u8*                 mem;
+  u8*                 mem_end;
+  u8*                 slot;
+  uword               slot_count;
+  uword               slot_size;
+  tls_lane            lane;
+  drop_counters       drops; /* written by the owner thread only */
+  bool                free_index;
+  tls_free_index      fidx;
+  tls_growth          growth;
+  tls_segment**       segs;      /* "growth.seg_max" entries */
+  uword               seg_count; /* linked segments */
+  /* region in use: 0 own region, "i" "segs[i - 1]" */
+  uword               seg_cur;
+  /* a segment was used on the last own region lap */
+  bool                seg_used;
+  ts_delta_producer   ts; /* stream id set by the creator */
 }
 tls_buffer;
 /*----------------------------------------------------------------------------*/
@@ -40,6 +143,9 @@ extern bl_err tls_buffer_init(
   u32                 slot_size_and_align,
   u32                 slot_count,
   bl_alloc_tbl const* alloc,
+  bool                spsc_lane,
+  bool                free_index,
+  tls_growth const*   growth,        /* optional, can be null */
   tls_destructor      destructor_fn, /* executed when out of scope */
   void*               destructor_context /* will be passed to "destructor_fn" */
   );
@@ -50,9 +156,52 @@ extern void* tls_buffer_thread_local_get (void);
 /*----------------------------------------------------------------------------*/
 extern void bl_tss_dtor_callconv tls_buffer_out_of_scope_destroy (void* opaque);
 /*----------------------------------------------------------------------------*/
+/* With "free_index" the last TLS_BUFFER_INDEX_TRAILER_BYTES of the allocation
+   are overwritten. */
 extern bl_err tls_buffer_alloc (u8** mem, u32 slots);
 /*----------------------------------------------------------------------------*/
+/* "tls_buffer_alloc" for "n_bytes", reserving the "free_index" trailer if the
+   calling thread's buffer uses it. "slots" and "free_index" are outputs. */
+extern bl_err tls_buffer_alloc_entry(
+  u8** mem, u32* slots, u32 n_bytes, u32 max_slots, bool* free_index
+  );
+/*----------------------------------------------------------------------------*/
 extern void tls_buffer_dealloc (void* mem, u32 slots, u32 slot_size);
 /*----------------------------------------------------------------------------*/
+/* consumer side, for the allocations of buffers using "free_index" */
+extern void tls_buffer_dealloc_indexed (void* mem, u32 slots, u32 slot_size);
+/*----------------------------------------------------------------------------*/
+static inline bool tls_buffer_has_lane (tls_buffer const* t)
+{
+  return t->lane.ring != nullptr;
+}
+/*----------------------------------------------------------------------------*/
+/* pushes a node allocated on the calling thread's buffer. Returns false if the
+   buffer has no lane. */
+extern bool tls_buffer_lane_push (void* node);
+/*----------------------------------------------------------------------------*/
+/* consumer side. Returns null when the lane is empty. */
+extern void* tls_buffer_lane_pop (tls_buffer* t);
+/*----------------------------------------------------------------------------*/
+/* consumer side. Doesn't pop. */
+extern bool tls_buffer_lane_is_empty (tls_buffer* t);
+/*----------------------------------------------------------------------------*/
+/* allocates a segment with all its slots free */
+extern tls_segment* tls_segment_create(
+  u32 slot_size_and_align, u32 slot_count, bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+/* prepares a retired segment (with all its entries consumed) to be linked
+   again, for either protocol */
+extern void tls_segment_reset (tls_segment* s);
+/*----------------------------------------------------------------------------*/
+/* counts a dropped entry on the calling thread's buffer. Returns false if the
+   thread has no buffer. */
+extern bool tls_buffer_count_drop (unsigned reason, uword bytes);
+/*----------------------------------------------------------------------------*/
+/* the "timestamp_delta" state of the calling thread's buffer. Null if there is
+   no buffer or if it has no stream id. */
+extern ts_delta_producer* tls_buffer_ts_delta (void);
+/*----------------------------------------------------------------------------*/
 
 #endif
\ No newline at end of file
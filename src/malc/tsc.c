@@ -0,0 +1,98 @@
+#include <bl/base/assert.h>
+
+#include <bl/time_extras/time_extras.h>
+
+#include <malc/tsc.h>
+
+#if MALC_HAS_TSC && !defined (_MSC_VER)
+  #include <cpuid.h>
+#endif
+
+/*----------------------------------------------------------------------------*/
+bool tsc_is_invariant (void)
+{
+#if MALC_HAS_TSC && defined (_MSC_VER)
+  int r[4];
+  __cpuid (r, 0x80000000);
+  if ((unsigned) r[0] < 0x80000007u) {
+    return false;
+  }
+  __cpuid (r, 0x80000007);
+  return (r[3] & (1 << 8)) != 0;
+#elif MALC_HAS_TSC
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (edx & (1u << 8)) != 0;
+#else
+  return false;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+static tsc_sample tsc_sample_get (void)
+{
+  /* the clock read is bracketed to get a TSC value near its middle. The
+  narrowest of a few tries is kept, the first one is usually slow (cold) */
+  tsc_sample s;
+  u64 best = (u64) -1;
+  for (uword i = 0; i < 4; ++i) {
+    u64 before = tsc_get();
+    u64 ns     = bl_fast_timept_to_nsec (bl_fast_timept_get());
+    u64 width  = tsc_get() - before;
+    if (width < best) {
+      best  = width;
+      s.ns  = ns;
+      s.tsc = before + (width / 2);
+    }
+  }
+  return s;
+}
+/*----------------------------------------------------------------------------*/
+static inline bool tsc_rate_update (tsc_calib* c, tsc_sample const* now)
+{
+  if (now->tsc <= c->win.tsc || now->ns <= c->win.ns) {
+    return false;
+  }
+  c->ns_per_tick =
+    (double) (now->ns - c->win.ns) / (double) (now->tsc - c->win.tsc);
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+void tsc_calib_init (tsc_calib* c, u32 usec)
+{
+  c->win         = tsc_sample_get();
+  c->win_mid_set = false;
+  c->ns_per_tick = 1.;
+  tsc_sample now;
+  do {
+    now = tsc_sample_get();
+  }
+  while(
+    now.ns < c->win.ns + ((u64) usec * 1000) || !tsc_rate_update (c, &now)
+    );
+  c->anchor = now;
+}
+/*----------------------------------------------------------------------------*/
+void tsc_calib_refresh (tsc_calib* c)
+{
+  tsc_sample now = tsc_sample_get();
+  if (!tsc_rate_update (c, &now)) {
+    /* the TSC or the clock went backwards (e.g. migrated VM), restart */
+    c->win         = now;
+    c->win_mid_set = false;
+    c->anchor      = now;
+    return;
+  }
+  c->anchor = now;
+  u64 elapsed = now.ns - c->win.ns;
+  if (!c->win_mid_set && elapsed >= tsc_calib_window_ns) {
+    c->win_mid     = now;
+    c->win_mid_set = true;
+  }
+  if (elapsed >= 2 * tsc_calib_window_ns) {
+    c->win         = c->win_mid;
+    c->win_mid_set = false;
+  }
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,79 @@
+#ifndef __MALC_TSC_H__
+#define __MALC_TSC_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/time.h>
+
+/* Raw TSC producer timestamps ("malc_producer_cfg.timestamp_tsc").
+
+The producers store the raw x86-64 time stamp counter, which is a single
+"rdtsc" instead of a clock call. The consumer converts the ticks to the
+nanoseconds of "bl_fast_timept" (the clock used when this is disabled) with a
+calibration: an anchor (a TSC value and the clock at that moment) plus the
+rate of the TSC against the clock.
+
+The rate is measured when starting and then refreshed from the consumer idle
+task against a window of 1 to 2 "tsc_calib_window_ns", so it follows the drift
+between both clocks without depending on the clock granularity. The anchor is
+moved to the last refresh, so the error doesn't accumulate.
+
+Only enabled when the CPU reports an invariant TSC (constant rate, not stopped
+on the deep sleep states), otherwise the producers keep using the clock. */
+
+/* MSVC (and clang-cl) first: "tsc.c" picks "__cpuid" from <intrin.h> on
+"_MSC_VER" and <cpuid.h> otherwise */
+#if defined (_MSC_VER) && defined (_M_X64)
+  #include <intrin.h>
+  #define MALC_HAS_TSC 1
+#elif defined (__x86_64__) && (defined (__GNUC__) || defined (__clang__))
+  #include <x86intrin.h>
+  #define MALC_HAS_TSC 1
+#else
+  #define MALC_HAS_TSC 0
+#endif
+
+#define tsc_calib_window_ns (10ull * 1000 * 1000 * 1000)
+/*----------------------------------------------------------------------------*/
+static inline u64 tsc_get (void)
+{
+#if MALC_HAS_TSC
+  return (u64) __rdtsc();
+#else
+  return 0;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+typedef struct tsc_sample {
+  u64 tsc;
+  u64 ns;
+}
+tsc_sample;
+/*----------------------------------------------------------------------------*/
+typedef struct tsc_calib {
+  tsc_sample anchor;
+  tsc_sample win;     /* start of the rate measurement window */
+  tsc_sample win_mid; /* next window start, valid if "win_mid_set" */
+  bool       win_mid_set;
+  double     ns_per_tick;
+}
+tsc_calib;
+/*----------------------------------------------------------------------------*/
+/* true if the CPU has an invariant TSC */
+extern bool tsc_is_invariant (void);
+/*----------------------------------------------------------------------------*/
+/* measures the initial rate, blocking for around "usec" */
+extern void tsc_calib_init (tsc_calib* c, u32 usec);
+/*----------------------------------------------------------------------------*/
+/* moves the anchor to the current time and updates the rate */
+extern void tsc_calib_refresh (tsc_calib* c);
+/*----------------------------------------------------------------------------*/
+static inline u64 tsc_calib_to_nsec (tsc_calib const* c, u64 tsc)
+{
+  /* the entries taken before the last refresh have a negative offset */
+  double offset = (double) (i64) (tsc - c->anchor.tsc) * c->ns_per_tick;
+  return c->anchor.ns + (u64) (i64) offset;
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_TSC_H__ */
@@ -0,0 +1,182 @@
+#include <bl/base/assert.h>
+#include <bl/base/time.h>
+
+#include <malc/waiter.h>
+
+#if MALC_HAS_WAITER
+  #include <errno.h>
+  #include <time.h>
+  #include <unistd.h>
+  #include <sys/syscall.h>
+  #include <sys/eventfd.h>
+  #include <sys/timerfd.h>
+  #include <sys/epoll.h>
+  #include <linux/futex.h>
+#endif
+
+/*----------------------------------------------------------------------------*/
+void waiter_init (waiter* w)
+{
+  bl_atomic_u32_store_rlx (&w->sleeping, 0);
+  w->mode     = waiter_none;
+  w->event_fd = -1;
+  w->timer_fd = -1;
+  w->poll_fd  = -1;
+}
+/*----------------------------------------------------------------------------*/
+#if MALC_HAS_WAITER
+/*----------------------------------------------------------------------------*/
+static void waiter_close_fds (waiter* w)
+{
+  int* fds[] = { &w->poll_fd, &w->timer_fd, &w->event_fd };
+  for (uword i = 0; i < bl_arr_elems (fds); ++i) {
+    if (*fds[i] >= 0) {
+      (void) close (*fds[i]);
+      *fds[i] = -1;
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bl_err waiter_open_fds (waiter* w)
+{
+  struct epoll_event ev;
+  w->event_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (w->event_fd < 0) {
+    goto error;
+  }
+  w->timer_fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (w->timer_fd < 0) {
+    goto error;
+  }
+  w->poll_fd = epoll_create1 (EPOLL_CLOEXEC);
+  if (w->poll_fd < 0) {
+    goto error;
+  }
+  ev.events  = EPOLLIN;
+  ev.data.fd = w->event_fd;
+  if (epoll_ctl (w->poll_fd, EPOLL_CTL_ADD, w->event_fd, &ev) != 0) {
+    goto error;
+  }
+  ev.events  = EPOLLIN;
+  ev.data.fd = w->timer_fd;
+  if (epoll_ctl (w->poll_fd, EPOLL_CTL_ADD, w->timer_fd, &ev) != 0) {
+    goto error;
+  }
+  return bl_mkok();
+error:;
+  bl_err err = bl_mkerr_sys (bl_error, errno);
+  waiter_close_fds (w);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+bl_err waiter_reset (waiter* w, unsigned mode)
+{
+  waiter_close_fds (w);
+  bl_atomic_u32_store_rlx (&w->sleeping, 0);
+  w->mode = waiter_none;
+  if (mode == waiter_fd) {
+    bl_err err = waiter_open_fds (w);
+    if (err.own) {
+      return err;
+    }
+  }
+  w->mode = (u8) mode;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+void waiter_destroy (waiter* w)
+{
+  waiter_close_fds (w);
+  w->mode = waiter_none;
+}
+/*----------------------------------------------------------------------------*/
+void waiter_wait (waiter* w, u64 timeout_ns)
+{
+  bl_assert (w->mode == waiter_futex);
+  struct timespec ts;
+  ts.tv_sec  = (time_t) (timeout_ns / bl_nsec_in_sec);
+  ts.tv_nsec = (long) (timeout_ns % bl_nsec_in_sec);
+  /* returns immediately if a producer already cleared the flag. EINTR and
+  spurious wakeups are harmless, the caller rechecks everything. */
+  (void) syscall(
+    SYS_futex, (u32*) &w->sleeping, FUTEX_WAIT_PRIVATE, 1, &ts, nullptr, 0
+    );
+}
+/*----------------------------------------------------------------------------*/
+void waiter_fd_clear (waiter* w)
+{
+  bl_assert (w->mode == waiter_fd);
+  u64 v;
+  (void) read (w->event_fd, &v, sizeof v);
+  (void) read (w->timer_fd, &v, sizeof v);
+}
+/*----------------------------------------------------------------------------*/
+void waiter_fd_arm (waiter* w, u64 timeout_ns)
+{
+  bl_assert (w->mode == waiter_fd);
+  struct itimerspec its;
+  /* a zero value would disarm the timer */
+  timeout_ns = timeout_ns ? timeout_ns : 1;
+  its.it_interval.tv_sec  = 0;
+  its.it_interval.tv_nsec = 0;
+  its.it_value.tv_sec     = (time_t) (timeout_ns / bl_nsec_in_sec);
+  its.it_value.tv_nsec    = (long) (timeout_ns % bl_nsec_in_sec);
+  (void) timerfd_settime (w->timer_fd, 0, &its, nullptr);
+}
+/*----------------------------------------------------------------------------*/
+void waiter_wake_slow (waiter* w)
+{
+  /* only one of the racing producers issues the syscall */
+  if (!bl_atomic_u32_exchange_rlx (&w->sleeping, 0)) {
+    return;
+  }
+  if (w->mode == waiter_fd) {
+    u64 v = 1;
+    (void) write (w->event_fd, &v, sizeof v);
+  }
+  else {
+    (void) syscall(
+      SYS_futex, (u32*) &w->sleeping, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0
+      );
+  }
+}
+/*----------------------------------------------------------------------------*/
+#else /* MALC_HAS_WAITER */
+/*----------------------------------------------------------------------------*/
+bl_err waiter_reset (waiter* w, unsigned mode)
+{
+  w->mode = waiter_none;
+  return bl_mkerr (mode == waiter_none ? bl_ok : bl_invalid);
+}
+/*----------------------------------------------------------------------------*/
+void waiter_destroy (waiter* w)
+{
+  (void) w;
+}
+/*----------------------------------------------------------------------------*/
+void waiter_wait (waiter* w, u64 timeout_ns)
+{
+  (void) w;
+  (void) timeout_ns;
+  bl_assert (false && "waiter unavailable on this platform");
+}
+/*----------------------------------------------------------------------------*/
+void waiter_fd_clear (waiter* w)
+{
+  (void) w;
+  bl_assert (false && "waiter unavailable on this platform");
+}
+/*----------------------------------------------------------------------------*/
+void waiter_fd_arm (waiter* w, u64 timeout_ns)
+{
+  (void) w;
+  (void) timeout_ns;
+  bl_assert (false && "waiter unavailable on this platform");
+}
+/*----------------------------------------------------------------------------*/
+void waiter_wake_slow (waiter* w)
+{
+  (void) w;
+}
+/*----------------------------------------------------------------------------*/
+#endif /* MALC_HAS_WAITER */
@@ -0,0 +1,107 @@
+#ifndef __MALC_WAITER_H__
+#define __MALC_WAITER_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer_short.h>
+#include <bl/base/atomic.h>
+#include <bl/base/error.h>
+
+/* Allows the consumer to block when all the queues are empty and the producers
+to wake it up on the empty to non-empty transition.
+
+The consumer announces that it is going to sleep ("waiter_prepare"), rechecks
+the queues and then blocks ("waiter_wait"). The producers check for the
+announcement after enqueueing ("waiter_wake"), so the fast path when the
+consumer is awake is a fence and a load on a mostly read-only cache line.
+
+There are two wake up mechanisms:
+
+- waiter_futex: the consumer blocks on a futex.
+- waiter_fd: the consumer doesn't block, it returns to an external event loop
+  instead. The producers signal an eventfd. A timerfd is used for the consumer
+  deadlines. Both are aggregated on an epoll fd, which is what the external
+  event loop polls.
+
+Only available on Linux. */
+
+#if defined (BL_LINUX)
+  #define MALC_HAS_WAITER 1
+#else
+  #define MALC_HAS_WAITER 0
+#endif
+/*----------------------------------------------------------------------------*/
+enum waiter_mode {
+  waiter_none,
+  waiter_futex,
+  waiter_fd,
+};
+/*----------------------------------------------------------------------------*/
+typedef struct waiter {
+  bl_atomic_u32 sleeping;
+  u8            mode;
+  int           event_fd;
+  int           timer_fd;
+  int           poll_fd;
+}
+waiter;
+/*----------------------------------------------------------------------------*/
+extern void waiter_init (waiter* w);
+/*----------------------------------------------------------------------------*/
+/* (re)creates the resources for the given mode. Not thread-safe. */
+extern bl_err waiter_reset (waiter* w, unsigned mode);
+/*----------------------------------------------------------------------------*/
+extern void waiter_destroy (waiter* w);
+/*----------------------------------------------------------------------------*/
+static inline bool waiter_is_enabled (waiter const* w)
+{
+  return w->mode != waiter_none;
+}
+/*----------------------------------------------------------------------------*/
+/* epoll fd, only valid on the "waiter_fd" mode, -1 otherwise */
+static inline int waiter_get_fd (waiter const* w)
+{
+  return w->poll_fd;
+}
+/*----------------------------------------------------------------------------*/
+/* consumer side: the queues have to be rechecked after this call and before
+calling "waiter_wait" or returning to the event loop */
+static inline void waiter_prepare (waiter* w)
+{
+  bl_atomic_u32_store_rlx (&w->sleeping, 1);
+  bl_atomic_fence (bl_mo_seq_cst);
+}
+/*----------------------------------------------------------------------------*/
+/* consumer side, "waiter_futex" mode: returns when woken up, on timeout or
+spuriously. */
+extern void waiter_wait (waiter* w, u64 timeout_ns);
+/*----------------------------------------------------------------------------*/
+/* consumer side, "waiter_fd" mode: consumes the pending notifications, so the
+fd stops being readable. To be called before checking the queues. */
+extern void waiter_fd_clear (waiter* w);
+/*----------------------------------------------------------------------------*/
+/* consumer side, "waiter_fd" mode: makes the fd readable after "timeout_ns" */
+extern void waiter_fd_arm (waiter* w, u64 timeout_ns);
+/*----------------------------------------------------------------------------*/
+/* consumer side: to be called after "waiter_wait" or instead of it. On the
+"waiter_fd" mode it's to be called when the consumer runs again. */
+static inline void waiter_done (waiter* w)
+{
+  bl_atomic_u32_store_rlx (&w->sleeping, 0);
+}
+/*----------------------------------------------------------------------------*/
+extern void waiter_wake_slow (waiter* w);
+/*----------------------------------------------------------------------------*/
+/* producer side: to be called after enqueueing */
+static inline void waiter_wake (waiter* w)
+{
+  if (w->mode == waiter_none) {
+    return;
+  }
+  bl_atomic_fence (bl_mo_seq_cst);
+  if (bl_unlikely (bl_atomic_u32_load_rlx (&w->sleeping))) {
+    waiter_wake_slow (w);
+  }
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __MALC_WAITER_H__ */
@@ -32,6 +32,12 @@ bl_err wrapper::get_cfg (cfg& c) const noexcept
   return malc_get_cfg (handle(), (::malc_cfg*) &c);
 }
 /*----------------------------------------------------------------------------*/
+bl_err wrapper::get_stats (stats& s) const noexcept
+{
+  assert (m_ptr);
+  return malc_get_stats (handle(), (::malc_stats*) &s);
+}
+/*----------------------------------------------------------------------------*/
 bl_err wrapper::init (cfg const& c) noexcept
 {
   assert (m_ptr);
@@ -50,6 +56,24 @@ bl_err wrapper::flush() noexcept
   return malc_flush (handle());
 }
 /*----------------------------------------------------------------------------*/
+bl_err wrapper::flush_async (size_t& ticket) noexcept
+{
+  assert (m_ptr);
+  return malc_flush_async (handle(), &ticket);
+}
+/*----------------------------------------------------------------------------*/
+bool wrapper::is_flushed (size_t ticket) const noexcept
+{
+  assert (m_ptr);
+  return malc_is_flushed (handle(), ticket);
+}
+/*----------------------------------------------------------------------------*/
+bl_err wrapper::wait_flushed (size_t ticket, unsigned timeout_us) noexcept
+{
+  assert (m_ptr);
+  return malc_wait_flushed (handle(), ticket, timeout_us);
+}
+/*----------------------------------------------------------------------------*/
 bl_err wrapper::terminate (bool dontblock) noexcept
 {
   assert (m_ptr);
@@ -68,6 +92,30 @@ bl_err wrapper::run_consume_task (unsigned timeout_us) noexcept
   return malc_run_consume_task (handle(), timeout_us);
 }
 /*----------------------------------------------------------------------------*/
+bl_err wrapper::get_consumer_fd (int& fd) const noexcept
+{
+  assert (m_ptr);
+  return malc_get_consumer_fd (handle(), &fd);
+}
+/*----------------------------------------------------------------------------*/
+bl_err wrapper::consumer_acquire() noexcept
+{
+  assert (m_ptr);
+  return malc_consumer_acquire (handle());
+}
+/*----------------------------------------------------------------------------*/
+bl_err wrapper::consumer_release() noexcept
+{
+  assert (m_ptr);
+  return malc_consumer_release (handle());
+}
+/*----------------------------------------------------------------------------*/
+bl_err wrapper::run_consume_task_ready() noexcept
+{
+  assert (m_ptr);
+  return malc_run_consume_task_ready (handle());
+}
+/*----------------------------------------------------------------------------*/
 bl_err wrapper::add_destination (size_t& dest_id, malc_dst const& dst) noexcept
 {
   assert (m_ptr);
@@ -1,3 +1,5 @@
+#include <stdio.h>
+
 #include <bl/cmocka_pre.h>
 #include <bl/base/default_allocator.h>
 #include <bl/base/utility.h>
@@ -6,6 +8,10 @@
 #include <malc/malc.h>
 #include <malc/destinations/array.h>
 
+#if defined (BL_LINUX)
+  #include <poll.h>
+#endif
+
 /*----------------------------------------------------------------------------*/
 typedef struct context {
   bl_alloc_tbl    alloc;
@@ -200,6 +206,82 @@ static void tls_allocation (void **state)
   termination_check (c);
 }
 /*----------------------------------------------------------------------------*/
+static void tls_segmented_allocation (void **state)
+{
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread     = false;
+  cfg.alloc.fixed_allocator_bytes   = 0; /* No bounded queue */
+  cfg.alloc.msg_allocator           = nullptr; /* No dynamic allocation */
+  cfg.alloc.tls_segment_bytes       = cfg.alloc.slot_size * 4;
+  cfg.alloc.tls_max_segments        = 2;
+  cfg.alloc.tls_max_total_segments  = 2;
+
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  /* the segment configuration is taken at this point */
+  err = malc_producer_thread_local_init (c->l, cfg.alloc.slot_size);
+  assert_int_equal (err.own, bl_ok);
+
+  bl_uword logged = 0;
+  for (; logged < 64 && !err.own; ++logged) {
+    err = log_warning ("msg");
+  }
+  assert_int_equal (err.own, bl_alloc);
+  --logged;
+  /* more than the TLS buffer own region can hold */
+  assert_true (logged > 1);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+  assert_true (malc_array_dst_size (c->dst) >= logged);
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+#if defined (BL_LINUX)
+static void page_backed_allocation (void **state)
+{
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread       = false;
+  cfg.alloc.fixed_allocator_bytes     = cfg.alloc.slot_size * 4;
+  cfg.alloc.fixed_allocator_max_slots = 1;
+  cfg.alloc.fixed_allocator_per_cpu   = true;
+  cfg.alloc.msg_allocator             = nullptr; /* No dynamic allocation */
+  /* without reserved huge pages this falls back to normal pages */
+  cfg.alloc.buffers_huge_pages        = true;
+  cfg.alloc.buffers_numa_local        = true;
+
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  err = malc_producer_thread_local_init (c->l, cfg.alloc.slot_size);
+  assert_int_equal (err.own, bl_ok);
+
+  /* the first entry goes to the TLS buffer, the rest to the bounded queue */
+  for (bl_uword i = 0; i < 4; ++i) {
+    err = log_warning ("msg{}", i);
+    assert_int_equal (err.own, bl_ok);
+  }
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+
+  assert_int_equal (malc_array_dst_size (c->dst), 4);
+  assert_string_equal (malc_array_dst_get_entry (c->dst, 0), "msg0");
+  assert_string_equal (malc_array_dst_get_entry (c->dst, 3), "msg3");
+
+  termination_check (c);
+}
+#endif
+/*----------------------------------------------------------------------------*/
 static void bounded_allocation (void **state)
 {
   static const bl_uword bounded_size = 128;
@@ -697,9 +779,530 @@ static void flush_test (void **state)
   assert_string_equal (malc_array_dst_get_entry (c->dst, 0), "msg");
 }
 /*----------------------------------------------------------------------------*/
+static void flush_async_test (void **state)
+{
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread = false;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  err = log_warning ("msg1: {}", 1);
+  assert_int_equal (err.own, bl_ok);
+
+  size_t t1, t2;
+  err = malc_flush_async (c->l, &t1);
+  assert_int_equal (err.own, bl_ok);
+  err = malc_flush_async (c->l, &t2);
+  assert_int_equal (err.own, bl_ok);
+  assert_true (t2 > t1);
+  assert_false (malc_is_flushed (c->l, t1));
+  err = malc_wait_flushed (c->l, t2, 0);
+  assert_int_equal (err.own, bl_timeout);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+
+  assert_int_equal (malc_array_dst_size (c->dst), 1);
+  assert_true (malc_is_flushed (c->l, t1));
+  assert_true (malc_is_flushed (c->l, t2));
+  err = malc_wait_flushed (c->l, t2, 0);
+  assert_int_equal (err.own, bl_ok);
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static void backpressure_retry (void **state)
+{
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread       = false;
+  cfg.alloc.fixed_allocator_bytes     = 128; /* bounded queue */
+  cfg.alloc.fixed_allocator_max_slots = 1;
+  cfg.alloc.fixed_allocator_per_cpu   = false;
+  cfg.alloc.msg_allocator             = nullptr; /* No dynamic allocation */
+
+  cfg.producer.backpressure = malc_backpressure_default;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_invalid);
+
+  cfg.producer.backpressure = malc_backpressure_drop;
+  cfg.producer.backpressure_sev[malc_sev_critical - malc_sev_debug] =
+    malc_backpressure_retry;
+  cfg.producer.backpressure_retry_us = 1000;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  /* exhaust the bounded queue */
+  for (bl_uword i = 0; i < 1024 && !err.own; ++i) {
+    err = log_warning ("msg");
+  }
+  assert_int_equal (err.own, bl_alloc);
+
+  /* retries until the time limit, nobody is consuming */
+  err = log_critical ("critical");
+  assert_int_equal (err.own, bl_alloc);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+
+  err = log_critical ("critical");
+  assert_int_equal (err.own, bl_ok);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+
+  bl_uword last = malc_array_dst_size (c->dst) - 1;
+  assert_string_equal (malc_array_dst_get_entry (c->dst, last), "critical");
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static char const* find_entry_with (context* c, char const* str)
+{
+  for (bl_uword i = 0; i < malc_array_dst_size (c->dst); ++i) {
+    if (strstr (malc_array_dst_get_entry (c->dst, i), str)) {
+      return malc_array_dst_get_entry (c->dst, i);
+    }
+  }
+  return nullptr;
+}
+/*----------------------------------------------------------------------------*/
+static void dropped_entries_report (void **state)
+{
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  err = log_warning ("not initialized");
+  assert_int_equal (err.own, bl_preconditions);
+
+  cfg.consumer.start_own_thread       = false;
+  cfg.alloc.fixed_allocator_bytes     = 128; /* bounded queue */
+  cfg.alloc.fixed_allocator_max_slots = 1;
+  cfg.alloc.fixed_allocator_per_cpu   = false;
+  cfg.alloc.msg_allocator             = nullptr; /* No dynamic allocation */
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  bl_uword written = 0;
+  for (; written < 1024 && !err.own; ++written) {
+    err = log_warning ("msg");
+  }
+  assert_int_equal (err.own, bl_alloc);
+  --written;
+  err = log_warning ("msg");
+  assert_int_equal (err.own, bl_alloc);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (malc_array_dst_size (c->dst), written + 2);
+
+  char const* e = find_entry_with (c, "dropped (no memory) since t=");
+  assert_non_null (e);
+  assert_true (strncmp (e, "[malc] 2 entries (", 18) == 0);
+  e = find_entry_with (c, "dropped (not running) since t=");
+  assert_non_null (e);
+  assert_true (strncmp (e, "[malc] 1 entries (", 18) == 0);
+
+  malc_stats stats;
+  err = malc_get_stats (c->l, &stats);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (stats.dropped_entries[malc_drop_no_memory], 2);
+  assert_int_equal (stats.dropped_entries[malc_drop_not_running], 1);
+  assert_int_equal (stats.dropped_entries[malc_drop_too_big], 0);
+  assert_true (stats.dropped_bytes[malc_drop_no_memory] > 0);
+
+  /* only new drops are reported */
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_nothing_to_do);
+  assert_int_equal (malc_array_dst_size (c->dst), written + 2);
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static void bounded_size_classes (void **state)
+{
+  static const bl_u8 dump[320] = { 0 };
+
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  bl_u32 slot = cfg.alloc.slot_size;
+  cfg.consumer.start_own_thread       = false;
+  cfg.alloc.fixed_allocator_max_slots = 8;
+  cfg.alloc.fixed_allocator_per_cpu   = false;
+  cfg.alloc.fixed_allocator_class_bytes[malc_fixed_class_1_slot]  = slot * 2;
+  cfg.alloc.fixed_allocator_class_bytes[malc_fixed_class_4_slots] = 0;
+  cfg.alloc.fixed_allocator_class_bytes[malc_fixed_class_big]     = slot * 8;
+  cfg.alloc.msg_allocator = nullptr; /* No dynamic allocation */
+
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  /* the small entries fill their class... */
+  err = log_warning ("msg{}", 0);
+  assert_int_equal (err.own, bl_ok);
+  err = log_warning ("msg{}", 1);
+  assert_int_equal (err.own, bl_ok);
+  err = log_warning ("msg{}", 2);
+  assert_int_equal (err.own, bl_alloc);
+  /* ...without starving the big ones */
+  err = log_warning ("{}", logmemcpy (dump, sizeof dump));
+  assert_int_equal (err.own, bl_ok);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+
+  /* plus the drop report */
+  assert_int_equal (malc_array_dst_size (c->dst), 4);
+  assert_non_null (find_entry_with (c, "msg0"));
+  assert_non_null (find_entry_with (c, "msg1"));
+
+  malc_stats stats;
+  err = malc_get_stats (c->l, &stats);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (stats.dropped_entries[malc_drop_no_memory], 1);
+  assert_int_equal (stats.dropped_entries[malc_drop_too_big], 0);
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static void large_entry (void **state)
+{
+  static char frame[40000];
+
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  /* bigger than the 256 slots a common entry can have */
+  assert_true (sizeof frame > cfg.alloc.slot_size * 256);
+  memset (frame, 'x', sizeof frame);
+  memcpy (frame, "frame:", 6);
+
+  cfg.consumer.start_own_thread   = false;
+  cfg.alloc.fixed_allocator_bytes = 0; /* No bounded queue */
+  assert_non_null (cfg.alloc.msg_allocator);
+
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  /* from the heap */
+  err = log_warning ("{}", logstrcpy (frame, sizeof frame));
+  assert_int_equal (err.own, bl_ok);
+  /* from a TLS buffer */
+  err = malc_producer_thread_local_init (c->l, sizeof frame * 2);
+  assert_int_equal (err.own, bl_ok);
+  err = log_warning ("{}", logstrcpy (frame, sizeof frame));
+  assert_int_equal (err.own, bl_ok);
+  err = log_warning ("small");
+  assert_int_equal (err.own, bl_ok);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+
+  assert_int_equal (malc_array_dst_size (c->dst), 3);
+  char const* e = malc_array_dst_get_entry (c->dst, 0);
+  assert_true (strncmp (e, "frame:xxxx", 10) == 0);
+  e = malc_array_dst_get_entry (c->dst, 1);
+  assert_true (strncmp (e, "frame:xxxx", 10) == 0);
+  assert_string_equal (malc_array_dst_get_entry (c->dst, 2), "small");
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static void compact_slots (void **state)
+{
+  static const bl_uword tls_size = 1024;
+
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread   = false;
+  cfg.producer.timestamp          = false;
+  cfg.alloc.fixed_allocator_bytes = 0; /* No bounded queue */
+  cfg.alloc.msg_allocator         = nullptr; /* No dynamic allocation */
+
+  cfg.alloc.slot_size = 24;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_invalid);
+  cfg.alloc.slot_size = MALC_MIN_SLOT_SIZE / 2;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_invalid);
+
+  cfg.alloc.slot_size = MALC_MIN_SLOT_SIZE;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+  err = malc_producer_thread_local_init (c->l, tls_size);
+  assert_int_equal (err.own, bl_ok);
+
+  bl_uword written = 0;
+  for (; written < tls_size && !err.own; ++written) {
+    err = log_warning ("msg{}", (int) written);
+  }
+  assert_int_equal (err.own, bl_alloc);
+  --written;
+  /* more entries than the buffer would hold with 64 byte slots */
+  assert_true (written > tls_size / 64);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+  /* the array destination keeps the newest ones, plus the drop report */
+  bl_uword expected = bl_min (written + 1, malc_array_dst_capacity (c->dst));
+  assert_int_equal (malc_array_dst_size (c->dst), expected);
+  char last[32];
+  snprintf (last, sizeof last, "msg%d", (int) written - 1);
+  assert_non_null (find_entry_with (c, last));
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static void prefaulted_buffers (void **state)
+{
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread       = false;
+  cfg.alloc.fixed_allocator_bytes     = 64 * 1024;
+  cfg.alloc.fixed_allocator_max_slots = 2;
+  cfg.alloc.fixed_allocator_per_cpu   = false;
+  cfg.alloc.buffers_prefault          = true;
+  cfg.alloc.buffers_lock              = true;
+  cfg.alloc.msg_allocator             = nullptr; /* No dynamic allocation */
+
+  err = malc_init (c->l, &cfg);
+#if defined (BL_POSIX)
+  assert_int_equal (err.own, bl_ok);
+#else
+  assert_int_equal (err.own, bl_invalid);
+  cfg.alloc.buffers_lock = false;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+#endif
+  malc_stats stats;
+  err = malc_get_stats (c->l, &stats);
+  assert_int_equal (err.own, bl_ok);
+  uint64_t locked = stats.locked_bytes;
+
+  /* the faults might be 0 if the allocator reuses memory already touched */
+  err = malc_producer_thread_local_init (c->l, 64 * 1024);
+  assert_int_equal (err.own, bl_ok);
+  err = malc_get_stats (c->l, &stats);
+  assert_int_equal (err.own, bl_ok);
+  assert_true (stats.locked_bytes >= locked);
+
+  err = log_warning ("msg{}", 1);
+  assert_int_equal (err.own, bl_ok);
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (malc_array_dst_size (c->dst), 1);
+  assert_string_equal (malc_array_dst_get_entry (c->dst, 0), "msg1");
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static void timestamp_delta_test (void **state)
+{
+  context* c = (context*) *state;
+
+  malc_dst_cfg dcfg;
+  dcfg.log_rate_filter_time_ns = 0;
+  dcfg.show_timestamp     = true;
+  dcfg.show_severity      = false;
+  dcfg.severity           = malc_sev_debug;
+  dcfg.severity_file_path = nullptr;
+
+  bl_err err = malc_set_destination_cfg (c->l, &dcfg, c->dst_id);
+  assert_int_equal (err.own, bl_ok);
+
+  malc_cfg cfg;
+  err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread = false;
+  cfg.producer.timestamp        = true;
+  cfg.producer.timestamp_delta  = true;
+
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+  err = malc_producer_thread_local_init (c->l, 64 * 1024);
+  assert_int_equal (err.own, bl_ok);
+
+  /* the first entry is a keyframe, the rest are deltas */
+  bl_uword count = bl_arr_elems (c->lines);
+  for (bl_uword i = 0; i < count; ++i) {
+    err = log_warning ("msg{}", (bl_u32) i);
+    assert_int_equal (err.own, bl_ok);
+  }
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (malc_array_dst_size (c->dst), count);
+
+  /* fixed width timestamps, they compare as strings */
+  bl_uword tstamp_len = strlen ("00000000000.000000000");
+  char expected[32];
+  for (bl_uword i = 0; i < count; ++i) {
+    char const* e = malc_array_dst_get_entry (c->dst, i);
+    assert_true (strlen (e) > tstamp_len);
+    if (i > 0) {
+      char const* prev = malc_array_dst_get_entry (c->dst, i - 1);
+      assert_true (strncmp (prev, e, tstamp_len) <= 0);
+    }
+    snprintf (expected, sizeof expected, "msg%u", (unsigned) i);
+    assert_string_equal (e + strlen (e) - strlen (expected), expected);
+  }
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static void consumer_ownership (void **state)
+{
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread = false;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  err = malc_consumer_release (c->l);
+  assert_int_equal (err.own, bl_preconditions);
+  err = malc_consumer_acquire (c->l);
+  assert_int_equal (err.own, bl_ok);
+  err = malc_consumer_acquire (c->l);
+  assert_int_equal (err.own, bl_ok);
+
+  err = log_warning ("owned");
+  assert_int_equal (err.own, bl_ok);
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (malc_array_dst_size (c->dst), 1);
+  assert_string_equal (malc_array_dst_get_entry (c->dst, 0), "owned");
+
+  /* back to the mutex path */
+  err = malc_consumer_release (c->l);
+  assert_int_equal (err.own, bl_ok);
+  err = log_warning ("released");
+  assert_int_equal (err.own, bl_ok);
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (malc_array_dst_size (c->dst), 2);
+  assert_string_equal (malc_array_dst_get_entry (c->dst, 1), "released");
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+static void priority_queue (void **state)
+{
+  static char const* const expected[] = {
+    "e1", "e2", "w1", "e3", "e4", "w2", "w3", "w4"
+  };
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread    = false;
+  cfg.producer.priority_sev        = malc_sev_error;
+  cfg.consumer.priority_max_streak = 0;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_invalid);
+
+  cfg.consumer.priority_max_streak = 2;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  assert_int_equal (log_warning ("w1").own, bl_ok);
+  assert_int_equal (log_warning ("w2").own, bl_ok);
+  assert_int_equal (log_warning ("w3").own, bl_ok);
+  assert_int_equal (log_warning ("w4").own, bl_ok);
+  assert_int_equal (log_error ("e1").own, bl_ok);
+  assert_int_equal (log_error ("e2").own, bl_ok);
+  assert_int_equal (log_critical ("e3").own, bl_ok);
+  assert_int_equal (log_error ("e4").own, bl_ok);
+
+  err = malc_run_consume_task (c->l, 10000);
+  assert_int_equal (err.own, bl_ok);
+
+  assert_int_equal (malc_array_dst_size (c->dst), bl_arr_elems (expected));
+  for (bl_uword i = 0; i < bl_arr_elems (expected); ++i) {
+    assert_string_equal (malc_array_dst_get_entry (c->dst, i), expected[i]);
+  }
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+#if defined (BL_LINUX)
+/*----------------------------------------------------------------------------*/
+static bool consumer_fd_is_readable (int fd)
+{
+  struct pollfd pfd;
+  pfd.fd      = fd;
+  pfd.events  = POLLIN;
+  pfd.revents = 0;
+  return poll (&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+/*----------------------------------------------------------------------------*/
+static void event_fd_consumer (void **state)
+{
+  context* c = (context*) *state;
+  malc_cfg cfg;
+  bl_err err = malc_get_cfg (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  cfg.consumer.start_own_thread = true;
+  cfg.consumer.wait_strategy    = malc_wait_event_fd;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_invalid);
+
+  cfg.consumer.start_own_thread = false;
+  err = malc_init (c->l, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  int fd = -1;
+  err = malc_get_consumer_fd (c->l, &fd);
+  assert_int_equal (err.own, bl_ok);
+  assert_true (fd >= 0);
+
+  /* arms the idle timer, which is far away */
+  err = malc_run_consume_task_ready (c->l);
+  assert_true (err.own == bl_ok || err.own == bl_nothing_to_do);
+  assert_false (consumer_fd_is_readable (fd));
+
+  err = log_warning ("msg1: {}", 1);
+  assert_int_equal (err.own, bl_ok);
+  assert_true (consumer_fd_is_readable (fd));
+
+  err = malc_run_consume_task_ready (c->l);
+  assert_int_equal (err.own, bl_ok);
+  assert_false (consumer_fd_is_readable (fd));
+
+  assert_int_equal (malc_array_dst_size (c->dst), 1);
+  assert_string_equal (malc_array_dst_get_entry (c->dst, 0), "msg1: 1");
+
+  termination_check (c);
+}
+/*----------------------------------------------------------------------------*/
+#endif /* BL_LINUX */
+/*----------------------------------------------------------------------------*/
 static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown (init_terminate, setup, teardown),
   cmocka_unit_test_setup_teardown (tls_allocation, setup, teardown),
+  cmocka_unit_test_setup_teardown (tls_segmented_allocation, setup, teardown),
   cmocka_unit_test_setup_teardown (bounded_allocation, setup, teardown),
   cmocka_unit_test_setup_teardown (dynamic_allocation, setup, teardown),
   cmocka_unit_test_setup_teardown (own_thread_and_flush, setup, teardown),
@@ -720,6 +1323,20 @@ static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown (volatile_variable_logging, setup, teardown),
   cmocka_unit_test_setup_teardown (timestamp_enabled_test, setup, teardown),
   cmocka_unit_test_setup_teardown (flush_test, setup, teardown),
+  cmocka_unit_test_setup_teardown (flush_async_test, setup, teardown),
+  cmocka_unit_test_setup_teardown (backpressure_retry, setup, teardown),
+  cmocka_unit_test_setup_teardown (dropped_entries_report, setup, teardown),
+  cmocka_unit_test_setup_teardown (bounded_size_classes, setup, teardown),
+  cmocka_unit_test_setup_teardown (large_entry, setup, teardown),
+  cmocka_unit_test_setup_teardown (compact_slots, setup, teardown),
+  cmocka_unit_test_setup_teardown (prefaulted_buffers, setup, teardown),
+  cmocka_unit_test_setup_teardown (timestamp_delta_test, setup, teardown),
+  cmocka_unit_test_setup_teardown (consumer_ownership, setup, teardown),
+  cmocka_unit_test_setup_teardown (priority_queue, setup, teardown),
+#if defined (BL_LINUX)
+  cmocka_unit_test_setup_teardown (page_backed_allocation, setup, teardown),
+  cmocka_unit_test_setup_teardown (event_fd_consumer, setup, teardown),
+#endif
 };
 /*----------------------------------------------------------------------------*/
 int main (void)
@@ -40,30 +40,161 @@ static void boundedb_alloc_dealloc_test (void **state)
   const bl_uword slot_size = 32;
 
   boundedb_context* c = (boundedb_context*) *state;
+  boundedb_class cl = { slot_size * slots, 1, 1 };
   bl_err err = boundedb_reset(
-    &c->b, &c->alloc, slot_size * slots, slot_size, 1, false
+    &c->b, &c->alloc, nullptr, nullptr, &cl, 1, slot_size, false
     );
   assert_int_equal (err.own, bl_ok);
 
   for (bl_uword round = 0; round < 2; ++round) {
     bl_u8* mem[slots];
+    bl_u16 qidx[slots];
+    bl_u32 n;
     for (bl_uword i = 0; i < slots; ++i) {
-      err = boundedb_alloc (&c->b, &mem[i], 1);
+      err = boundedb_alloc (&c->b, &mem[i], &qidx[i], &n, slot_size, 1);
       assert_int_equal (err.own, bl_ok);
+      assert_int_equal (n, 1);
+      assert_int_equal (qidx[i], 0);
     }
     bl_u8* dummy;
-    err = boundedb_alloc (&c->b, &dummy, 1);
+    bl_u16 dummy_qidx;
+    err = boundedb_alloc (&c->b, &dummy, &dummy_qidx, &n, slot_size, 1);
     assert_int_equal (err.own, bl_alloc);
     for (bl_uword i = 0; i < slots; ++i) {
-      boundedb_dealloc (&c->b, mem[i], 1);
+      boundedb_dealloc (&c->b, mem[i], qidx[i], 1);
     }
   }
 }
 /*----------------------------------------------------------------------------*/
+static void boundedb_size_classes_test (void **state)
+{
+  const bl_uword slots     = 8;
+  const bl_uword slot_size = 32;
+
+  boundedb_context* c = (boundedb_context*) *state;
+  boundedb_class cl[] = {
+    { slot_size * slots, 1, 1 },
+    { 0, 2, 4 }, /* disabled */
+    { slot_size * slots, 5, 8 },
+  };
+  bl_err err = boundedb_reset(
+    &c->b,
+    &c->alloc,
+    nullptr,
+    nullptr,
+    cl,
+    bl_arr_elems (cl),
+    slot_size,
+    false
+    );
+  assert_int_equal (err.own, bl_ok);
+
+  /* the small entries exhaust their own queue only */
+  bl_u8* mem[slots];
+  bl_u16 qidx[slots];
+  bl_u32 n;
+  for (bl_uword i = 0; i < slots; ++i) {
+    err = boundedb_alloc (&c->b, &mem[i], &qidx[i], &n, slot_size, 8);
+    assert_int_equal (err.own, bl_ok);
+    assert_int_equal (n, 1);
+    assert_int_equal (qidx[i], 0);
+  }
+  bl_u8* big;
+  bl_u16 big_qidx;
+  err = boundedb_alloc (&c->b, &big, &big_qidx, &n, slot_size * 5, 8);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (n, 5);
+  assert_int_equal (big_qidx, 1); /* the disabled class has no queue */
+  bl_u8* dummy;
+  bl_u16 dummy_qidx;
+  err = boundedb_alloc (&c->b, &dummy, &dummy_qidx, &n, slot_size, 8);
+  assert_int_equal (err.own, bl_alloc);
+  /* disabled class */
+  err = boundedb_alloc (&c->b, &dummy, &dummy_qidx, &n, slot_size * 3, 8);
+  assert_int_equal (err.own, bl_range);
+  /* bigger than the biggest class */
+  err = boundedb_alloc (&c->b, &dummy, &dummy_qidx, &n, slot_size * 9, 16);
+  assert_int_equal (err.own, bl_range);
+  boundedb_dealloc (&c->b, big, big_qidx, 5);
+  for (bl_uword i = 0; i < slots; ++i) {
+    boundedb_dealloc (&c->b, mem[i], qidx[i], 1);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void boundedb_per_cpu_queue_index_test (void **state)
+{
+  const bl_uword slot_size = 32;
+
+  boundedb_context* c = (boundedb_context*) *state;
+  boundedb_class cl[] = {
+    { slot_size * 4, 1, 1 },
+    { slot_size * 8, 2, 4 },
+  };
+  bl_err err = boundedb_reset(
+    &c->b,
+    &c->alloc,
+    nullptr,
+    nullptr,
+    cl,
+    bl_arr_elems (cl),
+    slot_size,
+    true
+    );
+  assert_int_equal (err.own, bl_ok);
+
+  /* the queue index is enough to deallocate, whatever the CPU is now */
+  for (bl_uword slots = 1; slots <= 4; ++slots) {
+    bl_u8* mem;
+    bl_u16 qidx;
+    bl_u32 n;
+    err = boundedb_alloc (&c->b, &mem, &qidx, &n, slot_size * slots, 4);
+    assert_int_equal (err.own, bl_ok);
+    assert_true (qidx < c->b.cpu_count * c->b.class_count);
+    assert_int_equal (qidx % bl_arr_elems (cl), slots == 1 ? 0 : 1);
+    boundedb_dealloc (&c->b, mem, qidx, n);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void boundedb_size_classes_overlap_test (void **state)
+{
+  const bl_uword slot_size = 32;
+
+  boundedb_context* c = (boundedb_context*) *state;
+  boundedb_class cl[] = {
+    { slot_size * 4, 1, 2 },
+    { slot_size * 4, 2, 4 },
+  };
+  bl_err err = boundedb_reset(
+    &c->b,
+    &c->alloc,
+    nullptr,
+    nullptr,
+    cl,
+    bl_arr_elems (cl),
+    slot_size,
+    false
+    );
+  assert_int_equal (err.own, bl_invalid);
+  assert_false (boundedb_is_enabled (&c->b));
+}
+/*----------------------------------------------------------------------------*/
 static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown(
     boundedb_alloc_dealloc_test, boundedb_test_setup, boundedb_test_teardown
     ),
+  cmocka_unit_test_setup_teardown(
+    boundedb_size_classes_test, boundedb_test_setup, boundedb_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    boundedb_per_cpu_queue_index_test,
+    boundedb_test_setup,
+    boundedb_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    boundedb_size_classes_overlap_test,
+    boundedb_test_setup,
+    boundedb_test_teardown
+    ),
 };
 /*----------------------------------------------------------------------------*/
 int bounded_buffer_tests (void)
@@ -16,6 +16,8 @@ typedef struct mock_dest {
   bl_u32 flush;
   bl_u16 idle_task;
   bl_u64 write;
+  bl_u64 write_batch;
+  bl_u64 batch_entries;
 }
 mock_dest;
 /*----------------------------------------------------------------------------*/
@@ -55,6 +57,16 @@ static bl_err mock_dest_write(
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
+static bl_err mock_dest_write_batch(
+  void* instance, malc_log_entry_batch const* b
+  )
+{
+  mock_dest* d = (mock_dest*) instance;
+  ++d->write_batch;
+  d->batch_entries += b->count;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
 static const malc_dst mock_dst_tbl = {
   sizeof (mock_dest),
   &mock_dest_init,
@@ -62,6 +74,7 @@ static const malc_dst mock_dst_tbl = {
   &mock_dest_flush,
   &mock_dest_idle_task,
   &mock_dest_write,
+  nullptr, /* write batch */
 };
 /*----------------------------------------------------------------------------*/
 typedef struct destinations_context {
@@ -210,6 +223,47 @@ static void destinations_write_sev_test (void **state)
   assert_int_equal (mock[1]->write, 2);
 }
 /*----------------------------------------------------------------------------*/
+static void destinations_write_batch_test (void **state)
+{
+  destinations_context* c = (destinations_context*) *state;
+  size_t           id[2];
+  mock_dest*       mock[2];
+  malc_dst_cfg     cfg;
+  bl_err           err;
+  malc_log_strings strings;
+  log_batch        b;
+
+  memset (&strings, 0, sizeof strings);
+  strings.text     = "a";
+  strings.text_len = 1;
+
+  c->tbls[0].write_batch = &mock_dest_write_batch;
+  destinations_do_add (c, id, mock);
+
+  err = destinations_get_cfg (&c->d, &cfg, id[0]);
+  assert_int_equal (bl_ok, err.own);
+  cfg.severity = malc_sev_critical;
+  err = destinations_set_cfg (&c->d, &cfg, id[0]);
+  assert_int_equal (bl_ok, err.own);
+
+  log_batch_init (&b);
+  err = log_batch_reset (&b, 4, 64, &c->alloc);
+  assert_int_equal (bl_ok, err.own);
+  assert_true (log_batch_push (&b, 0, 0, malc_sev_error, &strings));
+  assert_true (log_batch_push (&b, 1, 0, malc_sev_critical, &strings));
+  assert_true (log_batch_push (&b, 2, 0, malc_sev_critical, &strings));
+
+  destinations_write_batch (&c->d, &b);
+  /* one call with the entries passing the severity filter */
+  assert_int_equal (mock[0]->write_batch, 1);
+  assert_int_equal (mock[0]->batch_entries, 2);
+  assert_int_equal (mock[0]->write, 0);
+  /* no "write_batch": fallback to "write" */
+  assert_int_equal (mock[1]->write_batch, 0);
+  assert_int_equal (mock[1]->write, 3);
+  log_batch_destroy (&b, &c->alloc);
+}
+/*----------------------------------------------------------------------------*/
 static void write_sev_file (char const* text)
 {
   FILE* f = fopen (SEV_FILE_NAME, "wb");
@@ -395,6 +449,9 @@ static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown(
     destinations_write_sev_test, dsts_test_setup, dsts_test_teardown
     ),
+  cmocka_unit_test_setup_teardown(
+    destinations_write_batch_test, dsts_test_setup, dsts_test_teardown
+    ),
   cmocka_unit_test_setup_teardown(
     destinations_write_rate_filter_test, dsts_test_setup, dsts_test_teardown
     ),
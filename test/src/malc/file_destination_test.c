@@ -139,6 +139,59 @@ static void file_dst_rotation (void **state)
   cmp_file_content (FILE_PREFIX"_2", "123\n");
 }
 /*----------------------------------------------------------------------------*/
+static void file_dst_batch (void **state)
+{
+  file_dst_context* c = (file_dst_context*) *state;
+
+  malc_file_cfg cfg;
+  cfg.prefix          = FILE_PREFIX;
+  cfg.suffix          = nullptr;
+  cfg.max_file_size   = 0;
+  cfg.max_log_files   = 0;
+  cfg.time_based_name = false;
+  cfg.can_remove_old_data_on_full_disk = true;
+  bl_err err = malc_file_set_cfg (c->fd, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  malc_log_entry e[2] = {
+    { 0, 0, MALC_LOG_STRS_INITIALIZER ("1", "2", "3") },
+    { 0, 0, MALC_LOG_STRS_INITIALIZER ("4", "5", "6") },
+  };
+  malc_log_entry_batch b = { e, bl_arr_elems (e) };
+  err = malc_file_dst_tbl.write_batch ((void*) c->fd, &b);
+  assert_int_equal (err.own, bl_ok);
+  malc_file_dst_tbl.terminate ((void*) c->fd); /* force file creation*/
+
+  cmp_file_content (FILE_PREFIX"_0", "123\n456\n");
+}
+/*----------------------------------------------------------------------------*/
+static void file_dst_batch_segments (void **state)
+{
+  file_dst_context* c = (file_dst_context*) *state;
+
+  malc_file_cfg cfg;
+  cfg.prefix          = FILE_PREFIX;
+  cfg.suffix          = nullptr;
+  cfg.max_file_size   = 1;
+  cfg.max_log_files   = 0;
+  cfg.time_based_name = false;
+  cfg.can_remove_old_data_on_full_disk = true;
+  bl_err err = malc_file_set_cfg (c->fd, &cfg);
+  assert_int_equal (err.own, bl_ok);
+
+  malc_log_entry e[2] = {
+    { 0, 0, MALC_LOG_STRS_INITIALIZER ("1", "2", "3") },
+    { 0, 0, MALC_LOG_STRS_INITIALIZER ("4", "5", "6") },
+  };
+  malc_log_entry_batch b = { e, bl_arr_elems (e) };
+  err = malc_file_dst_tbl.write_batch ((void*) c->fd, &b);
+  assert_int_equal (err.own, bl_ok);
+  malc_file_dst_tbl.terminate ((void*) c->fd); /* force file creation*/
+
+  cmp_file_content (FILE_PREFIX"_0", "123\n");
+  cmp_file_content (FILE_PREFIX"_1", "456\n");
+}
+/*----------------------------------------------------------------------------*/
 static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown(
     file_dst_basic, file_dst_test_setup, file_dst_test_teardown
@@ -149,6 +202,12 @@ static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown(
     file_dst_rotation, file_dst_test_setup, file_dst_test_teardown
     ),
+  cmocka_unit_test_setup_teardown(
+    file_dst_batch, file_dst_test_setup, file_dst_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    file_dst_batch_segments, file_dst_test_setup, file_dst_test_teardown
+    ),
 };
 /*----------------------------------------------------------------------------*/
 int file_dst_tests (void)
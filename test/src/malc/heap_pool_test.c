@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include <bl/cmocka_pre.h>
+
+#include <malc/heap_pool.h>
+
+#include <bl/base/default_allocator.h>
+#include <bl/base/integer.h>
+#include <bl/base/utility.h>
+
+/*----------------------------------------------------------------------------*/
+typedef struct heap_pool_context {
+  bl_alloc_tbl alloc;
+  heap_pool    p;
+}
+heap_pool_context;
+/*----------------------------------------------------------------------------*/
+static int heap_pool_test_setup (void **state)
+{
+  static heap_pool_context c;
+  memset (&c, 0, sizeof c);
+  c.alloc    = bl_get_default_alloc();
+  bl_err err = heap_pool_init (&c.p, &c.alloc, 4 * heap_pool_max_block_bytes);
+  *state     = (void*) &c;
+  return err.own;
+}
+/*----------------------------------------------------------------------------*/
+static int heap_pool_test_teardown (void **state)
+{
+  heap_pool_context* c = (heap_pool_context*) *state;
+  heap_pool_destroy (&c->p);
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static void heap_pool_recycle_test (void **state)
+{
+  heap_pool_context* c = (heap_pool_context*) *state;
+  bl_u8* a = (bl_u8*) bl_alloc (&c->p.tbl, 100);
+  assert_non_null (a);
+  memset (a, 0xaa, 100);
+  assert_int_equal (heap_pool_bytes (&c->p), 128);
+  bl_dealloc (&c->p.tbl, a);
+  assert_int_equal (heap_pool_bytes (&c->p), 128);
+
+  /* same class: the block comes back */
+  bl_u8* b = (bl_u8*) bl_alloc (&c->p.tbl, 90);
+  assert_ptr_equal (a, b);
+  /* another class: new block */
+  bl_u8* d = (bl_u8*) bl_alloc (&c->p.tbl, 200);
+  assert_non_null (d);
+  assert_true (b != d);
+  assert_int_equal (heap_pool_bytes (&c->p), 128 + 256);
+  bl_dealloc (&c->p.tbl, b);
+  bl_dealloc (&c->p.tbl, d);
+}
+/*----------------------------------------------------------------------------*/
+static void heap_pool_lifo_test (void **state)
+{
+  heap_pool_context* c = (heap_pool_context*) *state;
+  void* mem[4];
+  for (bl_uword i = 0; i < bl_arr_elems (mem); ++i) {
+    mem[i] = bl_alloc (&c->p.tbl, 40);
+    assert_non_null (mem[i]);
+  }
+  for (bl_uword i = 0; i < bl_arr_elems (mem); ++i) {
+    bl_dealloc (&c->p.tbl, mem[i]);
+  }
+  /* all the remote list is taken at once */
+  for (bl_uword i = bl_arr_elems (mem); i-- > 0;) {
+    assert_ptr_equal (bl_alloc (&c->p.tbl, 40), mem[i]);
+  }
+  assert_int_equal (heap_pool_bytes (&c->p), bl_arr_elems (mem) * 64);
+  for (bl_uword i = 0; i < bl_arr_elems (mem); ++i) {
+    bl_dealloc (&c->p.tbl, mem[i]);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void heap_pool_cap_test (void **state)
+{
+  heap_pool_context* c = (heap_pool_context*) *state;
+  const bl_uword big   = heap_pool_max_block_bytes / 2;
+  void* mem[5];
+  for (bl_uword i = 0; i < bl_arr_elems (mem); ++i) {
+    mem[i] = bl_alloc (&c->p.tbl, big);
+    assert_non_null (mem[i]);
+    memset (mem[i], 0x55, big);
+  }
+  /* the last one doesn't fit on the cap */
+  assert_int_equal (heap_pool_bytes (&c->p), 4 * heap_pool_max_block_bytes);
+  /* bigger than the biggest class: from the parent */
+  void* huge = bl_alloc (&c->p.tbl, heap_pool_max_block_bytes);
+  assert_non_null (huge);
+  assert_int_equal (heap_pool_bytes (&c->p), 4 * heap_pool_max_block_bytes);
+  bl_dealloc (&c->p.tbl, huge);
+  for (bl_uword i = 0; i < bl_arr_elems (mem); ++i) {
+    bl_dealloc (&c->p.tbl, mem[i]);
+  }
+  assert_int_equal (heap_pool_bytes (&c->p), 4 * heap_pool_max_block_bytes);
+}
+/*----------------------------------------------------------------------------*/
+static void heap_pool_disabled_test (void **state)
+{
+  heap_pool_context* c = (heap_pool_context*) *state;
+  heap_pool_set_max_bytes (&c->p, 0);
+  void* mem = bl_alloc (&c->p.tbl, 64);
+  assert_non_null (mem);
+  assert_int_equal (heap_pool_bytes (&c->p), 0);
+  bl_dealloc (&c->p.tbl, mem);
+}
+/*----------------------------------------------------------------------------*/
+static const struct CMUnitTest tests[] = {
+  cmocka_unit_test_setup_teardown(
+    heap_pool_recycle_test, heap_pool_test_setup, heap_pool_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    heap_pool_lifo_test, heap_pool_test_setup, heap_pool_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    heap_pool_cap_test, heap_pool_test_setup, heap_pool_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    heap_pool_disabled_test, heap_pool_test_setup, heap_pool_test_teardown
+    ),
+};
+/*----------------------------------------------------------------------------*/
+int heap_pool_tests (void)
+{
+  return cmocka_run_group_tests (tests, nullptr, nullptr);
+}
+/*----------------------------------------------------------------------------*/
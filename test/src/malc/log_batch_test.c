@@ -0,0 +1,131 @@
+#include <string.h>
+
+#include <bl/cmocka_pre.h>
+#include <bl/base/default_allocator.h>
+#include <bl/base/utility.h>
+
+#include <malc/log_batch.h>
+
+/*----------------------------------------------------------------------------*/
+typedef struct log_batch_context {
+  bl_alloc_tbl alloc;
+  log_batch    b;
+}
+log_batch_context;
+/*----------------------------------------------------------------------------*/
+static int log_batch_test_setup (void **state)
+{
+  static log_batch_context c;
+  c.alloc = bl_get_default_alloc();
+  log_batch_init (&c.b);
+  bl_err err = log_batch_reset (&c.b, 2, 16, &c.alloc);
+  assert_int_equal (bl_ok, err.own);
+  *state = &c;
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static int log_batch_test_teardown (void **state)
+{
+  log_batch_context* c = (log_batch_context*) *state;
+  log_batch_destroy (&c->b, &c->alloc);
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static malc_log_strings get_strings (char* ts, char* sev, char* text)
+{
+  malc_log_strings s;
+  s.timestamp     = ts;
+  s.timestamp_len = strlen (ts);
+  s.sev           = sev;
+  s.sev_len       = strlen (sev);
+  s.text          = text;
+  s.text_len      = strlen (text);
+  return s;
+}
+/*----------------------------------------------------------------------------*/
+static void log_batch_disabled_test (void **state)
+{
+  log_batch_context* c = (log_batch_context*) *state;
+  bl_err err = log_batch_reset (&c->b, 1, 16, &c->alloc);
+  assert_int_equal (bl_ok, err.own);
+  assert_false (log_batch_is_enabled (&c->b));
+}
+/*----------------------------------------------------------------------------*/
+static void log_batch_push_copies_test (void **state)
+{
+  log_batch_context* c = (log_batch_context*) *state;
+  char ts[]   = "1.0";
+  char sev[]  = "[e]";
+  char text[] = "abc";
+  malc_log_strings s = get_strings (ts, sev, text);
+
+  assert_true (log_batch_is_enabled (&c->b));
+  assert_true (log_batch_push (&c->b, 7, 9, malc_sev_error, &s));
+  /* the batch has to be independent of the source buffers */
+  memset (ts, 0, sizeof ts);
+  memset (sev, 0, sizeof sev);
+  memset (text, 0, sizeof text);
+
+  assert_int_equal (1, log_batch_size (&c->b));
+  malc_log_entry const* e = &c->b.entries[0];
+  assert_int_equal (7, c->b.entry_ids[0]);
+  assert_int_equal (9, e->nsec);
+  assert_int_equal (malc_sev_error, e->sev_val);
+  assert_memory_equal ("1.0", e->strs.timestamp, e->strs.timestamp_len);
+  assert_memory_equal ("[e]", e->strs.sev, e->strs.sev_len);
+  assert_memory_equal ("abc", e->strs.text, e->strs.text_len);
+}
+/*----------------------------------------------------------------------------*/
+static void log_batch_full_test (void **state)
+{
+  log_batch_context* c = (log_batch_context*) *state;
+  char str[] = "a";
+  malc_log_strings s = get_strings (str, str, str);
+
+  assert_true (log_batch_push (&c->b, 0, 0, malc_sev_error, &s));
+  assert_false (log_batch_is_full (&c->b));
+  assert_true (log_batch_push (&c->b, 0, 0, malc_sev_error, &s));
+  assert_true (log_batch_is_full (&c->b));
+  log_batch_clear (&c->b);
+  assert_int_equal (0, log_batch_size (&c->b));
+  assert_false (log_batch_is_full (&c->b));
+}
+/*----------------------------------------------------------------------------*/
+static void log_batch_arena_exhausted_test (void **state)
+{
+  log_batch_context* c = (log_batch_context*) *state;
+  char ts[]   = "12345";
+  char sev[]  = "12345";
+  char text[] = "12345";
+  malc_log_strings s = get_strings (ts, sev, text);
+
+  /* 15 bytes of 16 */
+  assert_true (log_batch_push (&c->b, 0, 0, malc_sev_error, &s));
+  assert_false (log_batch_push (&c->b, 0, 0, malc_sev_error, &s));
+  assert_int_equal (1, log_batch_size (&c->b));
+  log_batch_clear (&c->b);
+  assert_true (log_batch_push (&c->b, 0, 0, malc_sev_error, &s));
+}
+/*----------------------------------------------------------------------------*/
+static const struct CMUnitTest tests[] = {
+  cmocka_unit_test_setup_teardown(
+    log_batch_disabled_test, log_batch_test_setup, log_batch_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    log_batch_push_copies_test, log_batch_test_setup, log_batch_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    log_batch_full_test, log_batch_test_setup, log_batch_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    log_batch_arena_exhausted_test,
+    log_batch_test_setup,
+    log_batch_test_teardown
+    ),
+};
+/*----------------------------------------------------------------------------*/
+int log_batch_tests (void)
+{
+  return cmocka_run_group_tests (tests, nullptr, nullptr);
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,128 @@
+#include <bl/cmocka_pre.h>
+#include <bl/base/default_allocator.h>
+#include <bl/base/utility.h>
+
+#include <malc/reorder_buffer.h>
+
+/*----------------------------------------------------------------------------*/
+typedef struct reorder_buffer_context {
+  bl_alloc_tbl   alloc;
+  reorder_buffer rb;
+  int            nodes[8];
+}
+reorder_buffer_context;
+/*----------------------------------------------------------------------------*/
+static int reorder_buffer_test_setup (void **state)
+{
+  static reorder_buffer_context c;
+  c.alloc = bl_get_default_alloc();
+  reorder_buffer_init (&c.rb);
+  bl_err err = reorder_buffer_reset (&c.rb, 4, 100, &c.alloc);
+  assert_int_equal (bl_ok, err.own);
+  *state = &c;
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static int reorder_buffer_test_teardown (void **state)
+{
+  reorder_buffer_context* c = (reorder_buffer_context*) *state;
+  while (reorder_buffer_pop (&c->rb)) {}
+  reorder_buffer_destroy (&c->rb, &c->alloc);
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static void reorder_buffer_disabled_test (void **state)
+{
+  reorder_buffer_context* c = (reorder_buffer_context*) *state;
+  bl_err err = reorder_buffer_reset (&c->rb, 0, 100, &c->alloc);
+  assert_int_equal (bl_ok, err.own);
+  assert_false (reorder_buffer_is_enabled (&c->rb));
+}
+/*----------------------------------------------------------------------------*/
+static void reorder_buffer_orders_test (void **state)
+{
+  reorder_buffer_context* c = (reorder_buffer_context*) *state;
+  assert_true (reorder_buffer_push (&c->rb, 30, &c->nodes[0]));
+  assert_true (reorder_buffer_push (&c->rb, 10, &c->nodes[1]));
+  assert_true (reorder_buffer_push (&c->rb, 20, &c->nodes[2]));
+  assert_true (reorder_buffer_push (&c->rb, 10, &c->nodes[3]));
+  assert_int_equal (4, reorder_buffer_size (&c->rb));
+  /* same timestamp: insertion order */
+  assert_ptr_equal (&c->nodes[1], reorder_buffer_pop (&c->rb));
+  assert_ptr_equal (&c->nodes[3], reorder_buffer_pop (&c->rb));
+  assert_ptr_equal (&c->nodes[2], reorder_buffer_pop (&c->rb));
+  assert_ptr_equal (&c->nodes[0], reorder_buffer_pop (&c->rb));
+  assert_ptr_equal (nullptr, reorder_buffer_pop (&c->rb));
+}
+/*----------------------------------------------------------------------------*/
+static void reorder_buffer_window_test (void **state)
+{
+  reorder_buffer_context* c = (reorder_buffer_context*) *state;
+  assert_true (reorder_buffer_push (&c->rb, 50, &c->nodes[0]));
+  assert_true (reorder_buffer_push (&c->rb, 100, &c->nodes[1]));
+  /* inside the window */
+  assert_ptr_equal (nullptr, reorder_buffer_pop_ready (&c->rb, 0));
+  assert_ptr_equal (nullptr, reorder_buffer_pop_ready (&c->rb, 149));
+  /* newer timestamps release the older entries */
+  assert_true (reorder_buffer_push (&c->rb, 150, &c->nodes[2]));
+  assert_ptr_equal (&c->nodes[0], reorder_buffer_pop_ready (&c->rb, 0));
+  assert_ptr_equal (nullptr, reorder_buffer_pop_ready (&c->rb, 0));
+  /* so does the current time */
+  assert_ptr_equal (&c->nodes[1], reorder_buffer_pop_ready (&c->rb, 200));
+  assert_ptr_equal (nullptr, reorder_buffer_pop_ready (&c->rb, 200));
+  assert_int_equal (1, reorder_buffer_size (&c->rb));
+}
+/*----------------------------------------------------------------------------*/
+static void reorder_buffer_full_test (void **state)
+{
+  reorder_buffer_context* c = (reorder_buffer_context*) *state;
+  for (uword i = 0; i < 4; ++i) {
+    assert_true (reorder_buffer_push (&c->rb, 10 - i, &c->nodes[i]));
+  }
+  assert_ptr_equal (&c->nodes[3], reorder_buffer_pop_ready (&c->rb, 0));
+  assert_ptr_equal (nullptr, reorder_buffer_pop_ready (&c->rb, 0));
+}
+/*----------------------------------------------------------------------------*/
+static void reorder_buffer_late_test (void **state)
+{
+  reorder_buffer_context* c = (reorder_buffer_context*) *state;
+  assert_true (reorder_buffer_push (&c->rb, 20, &c->nodes[0]));
+  assert_ptr_equal (&c->nodes[0], reorder_buffer_pop (&c->rb));
+  assert_false (reorder_buffer_push (&c->rb, 19, &c->nodes[1]));
+  assert_true (reorder_buffer_push (&c->rb, 20, &c->nodes[1]));
+  assert_int_equal (1, reorder_buffer_size (&c->rb));
+}
+/*----------------------------------------------------------------------------*/
+static const struct CMUnitTest tests[] = {
+  cmocka_unit_test_setup_teardown(
+    reorder_buffer_disabled_test,
+    reorder_buffer_test_setup,
+    reorder_buffer_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    reorder_buffer_orders_test,
+    reorder_buffer_test_setup,
+    reorder_buffer_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    reorder_buffer_window_test,
+    reorder_buffer_test_setup,
+    reorder_buffer_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    reorder_buffer_full_test,
+    reorder_buffer_test_setup,
+    reorder_buffer_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    reorder_buffer_late_test,
+    reorder_buffer_test_setup,
+    reorder_buffer_test_teardown
+    ),
+};
+/*----------------------------------------------------------------------------*/
+int reorder_buffer_tests (void)
+{
+  return cmocka_run_group_tests (tests, nullptr, nullptr);
+}
+/*----------------------------------------------------------------------------*/
@@ -11,6 +11,7 @@
 #include <malc/malc.h>
 #include <malc/alltypes.h>
 #include <malc/serialization.h>
+#include <malc/timestamp_delta.h>
 
 /*----------------------------------------------------------------------------*/
 #define SER_TEST_GET_ENTRY(var, ...)\
@@ -553,6 +554,177 @@ static void serialization_test_all (void **state)
   assert_ptr_equal (le.refdtor.context, d.context);
 }
 /*----------------------------------------------------------------------------*/
+/* "group_varint" decodes groups of 4 32-bit integers at once, the last group
+is decoded field by field when the entry ends less than 16 bytes after it */
+static void serialization_test_int_group (void **state)
+{
+  ser_deser_context* c = (ser_deser_context*) *state;
+  bl_i32 a = -1;
+  bl_u32 b = 0xffffffff;
+  bl_i32 d = -92 * 255 * 255;
+  bl_u32 e = 0;
+  bl_i32 f = 92;
+  bl_i64 g = -92 * ((bl_i64) 1 << 40);
+  malc_const_entry const* entry;
+  SER_TEST_GET_ENTRY (entry, a, b, d, e, f, g);
+  MALC_LOG_TEST_DECLARE_TMP_VARIABLES (a, b, d, e, f, g);
+  malc_serializer ser = get_external_serializer (c, entry);
+  malc_serialize (&ser, I);
+  malc_serialize (&ser, II);
+  malc_serialize (&ser, III);
+  malc_serialize (&ser, IIII);
+  malc_serialize (&ser, IIIII);
+  malc_serialize (&ser, IIIIII);
+  bl_u8* ends[] = { c->buff + sizeof c->buff, ser.field_mem };
+  for (bl_uword i = 0; i < bl_arr_elems (ends); ++i) {
+    deserializer_reset (&c->deser);
+    bl_err err = deserializer_execute(
+      &c->deser, c->buff, ends[i], false, &c->alloc
+      );
+    assert_int_equal (err.own, bl_ok);
+    log_entry le = deserializer_get_log_entry (&c->deser);
+    assert_ptr_equal (entry, le.entry);
+    assert_int_equal (6, le.args_count);
+    assert_true ((bl_i32) le.args[0].vu32 == a);
+    assert_true (le.args[1].vu32 == b);
+    assert_true ((bl_i32) le.args[2].vu32 == d);
+    assert_true (le.args[3].vu32 == e);
+    assert_true ((bl_i32) le.args[4].vu32 == f);
+    assert_true ((bl_i64) le.args[5].vu64 == g);
+  }
+}
+/*----------------------------------------------------------------------------*/
+/* keyframe, 16-bit delta, 32-bit delta and a keyframe for a negative delta */
+static void serialization_test_timestamp_delta (void **state)
+{
+  ser_deser_context* c = (ser_deser_context*) *state;
+  bl_u32 v = 92;
+  malc_const_entry const* entry;
+  SER_TEST_GET_ENTRY (entry, v);
+  bl_timept64 t[] = {
+    1000000, 1000000 + 0xffff, 1000000 + 0xffff + 0x10000, 5
+  };
+  bl_uword formats[] = { ts_delta_key, ts_delta_16, ts_delta_32, ts_delta_key };
+  bl_timept64       base = 0;
+  ts_delta_producer p;
+  ts_delta_producer_init (&p, 0);
+  for (bl_uword i = 0; i < bl_arr_elems (t); ++i) {
+    bl_u64 d;
+    assert_int_equal (ts_delta_producer_format (&p, t[i], &d), formats[i]);
+    ts_delta_producer_commit (&p, t[i], formats[i]);
+    serializer se;
+    serializer_init (&se, entry, true);
+    serializer_set_timestamp (&se, d, ts_delta_format_bytes (formats[i]));
+    malc_serializer ser = serializer_prepare_external_serializer(
+      &se, c->buff, c->buff
+      );
+    malc_serialize (&ser, malc_type_transform (v));
+    deserializer_reset (&c->deser);
+    deserializer_set_timestamp_base(
+      &c->deser, &base, ts_delta_format_bytes (formats[i])
+      );
+    bl_err err = deserializer_execute(
+      &c->deser, c->buff, c->buff + sizeof c->buff, true, &c->alloc
+      );
+    assert_int_equal (err.own, bl_ok);
+    assert_true (base == t[i]);
+    assert_true (c->deser.t == bl_fast_timept_to_nsec (t[i]));
+    log_entry le = deserializer_get_log_entry (&c->deser);
+    assert_int_equal (1, le.args_count);
+    assert_true (le.args[0].vu32 == v);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void serialization_test_callsite (void **state)
+{
+  ser_deser_context* c = (ser_deser_context*) *state;
+  bl_u32 v = 92;
+  malc_const_entry const* entry;
+  SER_TEST_GET_ENTRY (entry, v);
+  /* a copy without id cache, as if it wasn't created by the macros */
+  malc_const_entry unregistered = *entry;
+  unregistered.callsite         = nullptr;
+
+  serializer se;
+  serializer_init (&se, entry, false);
+  bl_uword id = se.entry_id;
+  assert_true (id != callsite_no_id);
+  assert_int_equal (se.internal_fields_size, sizeof (bl_u16));
+  serializer_init (&se, entry, false);
+  assert_int_equal (se.entry_id, id);
+
+  malc_const_entry const* entries[] = { entry, &unregistered };
+  for (bl_uword i = 0; i < bl_arr_elems (entries); ++i) {
+    malc_serializer ser = get_external_serializer (c, entries[i]);
+    malc_serialize (&ser, malc_type_transform (v));
+    deserializer_reset (&c->deser);
+    bl_err err = deserializer_execute(
+      &c->deser, c->buff, c->buff + sizeof c->buff, false, &c->alloc
+      );
+    assert_int_equal (err.own, bl_ok);
+    log_entry le = deserializer_get_log_entry (&c->deser);
+    assert_ptr_equal (entries[i], le.entry);
+    assert_int_equal (le.entry_id, i == 0 ? id : callsite_no_id);
+    assert_int_equal (1, le.args_count);
+    assert_true (le.args[0].vu32 == v);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void serialization_test_decode_plan (void **state)
+{
+  ser_deser_context* c = (ser_deser_context*) *state;
+  bl_u8  v8  = 92;
+  bl_i16 v16 = -1234;
+  bl_u32 v32 = 0x12345678;
+  bl_u64 v64 = 0x1234567812345678ull;
+  double vd  = 1.5;
+  malc_const_entry const* entry;
+  SER_TEST_GET_ENTRY (entry, v8, v16, v32, v64, vd);
+  /* a copy without callsite id goes through the generic decoder */
+  malc_const_entry unregistered = *entry;
+  unregistered.callsite         = nullptr;
+
+  log_argument args[2][5];
+  malc_const_entry const* entries[] = { &unregistered, entry, entry };
+  for (bl_uword i = 0; i < bl_arr_elems (entries); ++i) {
+    malc_serializer ser = get_external_serializer (c, entries[i]);
+    malc_serialize (&ser, v8);
+    malc_serialize (&ser, v16);
+    malc_serialize (&ser, malc_type_transform (v32));
+    malc_serialize (&ser, malc_type_transform (v64));
+    malc_serialize (&ser, vd);
+    deserializer_reset (&c->deser);
+    bl_err err = deserializer_execute(
+      &c->deser, c->buff, ser.field_mem, false, &c->alloc
+      );
+    assert_int_equal (err.own, bl_ok);
+    log_entry le = deserializer_get_log_entry (&c->deser);
+    assert_ptr_equal (entries[i], le.entry);
+    assert_int_equal (5, le.args_count);
+    /* the 32/64-bit integers are variable width with compressed builtins */
+    bool planned = i != 0 && MALC_BUILTIN_COMPRESSION == 0;
+    assert_int_equal (le.args == c->deser.plan_args, planned);
+    memcpy (args[i != 0], le.args, sizeof args[0]);
+    assert_true (args[i != 0][0].vu8 == v8);
+    assert_true (args[i != 0][1].vi16 == v16);
+    assert_true (args[i != 0][2].vu32 == v32);
+    assert_true (args[i != 0][3].vu64 == v64);
+    assert_true (args[i != 0][4].vdouble == vd);
+    /* truncated */
+    deserializer_reset (&c->deser);
+    err = deserializer_execute(
+      &c->deser, c->buff, ser.field_mem - 1, false, &c->alloc
+      );
+    assert_int_equal (err.own, bl_invalid);
+  }
+  /* both decoders agree */
+  assert_true (args[0][0].vu8 == args[1][0].vu8);
+  assert_true (args[0][1].vi16 == args[1][1].vi16);
+  assert_true (args[0][2].vu32 == args[1][2].vu32);
+  assert_true (args[0][3].vu64 == args[1][3].vu64);
+  assert_true (args[0][4].vdouble == args[1][4].vdouble);
+}
+/*----------------------------------------------------------------------------*/
 static void serialization_test_small_buffer (void **state)
 {
   ser_deser_context* c = (ser_deser_context*) *state;
@@ -620,6 +792,18 @@ static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown(
     serialization_test_all, ser_test_setup, ser_test_teardown
     ),
+  cmocka_unit_test_setup_teardown(
+    serialization_test_int_group, ser_test_setup, ser_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    serialization_test_timestamp_delta, ser_test_setup, ser_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    serialization_test_callsite, ser_test_setup, ser_test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    serialization_test_decode_plan, ser_test_setup, ser_test_teardown
+    ),
   cmocka_unit_test_setup_teardown(
     serialization_test_small_buffer, ser_test_setup, ser_test_teardown
     ),
@@ -8,6 +8,10 @@ extern int entry_parser_tests (void);
 extern int array_dst_tests (void);
 extern int file_dst_tests (void);
 extern int destinations_tests (void);
+extern int log_batch_tests (void);
+extern int reorder_buffer_tests (void);
+extern int heap_pool_tests (void);
+extern int tsc_tests (void);
 
 int main (void)
 {
@@ -20,6 +24,10 @@ int main (void)
   if (array_dst_tests() != 0)      { ++failed; }
   if (file_dst_tests() != 0)       { ++failed; }
   if (destinations_tests() != 0)   { ++failed; }
+  if (log_batch_tests() != 0)      { ++failed; }
+  if (reorder_buffer_tests() != 0) { ++failed; }
+  if (heap_pool_tests() != 0)      { ++failed; }
+  if (tsc_tests() != 0)            { ++failed; }
 
   printf ("\n[SUITE ERR ] %d suite(s)\n", failed);
   bl_time_extras_destroy();
@@ -6,6 +6,7 @@
 #include <malc/test_allocator.h>
 
 #include <bl/base/allocator.h>
+#include <bl/base/default_allocator.h>
 #include <bl/base/integer.h>
 #include <bl/base/utility.h>
 #include <bl/base/static_integer_math.h>
@@ -14,9 +15,12 @@ static const bl_uword tls_buff_slots     = 4;
 static const bl_uword tls_buff_slot_size = 32;
 /*----------------------------------------------------------------------------*/
 typedef struct tls_context {
-  alloc_data  alloc;
-  bl_u8       buffer[sizeof (tls_buffer) + 1024];
-  tls_buffer* t;
+  alloc_data   alloc;
+  bl_u8        buffer[sizeof (tls_buffer) + 1024];
+  tls_buffer*  t;
+  bl_alloc_tbl seg_alloc;
+  bl_uword     seg_gets;
+  tls_segment* retired;
 }
 tls_context;
 /*----------------------------------------------------------------------------*/
@@ -24,8 +28,11 @@ static int tls_test_setup (void **state)
 {
   static tls_context c;
   memset (c.buffer, 0, sizeof c.buffer);
-  c.t     = nullptr;
-  c.alloc = alloc_data_init (c.buffer);
+  c.t         = nullptr;
+  c.alloc     = alloc_data_init (c.buffer);
+  c.seg_alloc = bl_get_default_alloc();
+  c.seg_gets  = 0;
+  c.retired   = nullptr;
   *state  = (void*) &c;
   return 0;
 }
@@ -35,12 +42,114 @@ static int tls_test_init_setup (void **state)
   tls_test_setup (state);
   tls_context* c = (tls_context*) *state;
   bl_err err = tls_buffer_init(
-    &c->t, tls_buff_slot_size, tls_buff_slots, &c->alloc.alloc, nullptr, nullptr
+    &c->t,
+    tls_buff_slot_size,
+    tls_buff_slots,
+    &c->alloc.alloc,
+    false,
+    false,
+    nullptr,
+    nullptr,
+    nullptr
     );
   assert_true (!err.own);
   tls_buffer_thread_local_set (c->t);
   return 0;
 }
+/*----------------------------------------------------------------------------*/
+static int tls_test_init_lane_setup (void **state)
+{
+  tls_test_setup (state);
+  tls_context* c = (tls_context*) *state;
+  bl_err err = tls_buffer_init(
+    &c->t,
+    tls_buff_slot_size,
+    tls_buff_slots,
+    &c->alloc.alloc,
+    true,
+    false,
+    nullptr,
+    nullptr,
+    nullptr
+    );
+  assert_true (!err.own);
+  tls_buffer_thread_local_set (c->t);
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static int tls_test_init_free_index_setup (void **state)
+{
+  tls_test_setup (state);
+  tls_context* c = (tls_context*) *state;
+  bl_err err = tls_buffer_init(
+    &c->t,
+    tls_buff_slot_size,
+    tls_buff_slots,
+    &c->alloc.alloc,
+    false,
+    true,
+    nullptr,
+    nullptr,
+    nullptr
+    );
+  assert_true (!err.own);
+  tls_buffer_thread_local_set (c->t);
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static tls_segment* tls_test_segment_get (void* context)
+{
+  tls_context* c = (tls_context*) context;
+  ++c->seg_gets;
+  return tls_segment_create(
+    tls_buff_slot_size, tls_buff_slots, &c->seg_alloc
+    );
+}
+/*----------------------------------------------------------------------------*/
+static void tls_test_segment_retire (tls_segment* s, void* context)
+{
+  tls_context* c = (tls_context*) context;
+  c->retired = s;
+}
+/*----------------------------------------------------------------------------*/
+static int tls_test_init_growth_setup (void **state)
+{
+  tls_test_setup (state);
+  tls_context* c = (tls_context*) *state;
+  tls_growth g;
+  g.seg_slots      = tls_buff_slots;
+  g.seg_max        = 1;
+  g.get            = tls_test_segment_get;
+  g.get_context    = c;
+  g.retire         = tls_test_segment_retire;
+  g.retire_context = c;
+  bl_err err = tls_buffer_init(
+    &c->t,
+    tls_buff_slot_size,
+    tls_buff_slots,
+    &c->alloc.alloc,
+    false,
+    false,
+    &g,
+    nullptr,
+    nullptr
+    );
+  assert_true (!err.own);
+  tls_buffer_thread_local_set (c->t);
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static int tls_test_growth_teardown (void **state)
+{
+  tls_context* c = (tls_context*) *state;
+  for (bl_uword i = 0; i < c->t->seg_count; ++i) {
+    bl_dealloc (&c->seg_alloc, c->t->segs[i]);
+  }
+  if (c->retired) {
+    bl_dealloc (&c->seg_alloc, c->retired);
+  }
+  return 0;
+}
 #define DUMMY_POINTER_VALUE 0x7ef3430
 /*----------------------------------------------------------------------------*/
 static void tls_init_test (void **state)
@@ -48,7 +157,15 @@ static void tls_init_test (void **state)
   tls_buffer* t;
   tls_context* c = (tls_context*) *state;
   bl_err err = tls_buffer_init(
-    &t, tls_buff_slot_size, tls_buff_slots, &c->alloc.alloc, nullptr, nullptr
+    &t,
+    tls_buff_slot_size,
+    tls_buff_slots,
+    &c->alloc.alloc,
+    false,
+    false,
+    nullptr,
+    nullptr,
+    nullptr
     );
   assert_int_equal (err.own, bl_ok);
   assert_true (t->destructor_fn == nullptr);
@@ -57,6 +174,7 @@ static void tls_init_test (void **state)
   assert_true (bl_is_multiple ((bl_uword) t->mem, tls_buff_slot_size));
   assert_true (t->slot_count == tls_buff_slots);
   assert_true (t->slot_size == tls_buff_slot_size);
+  assert_false (tls_buffer_has_lane (t));
 }
 /*----------------------------------------------------------------------------*/
 static void tls_single_alloc_test (void **state)
@@ -150,6 +268,179 @@ static void tls_multiple_wrap_test (void **state)
   assert_ptr_equal (mem, c->t->mem);
 }
 /*----------------------------------------------------------------------------*/
+static void tls_lane_disabled_test (void **state)
+{
+  bl_u8* mem;
+  bl_err err = tls_buffer_alloc (&mem, 1);
+  assert_int_equal (err.own, bl_ok);
+  assert_false (tls_buffer_lane_push (mem));
+}
+/*----------------------------------------------------------------------------*/
+static void tls_lane_push_pop_test (void **state)
+{
+  tls_context* c = (tls_context*) *state;
+  assert_true (tls_buffer_has_lane (c->t));
+  assert_true ((bl_u8*) c->t->lane.ring >= c->t->mem_end);
+  assert_null (tls_buffer_lane_pop (c->t));
+
+  /* as many nodes as slots, over many laps of the ring */
+  for (bl_uword lap = 0; lap < 3; ++lap) {
+    bl_u8* mem[tls_buff_slots];
+    for (bl_uword i = 0; i < tls_buff_slots; ++i) {
+      bl_err err = tls_buffer_alloc (&mem[i], 1);
+      assert_int_equal (err.own, bl_ok);
+      *((bl_uword*) mem[i]) = DUMMY_POINTER_VALUE;
+      assert_true (tls_buffer_lane_push (mem[i]));
+    }
+    for (bl_uword i = 0; i < tls_buff_slots; ++i) {
+      assert_ptr_equal (tls_buffer_lane_pop (c->t), mem[i]);
+      tls_buffer_dealloc (mem[i], 1, tls_buff_slot_size);
+    }
+    assert_null (tls_buffer_lane_pop (c->t));
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void tls_growth_link_test (void **state)
+{
+  tls_context* c = (tls_context*) *state;
+  bl_u8* mem;
+  bl_err err = tls_buffer_alloc (&mem, tls_buff_slots);
+  assert_int_equal (err.own, bl_ok);
+  assert_ptr_equal (mem, c->t->mem);
+  *((bl_uword*) mem) = DUMMY_POINTER_VALUE;
+  assert_int_equal (c->seg_gets, 0);
+
+  /* the own region is full */
+  err = tls_buffer_alloc (&mem, 1);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (c->seg_gets, 1);
+  assert_int_equal (c->t->seg_count, 1);
+  assert_ptr_equal (mem, c->t->segs[0]->mem);
+  *((bl_uword*) mem) = DUMMY_POINTER_VALUE;
+
+  err = tls_buffer_alloc (&mem, tls_buff_slots - 1);
+  assert_int_equal (err.own, bl_ok);
+  assert_ptr_equal (mem, c->t->segs[0]->mem + tls_buff_slot_size);
+  *((bl_uword*) mem) = DUMMY_POINTER_VALUE;
+
+  /* per-thread segment limit reached */
+  err = tls_buffer_alloc (&mem, 1);
+  assert_int_equal (err.own, bl_alloc);
+  assert_int_equal (c->seg_gets, 1);
+}
+/*----------------------------------------------------------------------------*/
+static void tls_growth_too_big_test (void **state)
+{
+  tls_context* c = (tls_context*) *state;
+  bl_u8* mem;
+  bl_err err = tls_buffer_alloc (&mem, tls_buff_slots + 1);
+  assert_int_equal (err.own, bl_alloc);
+  assert_int_equal (c->seg_gets, 0);
+}
+/*----------------------------------------------------------------------------*/
+static void tls_growth_retire_test (void **state)
+{
+  tls_context* c = (tls_context*) *state;
+  bl_u8* base;
+  bl_u8* mem;
+  bl_err err = tls_buffer_alloc (&base, tls_buff_slots);
+  assert_int_equal (err.own, bl_ok);
+  *((bl_uword*) base) = DUMMY_POINTER_VALUE;
+  err = tls_buffer_alloc (&mem, 1);
+  assert_int_equal (err.own, bl_ok);
+  assert_int_equal (c->t->seg_count, 1);
+  *((bl_uword*) mem) = DUMMY_POINTER_VALUE;
+  tls_buffer_dealloc (base, tls_buff_slots, tls_buff_slot_size);
+  tls_buffer_dealloc (mem, 1, tls_buff_slot_size);
+
+  /* the segment lap is finished, then it goes back to the own region. The
+  lap that used the segment doesn't retire it */
+  for (bl_uword i = 0; i < tls_buff_slots * 2; ++i) {
+    err = tls_buffer_alloc (&mem, 1);
+    assert_int_equal (err.own, bl_ok);
+    tls_buffer_dealloc (mem, 1, tls_buff_slot_size);
+  }
+  assert_true (mem >= c->t->mem && mem < c->t->mem_end);
+  assert_int_equal (c->t->seg_count, 1);
+  assert_null (c->retired);
+  /* a full lap without needing the segment */
+  for (bl_uword i = 0; i < tls_buff_slots; ++i) {
+    err = tls_buffer_alloc (&mem, 1);
+    assert_int_equal (err.own, bl_ok);
+    tls_buffer_dealloc (mem, 1, tls_buff_slot_size);
+  }
+  assert_int_equal (c->t->seg_count, 0);
+  assert_non_null (c->retired);
+}
+/*----------------------------------------------------------------------------*/
+/* allocates as a log entry would: the first word (qnode hook) is written */
+static bl_u8* tls_free_index_alloc (bl_u32 slots)
+{
+  bl_u8* mem;
+  bl_err err = tls_buffer_alloc (&mem, slots);
+  if (err.own) {
+    return nullptr;
+  }
+  *((bl_uword*) mem) = DUMMY_POINTER_VALUE;
+  return mem;
+}
+/*----------------------------------------------------------------------------*/
+static void tls_free_index_alloc_test (void **state)
+{
+  tls_context* c = (tls_context*) *state;
+  bl_u8* mem[tls_buff_slots];
+  for (bl_uword i = 0; i < tls_buff_slots; ++i) {
+    mem[i] = tls_free_index_alloc (1);
+    assert_ptr_equal (mem[i], c->t->mem + (i * tls_buff_slot_size));
+    /* the region is stored at the end of the allocation */
+    bl_u8* trailer =
+      mem[i] + tls_buff_slot_size - TLS_BUFFER_INDEX_TRAILER_BYTES;
+    assert_ptr_equal (*((tls_free_index**) trailer), &c->t->fidx);
+  }
+  assert_null (tls_free_index_alloc (1));
+  tls_buffer_dealloc_indexed (mem[0], 1, tls_buff_slot_size);
+  assert_int_equal (bl_atomic_uword_load_rlx (&c->t->fidx.freed), 1);
+  assert_ptr_equal (tls_free_index_alloc (1), c->t->mem);
+}
+/*----------------------------------------------------------------------------*/
+static void tls_free_index_out_of_order_test (void **state)
+{
+  tls_context* c = (tls_context*) *state;
+  bl_u8* mem[tls_buff_slots];
+  for (bl_uword i = 0; i < tls_buff_slots; ++i) {
+    mem[i] = tls_free_index_alloc (1);
+    assert_non_null (mem[i]);
+  }
+  tls_buffer_dealloc_indexed (mem[1], 1, tls_buff_slot_size);
+  assert_int_equal (bl_atomic_uword_load_rlx (&c->t->fidx.freed), 0);
+  assert_null (tls_free_index_alloc (1));
+
+  tls_buffer_dealloc_indexed (mem[0], 1, tls_buff_slot_size);
+  assert_int_equal (bl_atomic_uword_load_rlx (&c->t->fidx.freed), 2);
+  assert_ptr_equal (tls_free_index_alloc (2), c->t->mem);
+}
+/*----------------------------------------------------------------------------*/
+static void tls_free_index_skip_test (void **state)
+{
+  tls_context* c = (tls_context*) *state;
+  bl_u8* mem = tls_free_index_alloc (tls_buff_slots - 1);
+  assert_non_null (mem);
+  tls_buffer_dealloc_indexed (mem, tls_buff_slots - 1, tls_buff_slot_size);
+  assert_int_equal(
+    bl_atomic_uword_load_rlx (&c->t->fidx.freed), tls_buff_slots - 1
+    );
+  /* doesn't fit on the last slot, which is skipped */
+  mem = tls_free_index_alloc (2);
+  assert_ptr_equal (mem, c->t->mem);
+  bl_u8* last = c->t->mem + ((tls_buff_slots - 1) * tls_buff_slot_size);
+  assert_true (*((bl_uword*) last) == TLS_BUFFER_SKIP_UWORD);
+
+  tls_buffer_dealloc_indexed (mem, 2, tls_buff_slot_size);
+  assert_int_equal(
+    bl_atomic_uword_load_rlx (&c->t->fidx.freed), tls_buff_slots + 2
+    );
+}
+/*----------------------------------------------------------------------------*/
 static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup (tls_init_test, tls_test_setup),
   cmocka_unit_test_setup (tls_single_alloc_test, tls_test_init_setup),
@@ -159,6 +450,30 @@ static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup (tls_dealloc_test, tls_test_init_setup),
   cmocka_unit_test_setup (tls_single_wrap_test, tls_test_init_setup),
   cmocka_unit_test_setup (tls_multiple_wrap_test, tls_test_init_setup),
+  cmocka_unit_test_setup (tls_lane_disabled_test, tls_test_init_setup),
+  cmocka_unit_test_setup (tls_lane_push_pop_test, tls_test_init_lane_setup),
+  cmocka_unit_test_setup_teardown(
+    tls_growth_link_test, tls_test_init_growth_setup, tls_test_growth_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    tls_growth_too_big_test,
+    tls_test_init_growth_setup,
+    tls_test_growth_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    tls_growth_retire_test,
+    tls_test_init_growth_setup,
+    tls_test_growth_teardown
+    ),
+  cmocka_unit_test_setup(
+    tls_free_index_alloc_test, tls_test_init_free_index_setup
+    ),
+  cmocka_unit_test_setup(
+    tls_free_index_out_of_order_test, tls_test_init_free_index_setup
+    ),
+  cmocka_unit_test_setup(
+    tls_free_index_skip_test, tls_test_init_free_index_setup
+    ),
 };
 /*----------------------------------------------------------------------------*/
 int tls_buffer_tests (void)
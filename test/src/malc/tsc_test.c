@@ -0,0 +1,49 @@
+#include <string.h>
+
+#include <bl/cmocka_pre.h>
+
+#include <malc/tsc.h>
+
+#include <bl/base/time.h>
+#include <bl/time_extras/time_extras.h>
+
+/*----------------------------------------------------------------------------*/
+static void tsc_test_conversion (void **state)
+{
+  tsc_calib c;
+  memset (&c, 0, sizeof c);
+  c.anchor.tsc  = 1000000;
+  c.anchor.ns   = 5000000;
+  c.ns_per_tick = 0.5;
+  assert_true (tsc_calib_to_nsec (&c, 1000000) == 5000000);
+  assert_true (tsc_calib_to_nsec (&c, 3000000) == 6000000);
+  /* taken before the anchor */
+  assert_true (tsc_calib_to_nsec (&c, 0) == 4500000);
+}
+/*----------------------------------------------------------------------------*/
+/* the converted TSC is within a millisecond of the clock */
+static void tsc_test_calibration (void **state)
+{
+  if (!tsc_is_invariant()) {
+    return;
+  }
+  tsc_calib c;
+  tsc_calib_init (&c, 2000);
+  assert_true (c.ns_per_tick > 0.);
+  tsc_calib_refresh (&c);
+  bl_u64 ns  = bl_fast_timept_to_nsec (bl_fast_timept_get());
+  bl_u64 tsc = tsc_calib_to_nsec (&c, tsc_get());
+  bl_u64 d   = ns > tsc ? ns - tsc : tsc - ns;
+  assert_true (d < 1000000);
+}
+/*----------------------------------------------------------------------------*/
+static const struct CMUnitTest tests[] = {
+  cmocka_unit_test (tsc_test_conversion),
+  cmocka_unit_test (tsc_test_calibration),
+};
+/*----------------------------------------------------------------------------*/
+int tsc_tests (void)
+{
+  return cmocka_run_group_tests (tests, nullptr, nullptr);
+}
+/*----------------------------------------------------------------------------*/